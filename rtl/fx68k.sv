@@ -2471,6 +2471,15 @@ endmodule
 module uRom( input clk, input [UADDR_WIDTH-1:0] microAddr, output logic [UROM_WIDTH-1:0] microOutput);
 	reg [UROM_WIDTH-1:0] uRam[ UROM_DEPTH];		
 	initial begin
+// synthesis translate_off
+		// Simulation only. +microrom=<file> selects the image, +fx68k_rom_preload leaves it to the testbench.
+		string romFile;
+		if( $test$plusargs( "fx68k_rom_preload"))
+			;
+		else if( $value$plusargs( "microrom=%s", romFile))
+			$readmemb( romFile, uRam);
+		else
+// synthesis translate_on
 		$readmemb("microrom.mem", uRam);
 	end
 	
@@ -2482,6 +2491,15 @@ endmodule
 module nanoRom( input clk, input [NADDR_WIDTH-1:0] nanoAddr, output logic [NANO_WIDTH-1:0] nanoOutput);
 	reg [NANO_WIDTH-1:0] nRam[ NANO_DEPTH];		
 	initial begin
+// synthesis translate_off
+		// Simulation only. +nanorom=<file> selects the image, +fx68k_rom_preload leaves it to the testbench.
+		string romFile;
+		if( $test$plusargs( "fx68k_rom_preload"))
+			;
+		else if( $value$plusargs( "nanorom=%s", romFile))
+			$readmemb( romFile, nRam);
+		else
+// synthesis translate_on
 		$readmemb("nanorom.mem", nRam);
 	end
 	
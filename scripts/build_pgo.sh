@@ -0,0 +1,70 @@
+#!/bin/bash
+# Profile guided build of the Verilated fx68k main testbench
+#
+# 1. Instrumented build: Verilator --prof-pgo plus compiler -fprofile-generate
+# 2. Training: runs sim/verilator/pgo/training_workload.txt on the instrumented binary
+# 3. Optimized build: Verilator profile.vlt plus compiler -fprofile-use
+# 4. Benchmark: baseline fx68k_main_test against fx68k_main_test_pgo
+#
+# Needs GCC (the .gcda profile format). Run through "make build_main_pgo".
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(cd "$SCRIPT_DIR/.." && pwd)"
+VERILATOR_DIR="$PROJECT_ROOT/sim/verilator"
+
+PGO_DIR="${PGO_DIR:-obj_pgo}"
+WORKLOAD="${WORKLOAD:-pgo/training_workload.txt}"
+BENCH_CYCLES="${BENCH_CYCLES:-20000000}"
+
+cd "$VERILATOR_DIR"
+
+PROFILE_DIR="$VERILATOR_DIR/$PGO_DIR/gcda"
+PROFILE_VLT="$VERILATOR_DIR/$PGO_DIR/profile.vlt"
+REPORT="$VERILATOR_DIR/$PGO_DIR/pgo_report.txt"
+
+workload_version=$(awk '$1 == "version" { print $2; exit }' "$WORKLOAD")
+if [[ -z "$workload_version" ]]; then
+    echo "Error: $WORKLOAD has no version line"
+    exit 1
+fi
+
+echo "=== [1/4] Instrumented build ==="
+rm -rf "$PGO_DIR"
+mkdir -p "$PROFILE_DIR"
+make build_main_pgo_gen PGO_DIR="$PGO_DIR" PGO_PROFILE_DIR="$PROFILE_DIR"
+
+echo "=== [2/4] Training (workload v$workload_version) ==="
+grep -v -e '^#' -e '^version' -e '^[[:space:]]*$' "$WORKLOAD" | while read -r args; do
+    echo "  fx68k_main_test $args"
+    # shellcheck disable=SC2086
+    "./$PGO_DIR/fx68k_main_test_pgo_gen" $args +verilator+prof+vlt+file+"$PROFILE_VLT" > /dev/null
+done
+
+echo "=== [3/4] Optimized build ==="
+# Same object directory, so the compiler finds the profile for each translation unit
+rm -f "$PGO_DIR"/*.o "$PGO_DIR"/*.a "$PGO_DIR"/fx68k_main_test_pgo_gen
+make build_main_pgo_use PGO_DIR="$PGO_DIR" PGO_PROFILE_DIR="$PROFILE_DIR" PGO_PROFILE_VLT="$PROFILE_VLT"
+
+echo "=== [4/4] Benchmark ==="
+make build_main
+speed() {
+    "$1" --benchmark "$BENCH_CYCLES" | awk '/^Speed:/ { print $2 }'
+}
+base=$(speed ./obj_dir/fx68k_main_test)
+pgo=$(speed "./$PGO_DIR/fx68k_main_test_pgo")
+speedup=$(awk -v a="$base" -v b="$pgo" 'BEGIN { if (a > 0) printf "%.3f", b / a; else print "n/a" }')
+
+{
+    echo "fx68k PGO report"
+    echo "================"
+    echo "Generated: $(date)"
+    echo "Revision: $(git -C "$PROJECT_ROOT" rev-parse --short HEAD 2>/dev/null || echo unknown)"
+    echo "Training workload: $WORKLOAD (version $workload_version)"
+    echo "Benchmark cycles: $BENCH_CYCLES"
+    echo "Baseline: $base MHz"
+    echo "PGO: $pgo MHz"
+    echo "Speedup: ${speedup}x"
+} | tee "$REPORT"
+
+echo "Binary: $VERILATOR_DIR/$PGO_DIR/fx68k_main_test_pgo"
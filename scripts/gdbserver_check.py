@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+
+"""
+Scripted GDB remote protocol client for fx68k_gdbserver (sim/verilator/gdbstub.h)
+Starts the server on a Unix socket with a small built-in guest and checks the packets gdb
+relies on: qSupported, g/p/P, m/M, a Z0 breakpoint with c, s in instruction and bus step
+modes and a Z2 write watchpoint. Arguments it does not take (e.g. +romimage=) go to the server.
+"""
+
+import argparse
+import os
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+from typing import List, Tuple
+
+# Guest: reset vectors, then a loop counting in D0 and storing it at $2000
+GUEST: List[Tuple[int, List[int]]] = [
+    (0x000000, [0x0000, 0xF000, 0x0000, 0x0400]),   # SSP, PC
+    (0x000400, [0x7000,                             # MOVEQ #0,D0
+                0x207C, 0x0000, 0x2000,             # MOVEA.L #$2000,A0
+                0x5280,                             # loop: ADDQ.L #1,D0
+                0x2080,                             # MOVE.L D0,(A0)
+                0x4E71,                             # NOP
+                0x60F8]),                           # BRA.S loop
+]
+START, LOOP, STORE, NOP, BRA = 0x400, 0x408, 0x40A, 0x40C, 0x40E
+COUNTER = 0x2000
+REG_A7, REG_SR, REG_PC = 15, 16, 17
+
+class CheckError(Exception):
+    pass
+
+class Client:
+    """One gdb connection, acknowledging packets until QStartNoAckMode."""
+
+    def __init__(self, path: str):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.settimeout(30)
+        self.sock.connect(path)
+        self.ack = True
+        self.pending = b''
+
+    def read_byte(self) -> int:
+        if not self.pending:
+            self.pending = self.sock.recv(4096)
+            if not self.pending:
+                raise CheckError("server closed the connection")
+        byte, self.pending = self.pending[0], self.pending[1:]
+        return byte
+
+    def send(self, data: str):
+        payload = data.encode()
+        self.sock.sendall(b'$' + payload + b'#%02x' % (sum(payload) & 0xFF))
+        if self.ack and self.read_byte() != ord('+'):
+            raise CheckError(f"{data}: not acknowledged")
+
+    def receive(self) -> str:
+        while self.read_byte() != ord('$'):
+            pass
+        payload = bytearray()
+        while (byte := self.read_byte()) != ord('#'):
+            payload.append(byte)
+        checksum = int(bytes([self.read_byte(), self.read_byte()]), 16)
+        if checksum != sum(payload) & 0xFF:
+            raise CheckError(f"bad checksum on {payload!r}")
+        if self.ack:
+            self.sock.sendall(b'+')
+        return payload.decode()
+
+    def command(self, data: str) -> str:
+        self.send(data)
+        return self.receive()
+
+    def monitor(self, line: str) -> str:
+        """qRcmd: the output comes in O packets ahead of the OK."""
+        self.send('qRcmd,' + line.encode().hex())
+        text = ''
+        while (reply := self.receive()).startswith('O') and reply != 'OK':
+            text += bytes.fromhex(reply[1:]).decode()
+        expect(reply == 'OK', f"monitor {line}: {reply}")
+        return text
+
+    def register(self, n: int) -> int:
+        return int(self.command(f'p{n:x}'), 16)
+
+    def close(self):
+        self.sock.close()
+
+def expect(condition: bool, what: str):
+    if not condition:
+        raise CheckError(what)
+    print(f"  PASS: {what}")
+
+def bus_cycles(client: Client) -> int:
+    """Reads, writes and acknowledges so far, from 'monitor cycles'."""
+    fields = client.monitor('cycles').replace(',', ' ').split()
+    return sum(int(fields[i - 1]) for i, word in enumerate(fields) if word in ('reads', 'writes', 'acknowledges'))
+
+def run_checks(client: Client):
+    features = client.command('qSupported:swbreak+;hwbreak+')
+    expect('PacketSize=' in features and 'swbreak+' in features, f"qSupported: {features}")
+    expect(client.command('QStartNoAckMode') == 'OK', "QStartNoAckMode")
+    client.ack = False
+    expect(client.command('?') in ('S05', 'T05'), "stopped after reset")
+
+    regs = client.command('g')
+    expect(len(regs) == 18 * 8, f"g returns 18 registers ({len(regs)} digits)")
+    values = [int(regs[i * 8:i * 8 + 8], 16) for i in range(18)]
+    expect(values[REG_PC] == START, f"PC at the reset vector (${values[REG_PC]:X})")
+    expect(values[REG_A7] == 0xF000, f"A7 from the reset vector (${values[REG_A7]:X})")
+    expect(values[REG_SR] & 0x2700 == 0x2700, f"supervisor, interrupts masked (SR ${values[REG_SR]:04X})")
+    expect(client.register(REG_PC) == values[REG_PC], "p agrees with g")
+    expect(client.command('P3=12345678') == 'OK' and client.register(3) == 0x12345678, "P writes D3")
+
+    expect(client.command('M3000,4:deadbeef') == 'OK', "M writes memory")
+    expect(client.command('m3000,4') == 'deadbeef', "m reads it back")
+    expect(client.command(f'm{START:x},2') == '7000', "m reads the guest")
+
+    expect(client.command(f'Z0,{NOP:x},2') == 'OK', "Z0 inserts a breakpoint")
+    for count in (1, 2):
+        reply = client.command('c')
+        expect(reply.startswith('T05') and 'swbreak' in reply, f"c stops on the breakpoint ({reply})")
+        expect(client.register(REG_PC) == NOP, f"PC at the breakpoint (${client.register(REG_PC):X})")
+        expect(client.register(0) == count, f"loop ran {count} time(s)")
+    expect(client.command(f'z0,{NOP:x},2') == 'OK', "z0 removes it")
+
+    client.monitor('step-mode insn')
+    for pc in (BRA, LOOP, STORE):
+        expect(client.command('s').startswith('T05'), "s steps one instruction")
+        expect(client.register(REG_PC) == pc, f"PC ${client.register(REG_PC):X}, expected ${pc:X}")
+
+    client.monitor('step-mode bus')
+    for _ in range(3):
+        before = bus_cycles(client)
+        expect(client.command('s').startswith('T05'), "s steps one bus cycle")
+        after = bus_cycles(client)
+        expect(after == before + 1, f"bus cycles {before} -> {after}")
+    client.monitor('step-mode insn')
+
+    expect(client.command(f'Z2,{COUNTER:x},2') == 'OK', "Z2 inserts a write watchpoint")
+    reply = client.command('c')
+    expect(reply.startswith('T05') and f'watch:{COUNTER:x};' in reply, f"c stops on the write ({reply})")
+    pc = client.register(REG_PC)
+    expect(LOOP <= pc <= BRA, f"PC ${pc:X} in the loop")
+    expect(client.command(f'z2,{COUNTER:x},2') == 'OK', "z2 removes it")
+
+    expect(client.command('D') == 'OK', "D detaches")
+
+def main():
+    parser = argparse.ArgumentParser(description='Check fx68k_gdbserver with a scripted gdb client')
+    parser.add_argument('--server', default='./obj_dir/fx68k_gdbserver')
+    parser.add_argument('--timeout', type=float, default=120, help='seconds for the whole session')
+    args, server_args = parser.parse_known_args()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        image = os.path.join(tmp, 'guest.bin')
+        with open(image, 'wb') as f:
+            for addr, words in GUEST:
+                f.seek(addr)
+                f.write(struct.pack(f'>{len(words)}H', *words))
+        path = os.path.join(tmp, 'gdb.sock')
+        try:
+            server = subprocess.Popen([args.server, '--load', image, '--unix', path] + server_args,
+                                      stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+        except OSError as e:
+            print(f"Error: {e}", file=sys.stderr)
+            return 1
+        failure = None
+        try:
+            deadline = time.monotonic() + args.timeout
+            client = None
+            while client is None:
+                try:
+                    client = Client(path)
+                except (FileNotFoundError, ConnectionRefusedError):
+                    if server.poll() is not None or time.monotonic() > deadline:
+                        raise CheckError("server did not start listening")
+                    time.sleep(0.05)
+            try:
+                run_checks(client)
+            finally:
+                client.close()
+            output, _ = server.communicate(timeout=max(deadline - time.monotonic(), 1))
+            if server.returncode != 0 or '=== GDB Server Summary ===' not in output:
+                raise CheckError(f"server exited with {server.returncode}")
+        except (CheckError, OSError, ValueError, subprocess.TimeoutExpired) as e:
+            failure = e
+            server.kill()
+            output, _ = server.communicate()
+        print(output, end='')
+
+    print("\n=== GDB Client Summary ===")
+    if failure:
+        print(f"FAIL: {failure}")
+        return 1
+    print("All packets behaved")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+
+"""
+Memory map compiler for the FX68K Verilator testbenches
+Converts a memory map description (sim/common/memory_map.json) into the initial memory
+image loaded with +memimage=<file> (see sim/verilator/memory_image.h).
+
+Region kinds: fill, pattern (address, inverse_address), vector_table and image.
+Regions apply in order; a later region overrides the words an earlier one set.
+"""
+
+import argparse
+import json
+import os
+import struct
+import sys
+from typing import Dict, List, Tuple
+
+MAGIC = b'FX68MEM1'
+ADDR_MASK = 0x00FFFFFF
+
+def number(value) -> int:
+    """Numbers may be JSON integers or strings with a 0x/$ prefix."""
+    if isinstance(value, int):
+        return value
+    text = str(value).strip()
+    if text.startswith('$'):
+        return int(text[1:], 16)
+    return int(text, 0)
+
+def word_range(region: dict) -> range:
+    start, end = number(region['start']), number(region['end'])
+    if start & 1 or end & 1 or end < start or end > ADDR_MASK + 1:
+        raise ValueError(f"region {region.get('name', '?')}: bad range ${start:X}-${end:X}")
+    return range(start, end, 2)
+
+def apply_region(words: Dict[int, int], region: dict, base_dir: str):
+    name = region.get('name', '?')
+    if 'fill' in region:
+        value = number(region['fill']) & 0xFFFF
+        for addr in word_range(region):
+            words[addr] = value
+    elif 'pattern' in region:
+        pattern = region['pattern']
+        if pattern not in ('address', 'inverse_address'):
+            raise ValueError(f"region {name}: unknown pattern {pattern}")
+        invert = 0xFFFF if pattern == 'inverse_address' else 0
+        for addr in word_range(region):
+            words[addr] = (addr & 0xFFFF) ^ invert
+    elif 'vector_table' in region:
+        table = region['vector_table']
+        base = number(region.get('start', 0))
+        first, count = number(table.get('first', 0)), number(table.get('count', 256))
+        targets = {number(k): number(v) for k, v in table.get('entries', {}).items()}
+        default = number(table.get('default', 0))
+        for vector in range(first, first + count):
+            target = targets.get(vector, default)
+            addr = (base + vector * 4) & ADDR_MASK
+            words[addr] = target >> 16 & 0xFFFF
+            words[(addr + 2) & ADDR_MASK] = target & 0xFFFF
+    elif 'image' in region:
+        path = os.path.join(base_dir, region['image'])
+        with open(path, 'rb') as f:
+            data = f.read()
+        if len(data) & 1:
+            data += b'\0'
+        addr = number(region.get('start', 0))
+        for i in range(0, len(data), 2):
+            words[(addr + i) & ADDR_MASK] = (data[i] << 8) | data[i + 1]
+    else:
+        raise ValueError(f"region {name}: needs fill, pattern, vector_table or image")
+
+def segments(words: Dict[int, int]) -> List[Tuple[int, List[int]]]:
+    """Contiguous runs of set words, ascending."""
+    runs = []
+    for addr in sorted(words):
+        if runs and runs[-1][0] + len(runs[-1][1]) * 2 == addr:
+            runs[-1][1].append(words[addr])
+        else:
+            runs.append((addr, [words[addr]]))
+    return runs
+
+def main():
+    parser = argparse.ArgumentParser(description='Compile a memory map into an initial memory image')
+    parser.add_argument('--map', default='../sim/common/memory_map.json')
+    parser.add_argument('--output', default='fx68k_mem.bin')
+    args = parser.parse_args()
+
+    words = {}
+    try:
+        with open(args.map, 'r') as f:
+            config = json.load(f)
+        for region in config['memory_map']['regions']:
+            apply_region(words, region, os.path.dirname(os.path.abspath(args.map)))
+    except (OSError, ValueError, KeyError) as e:
+        print(f"Error: {args.map}: {e}", file=sys.stderr)
+        return 1
+
+    runs = segments(words)
+    with open(args.output, 'wb') as f:
+        f.write(MAGIC)
+        f.write(struct.pack('<I', len(runs)))
+        for addr, data in runs:
+            f.write(struct.pack('<II', addr, len(data)))
+            f.write(struct.pack(f'<{len(data)}H', *data))
+
+    print(f"Wrote {args.output} ({len(words)} words in {len(runs)} segments)")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+
+"""
+ROM image packer for the FX68K Verilator testbenches
+Converts microrom.mem and nanorom.mem ($readmemb text) into the binary image
+loaded with +romimage=<file> (see sim/verilator/rom_image.h).
+"""
+
+import argparse
+import struct
+import sys
+from typing import List
+
+MAGIC = b'FX68ROM1'
+MICRO_DEPTH, MICRO_WIDTH = 1024, 17
+NANO_DEPTH, NANO_WIDTH = 336, 68
+
+def read_rom_file(filename: str, depth: int, width: int) -> List[int]:
+    """Read a $readmemb file into a list of integers, zero filled to depth."""
+    words = []
+    with open(filename, 'r') as f:
+        for number, line in enumerate(f, 1):
+            line = line.split('//')[0].strip()
+            if not line:
+                continue
+            if len(line) != width or set(line) - {'0', '1'}:
+                raise ValueError(f"{filename}:{number}: expected {width} binary digits")
+            words.append(int(line, 2))
+    if len(words) > depth:
+        raise ValueError(f"{filename}: {len(words)} words, ROM holds {depth}")
+    return words + [0] * (depth - len(words))
+
+def main():
+    parser = argparse.ArgumentParser(description='Pack the fx68k ROMs into a binary image')
+    parser.add_argument('--microrom', default='../rtl/microrom.mem')
+    parser.add_argument('--nanorom', default='../rtl/nanorom.mem')
+    parser.add_argument('--output', default='fx68k_rom.bin')
+    args = parser.parse_args()
+
+    try:
+        micro = read_rom_file(args.microrom, MICRO_DEPTH, MICRO_WIDTH)
+        nano = read_rom_file(args.nanorom, NANO_DEPTH, NANO_WIDTH)
+    except (OSError, ValueError) as e:
+        print(f"Error: {e}", file=sys.stderr)
+        return 1
+
+    with open(args.output, 'wb') as f:
+        f.write(MAGIC)
+        f.write(struct.pack('<II', MICRO_DEPTH, NANO_DEPTH))
+        f.write(struct.pack(f'<{MICRO_DEPTH}I', *micro))
+        for word in nano:
+            f.write(struct.pack('<III', word & 0xFFFFFFFF, (word >> 32) & 0xFFFFFFFF, word >> 64))
+
+    print(f"Wrote {args.output}")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
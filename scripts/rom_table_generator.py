@@ -3,10 +3,13 @@
 """
 ROM Table Generator for FX68K Documentation
 This script reads microcode and nanocode ROM files and generates markdown tables
-with all entries and their decoded bit fields.
+with all entries and their decoded bit fields. With --cpp it writes the same
+decoded fields as C++ lookup tables for the micro-PC trace decoder instead.
 """
 
+import argparse
 import os
+import re
 from typing import List, Tuple, Dict
 
 def read_rom_file(filename: str) -> List[str]:
@@ -207,12 +210,22 @@ def get_nanocode_description(word: str, addr: int) -> str:
     
     return "Standard control word"
 
-def generate_markdown_tables() -> Tuple[str, str]:
+def decode_micro_word(word: str) -> List[str]:
+    """Decoded microcode fields: next addr, ALU op, bus ctrl, reg ctrl, seq."""
+    return [decode_next_addr(word[0:3]), decode_alu_op(word[3:6]), decode_bus_ctrl(word[6:9]),
+            decode_reg_ctrl(word[9:13]), f"[{word[13:]}]"]
+
+def decode_nano_word(word: str) -> List[str]:
+    """Decoded nanocode fields: bus, reg transfer, ALU, addr ctrl, misc."""
+    return [decode_nano_bus(word[0:4]), decode_nano_reg_transfer(word[4:20]), decode_nano_alu(word[20:36]),
+            decode_addr_ctrl(word[36:52]), f"[{word[52:]}]"]
+
+def generate_markdown_tables(rtl_dir: str = '../rtl') -> Tuple[str, str]:
     """Generate markdown tables for both ROMs with decoded fields."""
     
     # Read ROM files
-    micro_rom = read_rom_file('../rtl/microrom.mem')
-    nano_rom = read_rom_file('../rtl/nanorom.mem')
+    micro_rom = read_rom_file(os.path.join(rtl_dir, 'microrom.mem'))
+    nano_rom = read_rom_file(os.path.join(rtl_dir, 'nanorom.mem'))
 
     # Generate microcode table
     micro_table = "| Address | Content | Next Addr [16:14] | ALU Op [13:11] | Bus Ctrl [10:8] | Reg Ctrl [7:4] | Seq [3:0] | Description |\n"
@@ -220,14 +233,9 @@ def generate_markdown_tables() -> Tuple[str, str]:
     
     for addr, word in enumerate(micro_rom):
         if word:  # Skip empty lines
-            next_addr = decode_next_addr(word[0:3])
-            alu_op = decode_alu_op(word[3:6])
-            bus_ctrl = decode_bus_ctrl(word[6:9])
-            reg_ctrl = decode_reg_ctrl(word[9:13])
-            seq = word[13:]
-            
+            fields = decode_micro_word(word)
             desc = get_microcode_description(word, addr)
-            micro_table += f"| 0x{addr:03X} | {word} | {next_addr} | {alu_op} | {bus_ctrl} | {reg_ctrl} | [{seq}] | {desc} |\n"
+            micro_table += f"| 0x{addr:03X} | {word} | {' | '.join(fields)} | {desc} |\n"
 
     # Generate nanocode table
     nano_table = "| Address | Content | Bus [67:64] | Reg Transfer [63:48] | ALU [47:32] | Addr [31:16] | Misc [15:0] | Description |\n"
@@ -235,20 +243,80 @@ def generate_markdown_tables() -> Tuple[str, str]:
     
     for addr, word in enumerate(nano_rom):
         if word:  # Skip empty lines
-            bus = decode_nano_bus(word[0:4])
-            reg = decode_nano_reg_transfer(word[4:20])
-            alu = decode_nano_alu(word[20:36])
-            addr_ctrl = decode_addr_ctrl(word[36:52])
-            misc = f"[{word[52:]}]"
-            
+            fields = decode_nano_word(word)
             desc = get_nanocode_description(word, addr)
-            nano_table += f"| 0x{addr:03X} | {word} | {bus} | {reg} | {alu} | {addr_ctrl} | {misc} | {desc} |\n"
+            nano_table += f"| 0x{addr:03X} | {word} | {' | '.join(fields)} | {desc} |\n"
 
     return micro_table, nano_table
 
+def read_micro_labels(rtl_dir: str) -> Dict[int, str]:
+    """Microroutine entry points named in the RTL (uaddrPla.sv defines, *_NMA localparams)."""
+    labels = {}
+    with open(os.path.join(rtl_dir, 'uaddrPla.sv'), 'r') as f:
+        for name, value in re.findall(r"^`define\s+(\w+)\s+'h([0-9A-Fa-f]+)", f.read(), re.M):
+            if name != 'NMA_BITS':
+                labels.setdefault(int(value, 16), name)
+    with open(os.path.join(rtl_dir, 'fx68k.sv'), 'r') as f:
+        for name, value in re.findall(r"^localparam\s+(\w+)_NMA\s*=\s*'h([0-9A-Fa-f]+)", f.read(), re.M):
+            labels.setdefault(int(value, 16), name)
+    return labels
+
+def read_micro_to_nano(rtl_dir: str) -> List[int]:
+    """Micro to nano address translation, from the microToNanoAddr case table in fx68k.sv."""
+    with open(os.path.join(rtl_dir, 'fx68k.sv'), 'r') as f:
+        bases = {int(b, 16): int(n, 16)
+                 for b, n in re.findall(r"^'h([0-9A-Fa-f]+):\s*orgBase\s*=\s*7'h([0-9A-Fa-f]+)", f.read(), re.M)}
+    return [(bases.get(addr >> 2, 0) << 2) | (addr & 3) for addr in range(1024)]
+
+def c_string(text: str) -> str:
+    return '"' + text.replace('\\', '\\\\').replace('"', '\\"') + '"'
+
+def generate_cpp_tables(rtl_dir: str) -> str:
+    """C++ lookup tables for sim/verilator/microtrace_decode.cpp."""
+    micro_rom = read_rom_file(os.path.join(rtl_dir, 'microrom.mem'))
+    nano_rom = read_rom_file(os.path.join(rtl_dir, 'nanorom.mem'))
+    labels = read_micro_labels(rtl_dir)
+    micro_to_nano = read_micro_to_nano(rtl_dir)
+
+    out = "// Generated by scripts/rom_table_generator.py --cpp. Do not edit.\n"
+    out += "#ifndef FX68K_MICROCODE_TABLES_H\n#define FX68K_MICROCODE_TABLES_H\n\n#include <cstdint>\n\n"
+    out += f"static const unsigned MICROCODE_DEPTH = {len(micro_rom)};\n"
+    out += f"static const unsigned NANOCODE_DEPTH = {len(nano_rom)};\n\n"
+
+    out += "// Entry point names, nullptr when the address has none\n"
+    out += "static const char* const MICRO_LABEL[MICROCODE_DEPTH] = {\n"
+    out += ''.join(f"    {c_string(labels[a]) if a in labels else 'nullptr'},\n" for a in range(len(micro_rom)))
+    out += "};\n\n"
+
+    out += "static const uint16_t MICRO_TO_NANO[MICROCODE_DEPTH] = {\n"
+    for a in range(0, len(micro_rom), 16):
+        out += "    " + ' '.join(f"0x{n:03X}," for n in micro_to_nano[a:a + 16]) + "\n"
+    out += "};\n\n"
+
+    out += "// Next addr | ALU op | Bus ctrl | Reg ctrl | Seq\n"
+    out += "static const char* const MICRO_FIELDS[MICROCODE_DEPTH] = {\n"
+    out += ''.join(f"    {c_string(' | '.join(decode_micro_word(w)))},\n" for w in micro_rom)
+    out += "};\n\n"
+
+    out += "// Bus | Reg transfer | ALU | Addr ctrl | Misc\n"
+    out += "static const char* const NANO_FIELDS[NANOCODE_DEPTH] = {\n"
+    out += ''.join(f"    {c_string(' | '.join(decode_nano_word(w)))},\n" for w in nano_rom)
+    out += "};\n\n#endif // FX68K_MICROCODE_TABLES_H\n"
+    return out
+
 def main():
     """Main function to generate and save tables."""
-    micro_table, nano_table = generate_markdown_tables()
+    parser = argparse.ArgumentParser(description='Generate decoded fx68k ROM tables')
+    parser.add_argument('--rtl-dir', default='../rtl')
+    parser.add_argument('--cpp', metavar='FILE', help='Write C++ lookup tables to FILE instead of markdown')
+    args = parser.parse_args()
+
+    if args.cpp:
+        with open(args.cpp, 'w') as f:
+            f.write(generate_cpp_tables(args.rtl_dir))
+        return
+
+    micro_table, nano_table = generate_markdown_tables(args.rtl_dir)
     
     # Save microcode table
     with open('microcode_table.md', 'w') as f:
@@ -24,6 +24,7 @@ BUILD_TYPE="release"
 TEST_MODE="all"
 VERBOSE=false
 CLEAN_BUILD=false
+FORCE=false
 
 # Function to print colored output
 print_status() {
@@ -47,6 +48,7 @@ print_help() {
     echo "  -m, --test-mode MODE    Test mode: all, alu, instructions, or main"
     echo "  -v, --verbose           Enable verbose output"
     echo "  -c, --clean             Clean build before running tests"
+    echo "  -f, --force             Re-simulate test cases whose results are cached"
     echo "  --verilator-only        Run only Verilator tests"
     echo "  --modelsim-only         Run only ModelSim tests"
     echo ""
@@ -103,6 +105,10 @@ parse_arguments() {
                 CLEAN_BUILD=true
                 shift
                 ;;
+            -f|--force)
+                FORCE=true
+                shift
+                ;;
             --verilator-only)
                 TEST_MODE="verilator"
                 shift
@@ -179,6 +185,11 @@ run_verilator_tests() {
     
     cd "$VERILATOR_DIR"
     
+    # Cached timing/fault results are replayed unless forced (sim/verilator/result_cache.h)
+    if [[ "$FORCE" == true ]]; then
+        export CACHE_ARGS=--force
+    fi
+    
     # Determine build target based on configuration
     local build_target="build"
     if [[ "$BUILD_TYPE" == "debug" ]]; then
@@ -394,6 +405,7 @@ main() {
     echo "  Performance Monitoring: $ENABLE_PERFORMANCE"
     echo "  Verbose: $VERBOSE"
     echo "  Clean Build: $CLEAN_BUILD"
+    echo "  Force Re-simulation: $FORCE"
     echo ""
     
     # Check dependencies
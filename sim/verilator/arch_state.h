@@ -0,0 +1,189 @@
+// Architectural state of the fx68k core, read and written straight from the Verilated model
+//
+// ArchState reads D0-D7, A0-A7, USP, SSP, PC and SR from the excUnit register file
+// (regs68L/regs68H), PcL/PcH and the PSW flops, exposed in fx68k.vlt. Accessors read the
+// model in place; snapshot() copies everything into an ArchSnapshot to keep or compare.
+//
+// The values are architectural at instruction boundaries: in InstructionObserver::instruction(),
+// which runs after the edge that loads IRD, the previous instruction has retired. PC is the
+// core's program counter, which runs ahead of the instruction being executed because of
+// prefetch; ArchTap records the opcode address next to it.
+//
+// The setters are for test setup, between two clocks at an instruction boundary or before the
+// first instruction after reset. PC is not writable: the prefetch queue would still hold words
+// from the old one, start the program through the reset vector instead.
+#ifndef FX68K_ARCH_STATE_H
+#define FX68K_ARCH_STATE_H
+
+#include "fx68k_harness.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+struct ArchSnapshot {
+    uint32_t d[8];
+    uint32_t a[8];                  // A7 is the stack pointer of the current mode
+    uint32_t usp, ssp;
+    uint32_t pc;
+    uint16_t sr;
+
+    uint8_t ccr() const { return sr & 0x1F; }
+    bool supervisor() const { return sr & 0x2000; }
+
+    bool operator==(const ArchSnapshot& o) const {
+        for (int i = 0; i < 8; i++) {
+            if (d[i] != o.d[i] || a[i] != o.a[i]) return false;
+        }
+        return usp == o.usp && ssp == o.ssp && pc == o.pc && sr == o.sr;
+    }
+    bool operator!=(const ArchSnapshot& o) const { return !(*this == o); }
+
+    // "D0=00000001 ... SR=2704" on one line
+    std::string describe() const {
+        std::string s;
+        char buf[32];
+        for (int i = 0; i < 8; i++) {
+            std::snprintf(buf, sizeof(buf), "D%d=%08X ", i, d[i]);
+            s += buf;
+        }
+        for (int i = 0; i < 8; i++) {
+            std::snprintf(buf, sizeof(buf), "A%d=%08X ", i, a[i]);
+            s += buf;
+        }
+        std::snprintf(buf, sizeof(buf), "USP=%08X SSP=%08X ", usp, ssp);
+        s += buf;
+        std::snprintf(buf, sizeof(buf), "PC=%06X SR=%04X", pc, sr);
+        return s + buf;
+    }
+
+    // Registers that differ from expected, "D1=00000002 (expected 00000003)", empty if none
+    std::string diff(const ArchSnapshot& expected) const {
+        std::string s;
+        char buf[64];
+        auto field = [&](const char* name, int n, uint32_t got, uint32_t want) {
+            if (got == want) return;
+            if (n >= 0) {
+                std::snprintf(buf, sizeof(buf), "%s%s%d=%08X (expected %08X)", s.empty() ? "" : ", ", name, n, got, want);
+            } else {
+                std::snprintf(buf, sizeof(buf), "%s%s=%08X (expected %08X)", s.empty() ? "" : ", ", name, got, want);
+            }
+            s += buf;
+        };
+        for (int i = 0; i < 8; i++) field("D", i, d[i], expected.d[i]);
+        for (int i = 0; i < 8; i++) field("A", i, a[i], expected.a[i]);
+        field("USP", -1, usp, expected.usp);
+        field("SSP", -1, ssp, expected.ssp);
+        field("PC", -1, pc, expected.pc);
+        field("SR", -1, sr, expected.sr);
+        return s;
+    }
+};
+
+class ArchState {
+public:
+    explicit ArchState(Vfx68k* cpu) : r(cpu->rootp) {}
+
+    uint32_t d(int n) const { return reg(n & 7); }
+    uint32_t a(int n) const { return (n & 7) == 7 ? sp() : reg(8 + (n & 7)); }
+    uint32_t usp() const { return reg(REG_USP); }
+    uint32_t ssp() const { return reg(REG_SSP); }
+    uint32_t sp() const { return supervisor() ? ssp() : usp(); }
+
+    uint32_t pc() const {
+        return ((uint32_t(r->fx68k__DOT__excUnit__DOT__PcH) << 16) | r->fx68k__DOT__excUnit__DOT__PcL)
+               & FlatMemory::ADDR_MASK;
+    }
+
+    uint16_t sr() const {
+        return (r->fx68k__DOT__pswT << 15) | (r->fx68k__DOT__pswS << 13) | (r->fx68k__DOT__pswI << 8) | ccr();
+    }
+    uint8_t ccr() const { return r->fx68k__DOT__excUnit__DOT__alu__DOT__pswCcr & 0x1F; }
+    bool supervisor() const { return r->fx68k__DOT__pswS; }
+
+    void set_d(int n, uint32_t value) { set_reg(n & 7, value); }
+    void set_a(int n, uint32_t value) {
+        if ((n & 7) == 7) {
+            set_reg(supervisor() ? REG_SSP : REG_USP, value);
+        } else {
+            set_reg(8 + (n & 7), value);
+        }
+    }
+    void set_usp(uint32_t value) { set_reg(REG_USP, value); }
+    void set_ssp(uint32_t value) { set_reg(REG_SSP, value); }
+
+    // The unused SR bits read as zero on the 68000 and are dropped here too
+    void set_sr(uint16_t value) {
+        r->fx68k__DOT__pswT = (value >> 15) & 1;
+        r->fx68k__DOT__pswS = (value >> 13) & 1;
+        r->fx68k__DOT__pswI = (value >> 8) & 7;
+        set_ccr(uint8_t(value));
+    }
+    void set_ccr(uint8_t value) { r->fx68k__DOT__excUnit__DOT__alu__DOT__pswCcr = value & 0x1F; }
+
+    ArchSnapshot snapshot() const {
+        ArchSnapshot s;
+        for (int i = 0; i < 8; i++) {
+            s.d[i] = d(i);
+            s.a[i] = a(i);
+        }
+        s.usp = usp();
+        s.ssp = ssp();
+        s.pc = pc();
+        s.sr = sr();
+        return s;
+    }
+
+    // Everything but PC, see the note at the top
+    void restore(const ArchSnapshot& s) {
+        set_sr(s.sr);
+        for (int i = 0; i < 8; i++) set_d(i, s.d[i]);
+        for (int i = 0; i < 7; i++) set_a(i, s.a[i]);
+        set_usp(s.usp);
+        set_ssp(s.ssp);
+    }
+
+private:
+    // Register file slots: D0-D7, A0-A6, then USP and SSP for the two A7s
+    static const int REG_USP = 15;
+    static const int REG_SSP = 16;
+
+    Vfx68k___024root* r;
+
+    uint32_t reg(int i) const {
+        return (uint32_t(r->fx68k__DOT__excUnit__DOT__regs68H[i]) << 16) | r->fx68k__DOT__excUnit__DOT__regs68L[i];
+    }
+
+    void set_reg(int i, uint32_t value) {
+        r->fx68k__DOT__excUnit__DOT__regs68H[i] = uint16_t(value >> 16);
+        r->fx68k__DOT__excUnit__DOT__regs68L[i] = uint16_t(value);
+    }
+};
+
+// Snapshot at every instruction boundary, for checks that follow the program as it runs.
+// Chains to another instruction observer, if one was attached before.
+class ArchTap : public InstructionObserver {
+public:
+    ArchSnapshot last;              // State as the instruction at last_addr starts
+    uint32_t last_addr;
+    uint16_t last_opcode;
+    uint64_t count;
+
+    explicit ArchTap(Fx68kHarness& hw) : last(), last_addr(0), last_opcode(0), count(0), state(hw.cpu),
+                                         next(hw.insn_observer) {
+        hw.insn_observer = this;
+    }
+
+    void instruction(uint32_t addr, uint16_t opcode, uint64_t cycle) override {
+        last = state.snapshot();
+        last_addr = addr;
+        last_opcode = opcode;
+        count++;
+        if (next) next->instruction(addr, opcode, cycle);
+    }
+
+private:
+    ArchState state;
+    InstructionObserver* next;
+};
+
+#endif // FX68K_ARCH_STATE_H
@@ -0,0 +1,336 @@
+// Periodic on-disk checkpoints of a harness, for long soak runs
+//
+// A checkpoint file is a sequence of records. Each record holds the Verilated model (through
+// VerilatedSave, so the model must be built with --savable; the Makefile then defines
+// FX68K_SAVABLE), the harness state (Fx68kHarness::state(), including the E bus and its
+// devices), caller state such as run statistics, and the guest memory pages written since the
+// previous record. The first record of a file is full: every non-zero page.
+//
+// resume() replays the records in order and continues from the last complete one, so a run
+// killed while writing loses only that checkpoint; the torn tail is cut off before the next
+// record is appended. Once the file grows past COMPACT_FACTOR times its last full record, the
+// next checkpoint rewrites it as a single full record, written aside and renamed over.
+//
+// The memory baseline (FlatMemory::commit_baseline()) is not part of a checkpoint.
+#ifndef FX68K_CHECKPOINT_H
+#define FX68K_CHECKPOINT_H
+
+#include "fx68k_harness.h"
+#include "state_buffer.h"
+#ifdef FX68K_SAVABLE
+#include "verilated_save.h"
+#endif
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static const char CHECKPOINT_MAGIC[8] = { 'F', 'X', '6', '8', 'K', 'C', 'K', 'P' };
+static const uint32_t CHECKPOINT_VERSION = 1;
+
+class Checkpointer {
+public:
+    static const uint64_t COMPACT_FACTOR = 4;
+
+    struct Stats {
+        uint64_t checkpoints;
+        uint64_t full;                  // Of which full records
+        uint64_t pages;
+        uint64_t bytes;
+        double seconds;
+    };
+
+    Stats stats;
+
+    Checkpointer(Fx68kHarness& hw, const std::string& path)
+        : stats(), hw(hw), path(path), seq(0), file_bytes(0), full_bytes(0), started(false) {}
+
+    // Appends a checkpoint of the harness as it is now, between two step_cycle() calls.
+    // user is opaque caller state, handed back by resume().
+    bool save(const std::vector<uint8_t>& user, std::string& error) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        bool full = !started || file_bytes > COMPACT_FACTOR * full_bytes;
+
+        std::vector<uint8_t> payload;
+        std::vector<uint8_t> model;
+        if (!save_model(model, error)) return false;
+        StateBuffer harness;
+        hw.state(harness);
+        put_section(payload, model);
+        put_section(payload, harness.bytes);
+        put_section(payload, user);
+
+        // Taken for a full record too, that resets the checkpoint dirty set
+        std::vector<uint32_t> pages = hw.mem.take_checkpoint_pages();
+        if (full) {
+            pages.clear();
+            for (uint32_t page = 0; page < FlatMemory::PAGE_COUNT; page++) {
+                if (!page_is_zero(page)) pages.push_back(page);
+            }
+        }
+        uint32_t count = uint32_t(pages.size());
+        put(payload, count);
+        for (uint32_t page : pages) {
+            put(payload, page);
+            const uint8_t* data = reinterpret_cast<const uint8_t*>(hw.mem.page_data(page));
+            payload.insert(payload.end(), data, data + FlatMemory::PAGE_WORDS * 2);
+        }
+
+        Header header;
+        std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+        header.version = CHECKPOINT_VERSION;
+        header.full = full;
+        header.sequence = seq;
+        header.cycles = hw.cycles();
+        header.payload_bytes = payload.size();
+        header.checksum = fnv1a(payload.data(), payload.size());
+        uint64_t record_bytes = sizeof(header) + payload.size();
+
+        std::string target = full ? path + ".tmp" : path;
+        FILE* file = std::fopen(target.c_str(), full ? "wb" : "ab");
+        bool ok = file && std::fwrite(&header, sizeof(header), 1, file) == 1
+                  && std::fwrite(payload.data(), 1, payload.size(), file) == payload.size()
+                  && std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+        if (file) ok &= std::fclose(file) == 0;
+        if (ok && full) ok = std::rename(target.c_str(), path.c_str()) == 0;
+        if (!ok) {
+            // The dirty pages are gone, so the next checkpoint has to be full again
+            error = "Could not write checkpoint " + target;
+            started = false;
+            return false;
+        }
+
+        seq++;
+        started = true;
+        file_bytes = full ? record_bytes : file_bytes + record_bytes;
+        if (full) full_bytes = record_bytes;
+        auto end_time = std::chrono::high_resolution_clock::now();
+        stats.checkpoints++;
+        stats.full += full;
+        stats.pages += pages.size();
+        stats.bytes += record_bytes;
+        stats.seconds += std::chrono::duration<double>(end_time - start_time).count();
+        return true;
+    }
+
+    // Restores the last complete checkpoint in the file into the harness and memory.
+    // Later save() calls append to the same file.
+    bool resume(std::vector<uint8_t>& user, std::string& error) {
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            error = "Could not open checkpoint " + path;
+            return false;
+        }
+
+        std::vector<uint8_t> model, harness;
+        uint64_t good_bytes = 0, records = 0, cycles = 0;
+        Header header;
+        std::vector<uint8_t> payload;
+        while (std::fread(&header, sizeof(header), 1, file) == 1) {
+            if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0
+                || header.version != CHECKPOINT_VERSION) {
+                break;
+            }
+            payload.resize(header.payload_bytes);
+            if (std::fread(payload.data(), 1, payload.size(), file) != payload.size()
+                || fnv1a(payload.data(), payload.size()) != header.checksum) {
+                break;
+            }
+
+            size_t pos = 0;
+            std::vector<uint8_t> record_user;
+            uint32_t count = 0;
+            if (!get_section(payload, pos, model) || !get_section(payload, pos, harness)
+                || !get_section(payload, pos, record_user) || !get(payload, pos, count)) {
+                break;
+            }
+            if (header.full) hw.mem.clear();
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t page = 0;
+                if (!get(payload, pos, page) || page >= FlatMemory::PAGE_COUNT
+                    || pos + FlatMemory::PAGE_WORDS * 2 > payload.size()) {
+                    std::fclose(file);
+                    error = "Corrupt page list in checkpoint " + path;
+                    return false;
+                }
+                hw.mem.load_page(page, reinterpret_cast<const uint16_t*>(&payload[pos]));
+                pos += FlatMemory::PAGE_WORDS * 2;
+            }
+
+            user.swap(record_user);
+            uint64_t record_bytes = sizeof(header) + payload.size();
+            good_bytes += record_bytes;
+            if (header.full) full_bytes = record_bytes;
+            seq = header.sequence + 1;
+            cycles = header.cycles;
+            records++;
+        }
+        std::fclose(file);
+
+        if (!records) {
+            error = "No complete checkpoint in " + path;
+            return false;
+        }
+        if (!restore_model(model, error)) return false;
+        StateBuffer state(harness);
+        hw.state(state);
+        if (!state.ok() || hw.cycles() != cycles) {
+            error = "Harness state in " + path + " does not match this build";
+            return false;
+        }
+
+        // Drop a torn record so the next one is appended after the last good one
+        if (truncate(path.c_str(), off_t(good_bytes)) != 0) {
+            error = "Could not truncate " + path;
+            return false;
+        }
+        file_bytes = good_bytes;
+        started = true;
+        hw.mem.take_checkpoint_pages();
+        return true;
+    }
+
+    // Checkpoints written or resumed so far, the next record's sequence number
+    uint64_t sequence() const { return seq; }
+
+    // Guest memory and harness counters, to compare a resumed run with an uninterrupted one
+    static uint64_t digest(const Fx68kHarness& hw) {
+        uint64_t h = FNV_OFFSET;
+        for (uint32_t page = 0; page < FlatMemory::PAGE_COUNT; page++) {
+            h = fnv1a(hw.mem.page_data(page), FlatMemory::PAGE_WORDS * 2, h);
+        }
+        uint64_t counters[] = { hw.ticks, hw.instructions, hw.bus.reads, hw.bus.writes, hw.bus.iack,
+                                hw.last_vector, hw.ird() };
+        return fnv1a(counters, sizeof(counters), h);
+    }
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t full;
+        uint64_t sequence;
+        uint64_t cycles;
+        uint64_t payload_bytes;
+        uint64_t checksum;                  // Of the payload
+    };
+
+    static const uint64_t FNV_OFFSET = 0xCBF29CE484222325ull;
+
+    Fx68kHarness& hw;
+    std::string path;
+    uint64_t seq;
+    uint64_t file_bytes;
+    uint64_t full_bytes;                    // Last full record
+    bool started;                           // The file holds our records, deltas can follow
+
+    static uint64_t fnv1a(const void* data, size_t size, uint64_t h = FNV_OFFSET) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            h = (h ^ p[i]) * 0x100000001B3ull;
+        }
+        return h;
+    }
+
+    bool page_is_zero(uint32_t page) const {
+        const uint16_t* data = hw.mem.page_data(page);
+        for (uint32_t i = 0; i < FlatMemory::PAGE_WORDS; i++) {
+            if (data[i]) return false;
+        }
+        return true;
+    }
+
+    template <class T>
+    static void put(std::vector<uint8_t>& out, const T& value) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+        out.insert(out.end(), p, p + sizeof(T));
+    }
+
+    template <class T>
+    static bool get(const std::vector<uint8_t>& in, size_t& pos, T& value) {
+        if (pos + sizeof(T) > in.size()) return false;
+        std::memcpy(&value, &in[pos], sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    static void put_section(std::vector<uint8_t>& out, const std::vector<uint8_t>& section) {
+        put(out, uint64_t(section.size()));
+        out.insert(out.end(), section.begin(), section.end());
+    }
+
+    static bool get_section(const std::vector<uint8_t>& in, size_t& pos, std::vector<uint8_t>& section) {
+        uint64_t size = 0;
+        if (!get(in, pos, size) || pos + size > in.size()) return false;
+        section.assign(in.begin() + pos, in.begin() + pos + size);
+        pos += size;
+        return true;
+    }
+
+    // VerilatedSave only writes files, so the model goes through one next to the checkpoint
+    bool save_model(std::vector<uint8_t>& blob, std::string& error) {
+#ifdef FX68K_SAVABLE
+        std::string model_path = path + ".model";
+        {
+            VerilatedSave os;
+            os.open(model_path.c_str());
+            if (!os.isOpen()) {
+                error = "Could not write " + model_path;
+                return false;
+            }
+            os << *hw.cpu;
+            os.close();
+        }
+        bool ok = read_file(model_path, blob);
+        std::remove(model_path.c_str());
+        if (!ok) error = "Could not read back " + model_path;
+        return ok;
+#else
+        (void)blob;
+        error = "Model built without --savable, see build_main";
+        return false;
+#endif
+    }
+
+    bool restore_model(const std::vector<uint8_t>& blob, std::string& error) {
+#ifdef FX68K_SAVABLE
+        std::string model_path = path + ".model";
+        FILE* file = std::fopen(model_path.c_str(), "wb");
+        bool ok = file && std::fwrite(blob.data(), 1, blob.size(), file) == blob.size();
+        if (file) ok &= std::fclose(file) == 0;
+        if (ok) {
+            VerilatedRestore is;
+            is.open(model_path.c_str());
+            ok = is.isOpen();
+            if (ok) {
+                is >> *hw.cpu;
+                is.close();
+            }
+        }
+        std::remove(model_path.c_str());
+        if (!ok) error = "Could not restore the model through " + model_path;
+        return ok;
+#else
+        (void)blob;
+        error = "Model built without --savable, see build_main";
+        return false;
+#endif
+    }
+
+    static bool read_file(const std::string& name, std::vector<uint8_t>& data) {
+        FILE* file = std::fopen(name.c_str(), "rb");
+        if (!file) return false;
+        std::fseek(file, 0, SEEK_END);
+        long size = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+        data.resize(size > 0 ? size_t(size) : 0);
+        bool ok = size >= 0 && std::fread(data.data(), 1, data.size(), file) == data.size();
+        std::fclose(file);
+        return ok;
+    }
+};
+
+#endif // FX68K_CHECKPOINT_H
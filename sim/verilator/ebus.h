@@ -0,0 +1,135 @@
+// 6800 style synchronous peripherals for the fx68k harness
+//
+// Devices mapped here answer with VPAn instead of DTACKn. The core then runs the 6800 protocol
+// itself: it asserts VMAn in step with E and ends the cycle just before E falls. Register reads
+// happen once, on the rising edge of E, and writes are latched on the falling edge, the same
+// points a real 6840/6850 samples the bus.
+//
+// Devices are not clocked. The bus counts E periods and each device reports the E period of its
+// next event (a timer timeout that raises an interrupt); it is only called at that point or on a
+// register access, and brings its state up to date from the elapsed E count.
+//
+// With the USE_E_CLKEN build (make build_ebus) the harness takes the edges from E_PosClkEn and
+// E_NegClkEn, otherwise from the E output itself.
+#ifndef FX68K_EBUS_H
+#define FX68K_EBUS_H
+
+#include "state_buffer.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class EBusDevice {
+public:
+    static const uint64_t NEVER = ~0ull;
+
+    virtual ~EBusDevice() {}
+
+    // e: E periods since the bus was created
+    virtual uint8_t read(unsigned reg, uint64_t e) = 0;
+    virtual void write(unsigned reg, uint8_t data, uint64_t e) = 0;
+
+    // First E period at which event() must run, NEVER if nothing is due
+    virtual uint64_t next_event() const { return NEVER; }
+    virtual void event(uint64_t e) { (void)e; }
+
+    // Interrupt request output
+    virtual bool irq() const { return false; }
+
+    // Saves or restores the device for a checkpoint, see state_buffer.h
+    virtual void state(StateBuffer& s) { (void)s; }
+};
+
+class EBus {
+public:
+    EBus() : e_periods(0), due(EBusDevice::NEVER), level(0) {}
+
+    // 8 bit device with regs registers on one byte lane from base: the odd (LDS) lane by default,
+    // so register n is at base + 2n + 1. irq_level is the IPL the device interrupts on, 0 for none.
+    void map(EBusDevice* device, uint32_t base, unsigned regs, int irq_level, bool odd_lane = true) {
+        ranges.push_back(Range{ base & ~1u, (base & ~1u) + regs * 2, odd_lane, irq_level, device });
+        update();
+    }
+
+    // Device for a word address, nullptr if it is not on the E bus
+    EBusDevice* decode(uint32_t addr, unsigned& reg, bool& odd_lane) const {
+        for (const Range& r : ranges) {
+            if (addr >= r.base && addr < r.end) {
+                reg = (addr - r.base) >> 1;
+                odd_lane = r.odd_lane;
+                return r.device;
+            }
+        }
+        return nullptr;
+    }
+
+    uint8_t read(EBusDevice* device, unsigned reg) {
+        uint8_t data = device->read(reg, e_periods);
+        update();
+        return data;
+    }
+
+    void write(EBusDevice* device, unsigned reg, uint8_t data) {
+        device->write(reg, data, e_periods);
+        update();
+    }
+
+    // One E period ended (falling edge of E). A single compare unless some device is due.
+    void e_clock() {
+        if (++e_periods >= due) {
+            for (const Range& r : ranges) {
+                if (r.device->next_event() <= e_periods) r.device->event(e_periods);
+            }
+            update();
+        }
+    }
+
+    uint64_t periods() const { return e_periods; }
+
+    // Highest interrupt level requested, 0 if none
+    int ipl() const { return level; }
+
+    // Position of a mapped device, -1 for none, and back
+    int index(const EBusDevice* device) const {
+        for (size_t i = 0; i < ranges.size(); i++) {
+            if (ranges[i].device == device) return int(i);
+        }
+        return -1;
+    }
+
+    EBusDevice* device(int index) const {
+        return (index >= 0 && size_t(index) < ranges.size()) ? ranges[index].device : nullptr;
+    }
+
+    // E period count and every device, in map order. The pending event and interrupt level
+    // follow from the device state.
+    void state(StateBuffer& s) {
+        s.io(e_periods);
+        for (const Range& r : ranges) r.device->state(s);
+        if (s.restoring()) update();
+    }
+
+private:
+    struct Range {
+        uint32_t base, end;
+        bool odd_lane;
+        int irq_level;
+        EBusDevice* device;
+    };
+
+    std::vector<Range> ranges;
+    uint64_t e_periods;
+    uint64_t due;
+    int level;
+
+    void update() {
+        due = EBusDevice::NEVER;
+        level = 0;
+        for (const Range& r : ranges) {
+            due = std::min(due, r.device->next_event());
+            if (r.device->irq()) level = std::max(level, r.irq_level);
+        }
+    }
+};
+
+#endif // FX68K_EBUS_H
@@ -0,0 +1,95 @@
+// Fast-forward a harness with the instruction level model, then continue cycle accurately
+//
+// FastForward runs Iss68k (iss68k.h) from reset, on the harness memory itself, so the guest
+// memory it leaves behind needs no copying. It stops at a PC, an instruction count, or the
+// first thing the model leaves to the RTL, and the RTL starts on the same state:
+//
+//   - vectors 0 and 1 are pointed at the model's SSP and PC for one reset of the core, which
+//     fetches them and fills the prefetch queue from the new PC like any reset;
+//   - when the first instruction is about to load IRD, the vectors are put back and SR, the
+//     data and address registers and both stack pointers are written through ArchState.
+//
+// That is the setup point arch_state.h allows: PC cannot be written, the prefetch queue would
+// still hold the old words. The harness then continues from the instruction the model stopped
+// on; cycles() counts from the reset, a few dozen clocks before it.
+//
+// The model has no interrupts and no devices, so this is for the code that runs before a guest
+// enables them or touches hardware: accesses to the HostChannel and E bus windows hand over.
+#ifndef FX68K_FAST_FORWARD_H
+#define FX68K_FAST_FORWARD_H
+
+#include "fx68k_harness.h"
+#include "arch_state.h"
+#include "iss68k.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+class FastForward {
+public:
+    static const uint64_t DEFAULT_LIMIT = 1000000000;  // Instructions, when only a PC is given
+    static const uint64_t STARTUP_CYCLES = 1000;       // Reset to the first instruction
+
+    uint64_t instructions;
+    Iss68k::Stop stop;
+    uint32_t handover_pc;
+    double seconds;                 // Host time in the model
+    uint64_t startup_cycles;        // RTL cycles from the reset to the handover
+
+    FastForward() : instructions(0), stop(Iss68k::RUNNING), handover_pc(0), seconds(0), startup_cycles(0) {}
+
+    // In place of hw.reset(). target_pc is Iss68k::NO_TARGET to run max_instructions.
+    bool run(Fx68kHarness& hw, uint64_t max_instructions, uint32_t target_pc, std::string& error) {
+        Iss68k iss(hw.mem);
+        if (hw.host) iss.add_io(hw.host->base, hw.host->size);
+        iss.ebus = hw.ebus;
+        iss.reset();
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        stop = iss.run(max_instructions, target_pc);
+        seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start_time).count();
+        instructions = iss.instructions;
+        handover_pc = iss.pc;
+        return inject(hw, iss, error);
+    }
+
+    void print_summary() const {
+        std::cout << "\n=== Fast Forward Summary ===" << std::endl;
+        std::printf("Model: %llu instructions in %.3f s (%.1f MIPS), stopped on %s\n",
+                    (unsigned long long)instructions, seconds, seconds > 0 ? instructions / seconds / 1e6 : 0.0,
+                    Iss68k::stop_name(stop));
+        std::printf("RTL handover at $%06X after %llu startup cycles\n", handover_pc,
+                    (unsigned long long)startup_cycles);
+    }
+
+private:
+    bool inject(Fx68kHarness& hw, const Iss68k& iss, std::string& error) {
+        uint32_t vectors[2] = { hw.mem.read_long(0), hw.mem.read_long(4) };
+        hw.mem.write_long(0, iss.ssp());
+        hw.mem.write_long(4, iss.pc);
+        hw.reset();
+        bool started = hw.run_until([&] { return hw.ird_load_pending(); }, STARTUP_CYCLES);
+        hw.mem.write_long(0, vectors[0]);
+        hw.mem.write_long(4, vectors[1]);
+        startup_cycles = hw.cycles();
+        if (!started) {
+            error = "core did not reach its first instruction after the handover reset";
+            return false;
+        }
+
+        ArchSnapshot s;
+        for (int i = 0; i < 8; i++) {
+            s.d[i] = iss.d[i];
+            s.a[i] = iss.a[i];
+        }
+        s.usp = iss.usp();
+        s.ssp = iss.ssp();
+        s.pc = iss.pc;
+        s.sr = iss.sr;
+        ArchState(hw.cpu).restore(s);
+        return true;
+    }
+};
+
+#endif // FX68K_FAST_FORWARD_H
@@ -0,0 +1,178 @@
+// Deterministic bus fault injection for the fx68k harness
+//
+// BusFaultInjector answers chosen bus cycles with BERRn. A rule matches on address range,
+// function code, direction and CPU cycle window, then fires on the nth match and/or with a
+// probability drawn from a seeded generator, so a campaign entry is reproduced exactly by its
+// rule and seed. Rules are evaluated once per bus cycle, at its start.
+//
+// Group0Frame decodes the 7 word frame the core stacks for bus and address errors.
+#ifndef FX68K_FAULT_INJECTOR_H
+#define FX68K_FAULT_INJECTOR_H
+
+#include "fx68k_harness.h"
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct FaultRule {
+    uint32_t addr_lo, addr_hi;      // Inclusive, word address of the cycle
+    uint8_t fc_mask;                // Bit n matches FC n
+    int access;                     // 0 any, 1 read, 2 write
+    uint64_t cycle_lo, cycle_hi;    // Inclusive CPU cycle window
+    uint64_t nth;                   // Fire on the nth match only, 0 for every match
+    double probability;             // Of firing on a match
+    unsigned max_faults;            // 0 for no limit
+
+    FaultRule() : addr_lo(0), addr_hi(FlatMemory::ADDR_MASK), fc_mask(0x7F), access(0), cycle_lo(0),
+                  cycle_hi(~0ull), nth(0), probability(1.0), max_faults(1), matches(0), fired(0) {}
+
+    // "addr=LO-HI,fc=1|2,rw=r|w,cycle=LO-HI,nth=N,p=P,max=N", hex addresses, any subset
+    static bool parse(const std::string& spec, FaultRule& rule, std::string& error) {
+        rule = FaultRule();
+        std::istringstream in(spec);
+        std::string field;
+        while (std::getline(in, field, ',')) {
+            size_t eq = field.find('=');
+            if (eq == std::string::npos) {
+                error = "expected key=value: " + field;
+                return false;
+            }
+            std::string key = field.substr(0, eq), value = field.substr(eq + 1);
+            size_t dash = value.find('-');
+            std::string lo = value.substr(0, dash), hi = (dash == std::string::npos) ? lo : value.substr(dash + 1);
+            try {
+                if (key == "addr") {
+                    rule.addr_lo = std::stoul(lo, nullptr, 16) & FlatMemory::ADDR_MASK;
+                    rule.addr_hi = std::stoul(hi, nullptr, 16) & FlatMemory::ADDR_MASK;
+                } else if (key == "fc") {
+                    rule.fc_mask = 0;
+                    std::istringstream codes(value);
+                    std::string code;
+                    while (std::getline(codes, code, '|')) rule.fc_mask |= 1 << (std::stoul(code) & 7);
+                } else if (key == "rw") {
+                    rule.access = (value == "r") ? 1 : (value == "w") ? 2 : 0;
+                } else if (key == "cycle") {
+                    rule.cycle_lo = std::stoull(lo);
+                    rule.cycle_hi = (dash == std::string::npos) ? ~0ull : std::stoull(hi);
+                } else if (key == "nth") {
+                    rule.nth = std::stoull(value);
+                } else if (key == "p") {
+                    rule.probability = std::stod(value);
+                } else if (key == "max") {
+                    rule.max_faults = std::stoul(value);
+                } else {
+                    error = "unknown key " + key;
+                    return false;
+                }
+            } catch (const std::exception&) {
+                error = "bad value in " + field;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string describe() const {
+        char buf[160];
+        std::snprintf(buf, sizeof(buf), "addr=%06X-%06X,fc=%02X,rw=%s,cycle=%llu-%llu,nth=%llu,p=%g,max=%u",
+                      addr_lo, addr_hi, fc_mask, access == 1 ? "r" : access == 2 ? "w" : "any",
+                      (unsigned long long)cycle_lo, (unsigned long long)cycle_hi, (unsigned long long)nth,
+                      probability, max_faults);
+        return buf;
+    }
+
+    // The rule in the form parse() reads back
+    std::string spec() const {
+        std::string codes;
+        for (int fc = 0; fc < 8; fc++) {
+            if (fc_mask & (1 << fc)) codes += (codes.empty() ? "" : "|") + std::to_string(fc);
+        }
+        char buf[200];
+        std::snprintf(buf, sizeof(buf), "addr=%X-%X,fc=%s,rw=%s,cycle=%llu-%llu,nth=%llu,p=%.17g,max=%u",
+                      addr_lo, addr_hi, codes.c_str(), access == 1 ? "r" : access == 2 ? "w" : "any",
+                      (unsigned long long)cycle_lo, (unsigned long long)cycle_hi, (unsigned long long)nth,
+                      probability, max_faults);
+        return buf;
+    }
+
+private:
+    friend class BusFaultInjector;
+    uint64_t matches;
+    unsigned fired;
+};
+
+class BusFaultInjector : public BusFaultSource {
+public:
+    std::vector<BusCycle> injected;     // Cycles answered with BERRn, in order
+
+    explicit BusFaultInjector(uint32_t seed = 1) : rng(seed) {}
+
+    void add(const FaultRule& rule) { rules.push_back(rule); }
+
+    void reset(uint32_t seed) {
+        rng.seed(seed);
+        injected.clear();
+        for (FaultRule& r : rules) {
+            r.matches = 0;
+            r.fired = 0;
+        }
+    }
+
+    bool bus_error(const BusCycle& cycle) override {
+        for (FaultRule& r : rules) {
+            if (cycle.addr < r.addr_lo || cycle.addr > r.addr_hi) continue;
+            if (!(r.fc_mask & (1 << cycle.fc))) continue;
+            if ((r.access == 1 && cycle.write) || (r.access == 2 && !cycle.write)) continue;
+            if (cycle.start_cycle < r.cycle_lo || cycle.start_cycle > r.cycle_hi) continue;
+            if (r.max_faults && r.fired >= r.max_faults) continue;
+            r.matches++;
+            if (r.nth && r.matches != r.nth) continue;
+            if (r.probability < 1.0 && std::uniform_real_distribution<double>(0.0, 1.0)(rng) >= r.probability) continue;
+            r.fired++;
+            injected.push_back(cycle);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    std::vector<FaultRule> rules;
+    std::mt19937 rng;
+};
+
+// Bus/address error stack frame, lowest address first in memory
+struct Group0Frame {
+    uint16_t ssw;                   // Bits 4-0: R/W (1 read), I/N (1 not in an instruction), FC
+    uint32_t access_addr;
+    uint16_t ir;
+    uint16_t sr;
+    uint32_t pc;
+
+    static const uint32_t SIZE = 14;
+
+    static Group0Frame read(const FlatMemory& mem, uint32_t sp) {
+        Group0Frame f;
+        f.ssw = mem.read_word(sp);
+        f.access_addr = mem.read_long(sp + 2) & FlatMemory::ADDR_MASK;
+        f.ir = mem.read_word(sp + 6);
+        f.sr = mem.read_word(sp + 8);
+        f.pc = mem.read_long(sp + 10) & FlatMemory::ADDR_MASK;
+        return f;
+    }
+
+    bool read_access() const { return ssw & 0x10; }
+    bool not_instruction() const { return ssw & 0x08; }
+    unsigned fc() const { return ssw & 7; }
+
+    std::string describe() const {
+        char buf[128];
+        std::snprintf(buf, sizeof(buf), "SSW=%04X (%s %s FC=%u) addr=%06X IR=%04X SR=%04X PC=%06X", ssw,
+                      read_access() ? "read" : "write", not_instruction() ? "N" : "I", fc(), access_addr, ir, sr, pc);
+        return buf;
+    }
+};
+
+#endif // FX68K_FAULT_INJECTOR_H
@@ -0,0 +1,670 @@
+// Cycle-level harness shared by the fx68k Verilator testbenches
+//
+// Drives the core the way fx68kTop does: one master clock edge per call to tick(),
+// with enPhi1/enPhi2 alternating, so two ticks make one 68000 clock cycle.
+// The bus is a zero wait state flat 16MB memory, plus optional 6800 style devices (ebus.h).
+// Run with +telemetry, each instance publishes live counters for fx68k_top (telemetry.h).
+#ifndef FX68K_HARNESS_H
+#define FX68K_HARNESS_H
+
+#include "Vfx68k.h"
+#include "Vfx68k___024root.h"
+#include "verilated.h"
+#include "stimulus.h"
+#include "rom_image.h"
+#include "microtrace.h"
+#include "toggle_activity.h"
+#include "telemetry.h"
+#include "ebus.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Flat 24 bit guest memory. Words are stored host-endian, the upper byte lives at the even address.
+class FlatMemory {
+public:
+    static const uint32_t ADDR_MASK = 0x00FFFFFF;
+    static const uint32_t WORD_COUNT = 0x00800000;
+    static const uint32_t PAGE_SHIFT = 12;
+    static const uint32_t PAGE_COUNT = (ADDR_MASK + 1) >> PAGE_SHIFT;
+    static const uint32_t PAGE_WORDS = (1u << PAGE_SHIFT) / 2;
+
+    // Old contents of a written word, for reverse execution (reverse.h)
+    struct UndoEntry {
+        uint32_t index;
+        uint16_t data;
+    };
+
+    // While set, every write_word()/bus_write() appends the word it overwrites. load_page(),
+    // clear() and restore_baseline() are not journaled.
+    std::deque<UndoEntry>* undo_log;
+
+    FlatMemory() : undo_log(nullptr), words(WORD_COUNT, 0), page_dirty(PAGE_COUNT, 0), page_marks(PAGE_COUNT, 0) {}
+
+    uint16_t read_word(uint32_t addr) const {
+        return words[(addr & ADDR_MASK) >> 1];
+    }
+
+    uint32_t read_long(uint32_t addr) const {
+        return (uint32_t(read_word(addr)) << 16) | read_word(addr + 2);
+    }
+
+    uint8_t read_byte(uint32_t addr) const {
+        uint16_t w = read_word(addr);
+        return (addr & 1) ? (w & 0xFF) : (w >> 8);
+    }
+
+    void write_word(uint32_t addr, uint16_t data) {
+        uint32_t index = (addr & ADDR_MASK) >> 1;
+        if (undo_log) undo_log->push_back(UndoEntry{ index, words[index] });
+        words[index] = data;
+        mark_dirty(index);
+    }
+
+    void write_long(uint32_t addr, uint32_t data) {
+        write_word(addr, data >> 16);
+        write_word(addr + 2, data & 0xFFFF);
+    }
+
+    void write_byte(uint32_t addr, uint8_t data) {
+        bus_write((addr & ADDR_MASK) >> 1, (addr & 1) ? data : (uint16_t(data) << 8), !(addr & 1), addr & 1);
+    }
+
+    // Bus side write honouring the data strobes
+    void bus_write(uint32_t index, uint16_t data, bool upper, bool lower) {
+        uint16_t& w = words[index & (WORD_COUNT - 1)];
+        if (undo_log) undo_log->push_back(UndoEntry{ index & (WORD_COUNT - 1), w });
+        if (upper && lower) {
+            w = data;
+        } else if (upper) {
+            w = (w & 0x00FF) | (data & 0xFF00);
+        } else if (lower) {
+            w = (w & 0xFF00) | (data & 0x00FF);
+        }
+        mark_dirty(index & (WORD_COUNT - 1));
+    }
+
+    // One copy unless it wraps or is journaled
+    void load(uint32_t addr, const std::vector<uint16_t>& image) {
+        uint32_t index = (addr & ADDR_MASK) >> 1;
+        if (undo_log || image.empty() || index + image.size() > WORD_COUNT) {
+            for (size_t i = 0; i < image.size(); i++) {
+                write_word(addr + i * 2, image[i]);
+            }
+            return;
+        }
+        std::memcpy(&words[index], image.data(), image.size() * 2);
+        for (uint32_t page = index / PAGE_WORDS; page <= (index + image.size() - 1) / PAGE_WORDS; page++) {
+            page_dirty[page] = DIRTY_BASELINE | DIRTY_CHECKPOINT;
+        }
+    }
+
+    void clear() {
+        std::fill(words.begin(), words.end(), 0);
+        std::fill(page_dirty.begin(), page_dirty.end(), DIRTY_BASELINE | DIRTY_CHECKPOINT);
+    }
+
+    // Take the current contents as baseline. restore_baseline() then only copies back
+    // the pages written since, which keeps per-run resets cheap.
+    void commit_baseline() {
+        baseline = words;
+        for (uint8_t& d : page_dirty) d &= ~DIRTY_BASELINE;
+    }
+
+    void restore_baseline() {
+        for (uint32_t page = 0; page < PAGE_COUNT; page++) {
+            if (page_dirty[page] & DIRTY_BASELINE) {
+                std::memcpy(&words[page * PAGE_WORDS], &baseline[page * PAGE_WORDS], PAGE_WORDS * 2);
+                page_dirty[page] = DIRTY_CHECKPOINT;
+            }
+        }
+    }
+
+    // Pages written since the last call, for incremental checkpoints (checkpoint.h).
+    // Tracked apart from the baseline, so both can be used in one run.
+    std::vector<uint32_t> take_checkpoint_pages() {
+        std::vector<uint32_t> pages;
+        for (uint32_t page = 0; page < PAGE_COUNT; page++) {
+            if (page_dirty[page] & DIRTY_CHECKPOINT) {
+                pages.push_back(page);
+                page_dirty[page] &= ~DIRTY_CHECKPOINT;
+            }
+        }
+        return pages;
+    }
+
+    const uint16_t* page_data(uint32_t page) const { return &words[page * PAGE_WORDS]; }
+
+    void load_page(uint32_t page, const uint16_t* src) {
+        std::memcpy(&words[page * PAGE_WORDS], src, PAGE_WORDS * 2);
+        page_dirty[page] |= DIRTY_BASELINE;
+    }
+
+    uint16_t* data() { return words.data(); }
+
+    // Debugger marks per page and kind (gdbstub.h): some address in the page has a breakpoint
+    // or a watchpoint. A clear bit, the usual case, ends the lookup there.
+    static const uint8_t MARK_EXEC = 1;
+    static const uint8_t MARK_READ = 2;
+    static const uint8_t MARK_WRITE = 4;
+
+    uint8_t marks(uint32_t addr) const { return page_marks[(addr & ADDR_MASK) >> PAGE_SHIFT]; }
+
+    // Marks [addr, addr + size) with bits, on top of what is already there
+    void mark(uint32_t addr, uint32_t size, uint8_t bits) {
+        for (uint32_t page = (addr & ADDR_MASK) >> PAGE_SHIFT; size; page = (page + 1) % PAGE_COUNT) {
+            page_marks[page] |= bits;
+            uint32_t in_page = (1u << PAGE_SHIFT) - (addr & ((1u << PAGE_SHIFT) - 1));
+            if (size <= in_page) break;
+            size -= in_page;
+            addr += in_page;
+        }
+    }
+
+    void clear_marks() { std::fill(page_marks.begin(), page_marks.end(), 0); }
+
+    // Puts back a word from the undo log, without journaling it again
+    void undo(const UndoEntry& entry) {
+        words[entry.index] = entry.data;
+        mark_dirty(entry.index);
+    }
+
+private:
+    static const uint8_t DIRTY_BASELINE = 1;
+    static const uint8_t DIRTY_CHECKPOINT = 2;
+
+    std::vector<uint16_t> words;
+    std::vector<uint16_t> baseline;
+    std::vector<uint8_t> page_dirty;
+    std::vector<uint8_t> page_marks;
+
+    // One store for both dirty sets
+    void mark_dirty(uint32_t index) {
+        page_dirty[index / PAGE_WORDS] = DIRTY_BASELINE | DIRTY_CHECKPOINT;
+    }
+};
+
+// Bus activity since the last reset, counted at the end of each bus cycle (AS negated)
+struct BusCounters {
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t iack;
+};
+
+// One completed bus cycle, as seen from the pins
+struct BusCycle {
+    uint32_t addr;
+    uint16_t data;
+    uint8_t fc;
+    bool write;
+    bool iack;
+    bool upper, lower;
+    bool vpa;                   // Synchronous E bus cycle
+    bool berr;                  // Terminated with BERRn
+    uint64_t start_cycle;
+    uint64_t end_cycle;
+};
+
+// Optional per bus cycle callback. Called once when AS is negated, never per clock.
+class BusObserver {
+public:
+    virtual ~BusObserver() {}
+    virtual void bus_cycle(const BusCycle& cycle) = 0;
+};
+
+// Optional per instruction callback, called after the clock edge that loads IRD.
+// addr is the address the opcode was fetched from, see Fx68kHarness::opcode_addr().
+class InstructionObserver {
+public:
+    virtual ~InstructionObserver() {}
+    virtual void instruction(uint32_t addr, uint16_t opcode, uint64_t cycle) = 0;
+};
+
+// How an interrupt acknowledge cycle is answered
+enum class IackReply {
+    AUTOVECTOR,                 // VPAn
+    VECTOR,                     // DTACKn with a vector number on D0-D7
+    SPURIOUS,                   // BERRn
+};
+
+// Optional, called once at the start of each acknowledge cycle. Without one every level is autovectored.
+class IackResponder {
+public:
+    virtual ~IackResponder() {}
+    virtual IackReply acknowledge(int level, uint8_t& vector) = 0;
+};
+
+// Optional, asked once at the start of every bus cycle that is not an acknowledge. True
+// terminates the cycle with BERRn instead of DTACKn. See fault_injector.h.
+class BusFaultSource {
+public:
+    virtual ~BusFaultSource() {}
+    virtual bool bus_error(const BusCycle& cycle) = 0;
+};
+
+// Optional guest to host channel (semihost.h), given each completed write cycle that falls in
+// [base, base + size). The write still reaches memory.
+class HostChannel {
+public:
+    const uint32_t base;
+    const uint32_t size;
+
+    HostChannel(uint32_t base, uint32_t size) : base(base), size(size) {}
+    virtual ~HostChannel() {}
+    virtual void host_write(const BusCycle& cycle) = 0;
+};
+
+// Optional, given each completed bus cycle (not an acknowledge) whose address lies in a page
+// FlatMemory::marks() flags for its direction. The exact match is up to the target (gdbstub.h).
+class WatchTarget {
+public:
+    virtual ~WatchTarget() {}
+    virtual void watch_hit(const BusCycle& cycle) = 0;
+};
+
+class Fx68kHarness {
+public:
+    std::unique_ptr<VerilatedContext> context;
+    Vfx68k* cpu;
+    FlatMemory mem;
+
+    uint64_t ticks;
+    uint64_t instructions;          // Counted while an instruction observer or telemetry is active
+    BusCounters bus;
+    uint32_t last_vector;           // Last exception vector fetched, ~0 if none yet
+    BusObserver* observer;
+    StimulusRecorder* recorder;
+    MicroTrace* microtrace;
+    ToggleActivity* toggles;        // Sampled after every clock edge
+    InstructionObserver* insn_observer;
+    EBus* ebus;                     // Drives IPL0n-2n with its interrupt level while attached
+    IackResponder* iack_responder;
+    BusFaultSource* bus_faults;
+    HostChannel* host;
+    WatchTarget* watch;
+
+    // Plusargs for every harness context (each instance owns one), e.g. +verilator+prof+vlt+file+
+    static void command_args(int argc, char** argv) {
+        args().assign(argv, argv + argc);
+    }
+
+    // Without +romimage=, parse the +microrom=/+nanorom= text images once per process and preload
+    // every model from that copy instead of $readmemb per model (the multi-suite runner)
+    static void share_roms(bool on) {
+        shared_roms() = on;
+    }
+
+    Fx68kHarness() : ticks(0), instructions(0), bus(), last_vector(~0u), observer(nullptr), recorder(nullptr),
+                     microtrace(nullptr), toggles(nullptr), insn_observer(nullptr), ebus(nullptr), iack_responder(nullptr),
+                     bus_faults(nullptr), host(nullptr), watch(nullptr), phase(0), as_active(false), current(), fetch_last(0), fetch_prev(0),
+                     e_device(nullptr), e_reg(0), e_odd_lane(false), e_level(false), e_ipl(0),
+                     iack_reply(IackReply::AUTOVECTOR), iack_vector(0), lifetime_ticks(0), lifetime_bus() {
+        context.reset(new VerilatedContext);
+        if (!args().empty()) {
+            context->commandArgs(int(args().size()), args().data());
+        }
+        std::shared_ptr<const RomImage> rom = preload_rom();
+        cpu = new Vfx68k(context.get());
+
+        cpu->clk = 0;
+        cpu->extReset = 1;
+        cpu->pwrUp = 1;
+        cpu->enPhi1 = 1;
+        cpu->enPhi2 = 0;
+        cpu->HALTn = 1;
+        cpu->DTACKn = 1;
+        cpu->VPAn = 1;
+        cpu->BERRn = 1;
+        cpu->BRn = 1;
+        cpu->BGACKn = 1;
+        cpu->IPL0n = 1;
+        cpu->IPL1n = 1;
+        cpu->IPL2n = 1;
+        cpu->iEdb = 0x0000;
+
+        if (rom) {
+            // Run the initial blocks first so nothing overwrites the copied ROMs
+            cpu->eval();
+            rom->install(cpu);
+        }
+
+        if (*context->commandArgsPlusMatch("telemetry")) {
+            telemetry.attach(Telemetry::process().claim_slot());
+        }
+    }
+
+    ~Fx68kHarness() {
+        publish_telemetry();
+        telemetry.detach();
+        cpu->final();
+        delete cpu;
+    }
+
+    // 68000 clock cycles since the last reset
+    uint64_t cycles() const { return ticks >> 1; }
+
+    // Power up reset. The core fetches SSP and PC from vectors 0 and 1 afterwards.
+    void reset() {
+        cpu->pwrUp = 1;
+        cpu->extReset = 1;
+        for (int i = 0; i < 16; i++) {
+            tick();
+        }
+        cpu->pwrUp = 0;
+        cpu->extReset = 0;
+
+        lifetime_ticks += ticks;
+        lifetime_bus.reads += bus.reads;
+        lifetime_bus.writes += bus.writes;
+        lifetime_bus.iack += bus.iack;
+        ticks = 0;
+        bus = BusCounters();
+    }
+
+    // One master clock edge. The enables for an edge are set before the falling clock eval that
+    // precedes it, so outputs derived from them (E_PosClkEn/E_NegClkEn) are valid ahead of the edge.
+    void tick() {
+        if (recorder) recorder->sample(*cpu);
+#ifdef FX68K_USE_E_CLKEN
+        bool e_rise = ebus && cpu->E_PosClkEn;
+        bool e_fall = ebus && cpu->E_NegClkEn;
+#endif
+        bool micro_step = microtrace && microcycle_pending();
+        bool insn_start = (insn_observer || telemetry.attached()) && ird_load_pending();
+        cpu->clk = 1;
+        cpu->eval();
+        if (recorder) recorder->outputs(*cpu);
+        if (micro_step) microtrace->record(cpu->rootp->fx68k__DOT__microAddr);
+        if (insn_start) {
+            instructions++;
+            if (insn_observer) insn_observer->instruction(opcode_addr(), ird(), cycles());
+        }
+        // E bus first: the edge may also end the bus cycle, and the transfer belongs to it
+        if (ebus) {
+#ifndef FX68K_USE_E_CLKEN
+            bool e_rise = cpu->E && !e_level;
+            bool e_fall = !cpu->E && e_level;
+            e_level = cpu->E;
+#endif
+            if (e_rise || e_fall) service_ebus(e_rise);
+        }
+        service_bus();
+        phase ^= 1;
+        cpu->enPhi1 = (phase == 0);
+        cpu->enPhi2 = (phase == 1);
+        cpu->clk = 0;
+        cpu->eval();
+        if (toggles) toggles->sample();
+        ticks++;
+        if ((ticks & (TELEMETRY_TICKS - 1)) == 0) publish_telemetry();
+    }
+
+    // One full 68000 clock (PHI1 + PHI2)
+    void step_cycle() {
+        tick();
+        tick();
+    }
+
+    // Whole clocks until done() returns true, or until max_cycles more have run. True if done()
+    // ended the run. done() is checked before every clock.
+    template <class Done>
+    bool run_until(Done done, uint64_t max_cycles) {
+        uint64_t limit = cycles() + max_cycles;
+        while (!done()) {
+            if (cycles() >= limit) return false;
+            step_cycle();
+        }
+        return true;
+    }
+
+    // True when the coming clock edge ends a microcycle and loads the next micro address.
+    // Mirrors "enT1" in fx68k.sv.
+    bool microcycle_pending() const {
+        const Vfx68k___024root* r = cpu->rootp;
+        return phase == 0
+            && r->fx68k__DOT__tState == 4
+            && !r->fx68k__DOT__wClk;
+    }
+
+    // True when the coming clock edge loads IRD, i.e. a new instruction starts executing.
+    // Mirrors "enT1 & Nanod.Ir2Ird" in fx68k.sv.
+    bool ird_load_pending() const {
+        return microcycle_pending()
+            && ((cpu->rootp->fx68k__DOT__nanoLatch[2] >> (67 - 64)) & 1);
+    }
+
+    uint16_t ird() const { return cpu->rootp->fx68k__DOT__Ird; }
+
+    // Address of the opcode in IRD, valid when IRD has just been loaded. IR and IRC are the
+    // last two program space fetches, or IR is the last one while the IRC fetch is still on the
+    // bus. The fetched word confirms the choice; only identical adjacent words stay ambiguous.
+    uint32_t opcode_addr() const {
+        bool irc_on_bus = as_active && cpu->eRWn && !current.iack && (current.fc & 3) == 2;
+        uint32_t addr = irc_on_bus ? fetch_last : fetch_prev;
+        uint32_t other = irc_on_bus ? fetch_prev : fetch_last;
+        return (mem.read_word(addr) == ird() || mem.read_word(other) != ird()) ? addr : other;
+    }
+
+    unsigned fc() const { return (cpu->FC2 << 2) | (cpu->FC1 << 1) | cpu->FC0; }
+
+    bool halted() const { return !cpu->oHALTEDn; }
+
+    // Interrupt request on IPL0n-2n, 0 for none
+    void set_ipl(int level) {
+        cpu->IPL0n = !(level & 1);
+        cpu->IPL1n = !(level & 2);
+        cpu->IPL2n = !(level & 4);
+    }
+
+    // Harness side of a checkpoint (checkpoint.h): counters, bus cycle in flight and the E
+    // bus. The model and memory are saved separately, observers and the recorder are not.
+    void state(StateBuffer& s) {
+        s.io(ticks);
+        s.io(instructions);
+        s.io(bus);
+        s.io(last_vector);
+        s.io(phase);
+        s.io(as_active);
+        s.io(current);
+        s.io(fetch_last);
+        s.io(fetch_prev);
+        int device = ebus ? ebus->index(e_device) : -1;
+        s.io(device);
+        s.io(e_reg);
+        s.io(e_odd_lane);
+        s.io(e_level);
+        s.io(e_ipl);
+        s.io(iack_reply);
+        s.io(iack_vector);
+        s.io(lifetime_ticks);
+        s.io(lifetime_bus);
+        if (ebus) ebus->state(s);
+        if (s.restoring()) e_device = ebus ? ebus->device(device) : nullptr;
+    }
+
+    void publish_telemetry() {
+        if (!telemetry.attached()) return;
+        telemetry.update((lifetime_ticks + ticks) >> 1, instructions, lifetime_bus.reads + bus.reads,
+                         lifetime_bus.writes + bus.writes, lifetime_bus.iack + bus.iack, last_vector);
+    }
+
+private:
+    int phase;
+    bool as_active;
+
+    static std::vector<char*>& args() {
+        static std::vector<char*> saved;
+        return saved;
+    }
+
+    static bool& shared_roms() {
+        static bool on = false;
+        return on;
+    }
+    BusCycle current;
+    uint32_t fetch_last, fetch_prev;      // Last two completed program space reads
+    EBusDevice* e_device;                   // Decoded at the start of the current bus cycle
+    unsigned e_reg;
+    bool e_odd_lane;
+    bool e_level;                           // E after the last edge, without E_PosClkEn/E_NegClkEn
+    int e_ipl;
+    IackReply iack_reply;
+    uint8_t iack_vector;
+    TelemetryPublisher telemetry;
+    uint64_t lifetime_ticks;                // Before the last reset, for telemetry
+    BusCounters lifetime_bus;
+
+    // +romimage=<file> loads the packed ROMs once per process instead of $readmemb per model
+    std::shared_ptr<const RomImage> preload_rom() {
+        static const char* PREFIX = "+romimage=";
+        const char* match = context->commandArgsPlusMatch(PREFIX + 1);
+        if (!*match && !shared_roms()) {
+            return nullptr;
+        }
+
+        std::string error;
+        std::shared_ptr<const RomImage> rom;
+        if (*match) {
+            rom = RomImage::shared(match + std::strlen(PREFIX), error);
+        } else {
+            rom = RomImage::shared_text(plusarg("+microrom=", "microrom.mem"), plusarg("+nanorom=", "nanorom.mem"), error);
+        }
+        if (!rom) {
+            std::cerr << "Error: " << error << std::endl;
+            std::exit(1);
+        }
+        const char* preload[] = { "+fx68k_rom_preload" };
+        context->commandArgsAdd(1, preload);
+        return rom;
+    }
+
+    // Value of +name=value, the RTL's default otherwise
+    std::string plusarg(const char* prefix, const char* fallback) {
+        const char* match = context->commandArgsPlusMatch(prefix + 1);
+        return *match ? match + std::strlen(prefix) : fallback;
+    }
+
+    void service_bus() {
+        if (!cpu->ASn) {
+            if (!as_active) {
+                current = BusCycle();
+                current.addr = cpu->eab << 1;
+                current.fc = fc();
+                current.iack = (current.fc == 7);
+                current.write = !cpu->eRWn;
+                current.start_cycle = cycles();
+                e_device = (ebus && !current.iack) ? ebus->decode(current.addr, e_reg, e_odd_lane) : nullptr;
+                current.vpa = (e_device != nullptr);
+                if (current.iack) {
+                    iack_reply = IackReply::AUTOVECTOR;
+                    if (iack_responder) {
+                        iack_reply = iack_responder->acknowledge((current.addr >> 1) & 7, iack_vector);
+                    }
+                    current.berr = (iack_reply == IackReply::SPURIOUS);
+                } else if (bus_faults) {
+                    current.berr = bus_faults->bus_error(current);
+                }
+                as_active = true;
+            }
+            if (current.berr) {
+                cpu->BERRn = 0;
+                cpu->DTACKn = 1;
+                cpu->VPAn = 1;
+            } else if (current.iack) {
+                if (iack_reply == IackReply::VECTOR) {
+                    cpu->iEdb = iack_vector;
+                    current.data = iack_vector;
+                    cpu->DTACKn = 0;
+                } else {
+                    cpu->VPAn = 0;
+                    cpu->DTACKn = 1;
+                }
+            } else if (e_device) {
+                // The core syncs to E and ends the cycle itself, the transfer is in service_ebus()
+                cpu->VPAn = 0;
+                cpu->DTACKn = 1;
+                current.write = !cpu->eRWn;
+                current.upper |= !cpu->UDSn;
+                current.lower |= !cpu->LDSn;
+            } else {
+                if (cpu->eRWn) {
+                    cpu->iEdb = mem.read_word(current.addr);
+                    current.data = cpu->iEdb;
+                    current.upper |= !cpu->UDSn;
+                    current.lower |= !cpu->LDSn;
+                } else if ((!cpu->UDSn || !cpu->LDSn) && !current.upper && !current.lower) {
+                    // Strobes stay low for several edges; commit and journal the write once
+                    mem.bus_write(cpu->eab, cpu->oEdb, !cpu->UDSn, !cpu->LDSn);
+                    current.write = true;
+                    current.data = cpu->oEdb;
+                    current.upper = !cpu->UDSn;
+                    current.lower = !cpu->LDSn;
+                }
+                cpu->DTACKn = 0;
+            }
+        } else {
+            if (as_active) {
+                if (current.iack) {
+                    bus.iack++;
+                } else if (current.write) {
+                    bus.writes++;
+                    if (host && current.addr - host->base < host->size) {
+                        current.end_cycle = cycles();
+                        host->host_write(current);
+                    }
+                } else {
+                    bus.reads++;
+                    if (current.fc == 5 && current.addr < 0x400 && !(current.addr & 2)) {
+                        last_vector = current.addr >> 2;
+                    }
+                    if ((current.fc & 3) == 2) {
+                        fetch_prev = fetch_last;
+                        fetch_last = current.addr;
+                    }
+                }
+                if (watch && !current.iack
+                    && (mem.marks(current.addr) & (current.write ? FlatMemory::MARK_WRITE : FlatMemory::MARK_READ))) {
+                    current.end_cycle = cycles();
+                    watch->watch_hit(current);
+                }
+                if (observer) {
+                    current.end_cycle = cycles();
+                    observer->bus_cycle(current);
+                }
+                as_active = false;
+            }
+            cpu->DTACKn = 1;
+            cpu->VPAn = 1;
+            cpu->BERRn = 1;
+        }
+    }
+
+    // Edge of E. Registers are read when E rises inside a VMA cycle and written when it falls.
+    void service_ebus(bool rise) {
+        bool vma = as_active && e_device && !cpu->VMAn;
+        if (rise) {
+            if (vma && cpu->eRWn) {
+                uint8_t data = ebus->read(e_device, e_reg);
+                cpu->iEdb = uint16_t(data) * 0x0101;
+                current.data = cpu->iEdb;
+            }
+        } else {
+            if (vma && !cpu->eRWn) {
+                current.data = cpu->oEdb;
+                ebus->write(e_device, e_reg, e_odd_lane ? (cpu->oEdb & 0xFF) : (cpu->oEdb >> 8));
+            }
+            ebus->e_clock();
+        }
+        if (ebus->ipl() != e_ipl) {
+            e_ipl = ebus->ipl();
+            set_ipl(e_ipl);
+        }
+    }
+};
+
+#endif // FX68K_HARNESS_H
@@ -0,0 +1,256 @@
+// Several fx68k cores on one shared bus
+//
+// Fx68kSystem clocks N models in lockstep, edge for edge from one master clock, the same way
+// Fx68kHarness drives one, and serves their bus cycles from a single zero wait state
+// FlatMemory. One CPU is bus master at a time; the others are held off the bus with BGACKn,
+// as the arbiter of a multi 68000 board does. To pass the bus on, the arbiter asserts BRn to
+// the master, waits for BGn with AS negated (so never inside a read-modify-write cycle),
+// asserts that CPU's BGACKn and releases the next one's, which resumes where it stopped.
+//
+// The bus goes round robin to a CPU waiting for it, i.e. whose microcode clock is stalled on
+// a bus cycle (wClk), once the master has run quantum bus cycles or has left the bus idle.
+// Per CPU statistics count those stalls; contention counts the clocks where a CPU waited while
+// the bus was busy.
+//
+// Reads of CPU_ID_ADDR return the index of the CPU making them, so one image runs on all.
+// A system is single threaded; independent systems can run on separate threads.
+#ifndef FX68K_SYSTEM_H
+#define FX68K_SYSTEM_H
+
+#include "fx68k_harness.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Fx68kSystem {
+public:
+    static const uint32_t CPU_ID_ADDR = 0x00FFFFFE;
+    static const unsigned IDLE_TICKS = 8;           // Master without AS this long gives the bus up
+
+    struct CpuStats {
+        uint64_t bus_cycles;
+        uint64_t stall_cycles;      // Microcode clock stopped waiting for the bus
+        uint64_t held_cycles;       // Not bus master
+        uint64_t grants;            // Times it became master
+    };
+
+    std::unique_ptr<VerilatedContext> context;
+    std::vector<Vfx68k*> cpus;
+    FlatMemory mem;
+    std::vector<CpuStats> stats;
+    uint64_t ticks;
+    uint64_t contention_cycles;
+    uint64_t handovers;
+    unsigned quantum;               // Bus cycles a master runs before another waiting CPU gets the bus
+
+    // Plusargs for every system context, +romimage= loads the ROMs once for all models
+    static void command_args(int argc, char** argv) {
+        args().assign(argv, argv + argc);
+    }
+
+    explicit Fx68kSystem(unsigned count, unsigned quantum = 8)
+        : stats(count), ticks(0), contention_cycles(0), handovers(0), quantum(quantum), phase(0),
+          as_active(count, false), owner(0), next(0), taking(false), owner_bus(0), owner_idle(0) {
+        context.reset(new VerilatedContext);
+        if (!args().empty()) {
+            context->commandArgs(int(args().size()), args().data());
+        }
+        std::shared_ptr<const RomImage> rom = preload_rom();
+        for (unsigned i = 0; i < count; i++) {
+            Vfx68k* cpu = new Vfx68k(context.get());
+            cpu->clk = 0;
+            cpu->extReset = 1;
+            cpu->pwrUp = 1;
+            cpu->enPhi1 = 1;
+            cpu->enPhi2 = 0;
+            cpu->HALTn = 1;
+            cpu->DTACKn = 1;
+            cpu->VPAn = 1;
+            cpu->BERRn = 1;
+            cpu->BRn = 1;
+            cpu->BGACKn = 1;
+            cpu->IPL0n = 1;
+            cpu->IPL1n = 1;
+            cpu->IPL2n = 1;
+            cpu->iEdb = 0x0000;
+            if (rom) {
+                cpu->eval();
+                rom->install(cpu);
+            }
+            cpus.push_back(cpu);
+        }
+    }
+
+    ~Fx68kSystem() {
+        for (Vfx68k* cpu : cpus) {
+            cpu->final();
+            delete cpu;
+        }
+    }
+
+    uint64_t cycles() const { return ticks >> 1; }
+
+    unsigned master() const { return owner; }
+
+    // Power up reset of every CPU. CPU 0 starts as bus master, the others held.
+    void reset() {
+        for (size_t i = 0; i < cpus.size(); i++) {
+            cpus[i]->pwrUp = 1;
+            cpus[i]->extReset = 1;
+            cpus[i]->BRn = 1;
+            cpus[i]->BGACKn = (i == 0);
+        }
+        for (int i = 0; i < 16; i++) {
+            tick();
+        }
+        for (Vfx68k* cpu : cpus) {
+            cpu->pwrUp = 0;
+            cpu->extReset = 0;
+        }
+        ticks = 0;
+        stats.assign(cpus.size(), CpuStats());
+        contention_cycles = 0;
+        handovers = 0;
+        owner = 0;
+        taking = false;
+        owner_bus = 0;
+        owner_idle = 0;
+        stats[0].grants = 1;
+    }
+
+    // One master clock edge for every CPU
+    void tick() {
+        for (Vfx68k* cpu : cpus) {
+            cpu->clk = 1;
+            cpu->eval();
+        }
+        for (size_t i = 0; i < cpus.size(); i++) {
+            service_bus(unsigned(i));
+        }
+        arbitrate();
+        phase ^= 1;
+        for (Vfx68k* cpu : cpus) {
+            cpu->enPhi1 = (phase == 0);
+            cpu->enPhi2 = (phase == 1);
+            cpu->clk = 0;
+            cpu->eval();
+        }
+        ticks++;
+        if (phase == 0) count_cycle();
+    }
+
+    void step_cycle() {
+        tick();
+        tick();
+    }
+
+    // Whole clocks until done() or max_cycles more have run, see Fx68kHarness::run_until()
+    template <class Done>
+    bool run_until(Done done, uint64_t max_cycles) {
+        uint64_t limit = cycles() + max_cycles;
+        while (!done()) {
+            if (cycles() >= limit) return false;
+            step_cycle();
+        }
+        return true;
+    }
+
+private:
+    int phase;
+    std::vector<bool> as_active;
+    unsigned owner;                 // Bus master
+    unsigned next;                  // Master to be while taking
+    bool taking;                    // BRn asserted to the master, waiting for the grant
+    uint64_t owner_bus;             // Bus cycles since the master got the bus
+    unsigned owner_idle;            // Ticks without AS
+
+    static std::vector<char*>& args() {
+        static std::vector<char*> saved;
+        return saved;
+    }
+
+    std::shared_ptr<const RomImage> preload_rom() {
+        static const char* PREFIX = "+romimage=";
+        const char* match = context->commandArgsPlusMatch(PREFIX + 1);
+        if (!*match) {
+            return nullptr;
+        }
+        std::string error;
+        std::shared_ptr<const RomImage> rom = RomImage::shared(match + std::strlen(PREFIX), error);
+        if (!rom) {
+            std::cerr << "Error: " << error << std::endl;
+            std::exit(1);
+        }
+        const char* preload[] = { "+fx68k_rom_preload" };
+        context->commandArgsAdd(1, preload);
+        return rom;
+    }
+
+    bool waiting(unsigned i) const { return cpus[i]->rootp->fx68k__DOT__wClk; }
+
+    void service_bus(unsigned i) {
+        Vfx68k* cpu = cpus[i];
+        if (!cpu->ASn) {
+            as_active[i] = true;
+            uint32_t addr = cpu->eab << 1;
+            if (cpu->eRWn) {
+                cpu->iEdb = (addr == CPU_ID_ADDR) ? uint16_t(i) : mem.read_word(addr);
+            } else if (!cpu->UDSn || !cpu->LDSn) {
+                mem.bus_write(cpu->eab, cpu->oEdb, !cpu->UDSn, !cpu->LDSn);
+            }
+            cpu->DTACKn = 0;
+        } else {
+            if (as_active[i]) {
+                as_active[i] = false;
+                stats[i].bus_cycles++;
+                if (i == owner) owner_bus++;
+            }
+            cpu->DTACKn = 1;
+        }
+    }
+
+    void arbitrate() {
+        Vfx68k* m = cpus[owner];
+        owner_idle = m->ASn ? owner_idle + 1 : 0;
+        if (taking) {
+            if (!m->BGn && m->ASn) {
+                m->BGACKn = 0;
+                m->BRn = 1;
+                cpus[next]->BGACKn = 1;
+                owner = next;
+                taking = false;
+                owner_bus = 0;
+                owner_idle = 0;
+                stats[owner].grants++;
+                handovers++;
+            }
+            return;
+        }
+        if (owner_bus < quantum && owner_idle < IDLE_TICKS) return;
+        for (size_t n = 1; n < cpus.size(); n++) {
+            unsigned i = unsigned((owner + n) % cpus.size());
+            if (waiting(i)) {
+                next = i;
+                taking = true;
+                m->BRn = 0;
+                return;
+            }
+        }
+    }
+
+    void count_cycle() {
+        bool busy = !cpus[owner]->ASn;
+        bool contended = false;
+        for (size_t i = 0; i < cpus.size(); i++) {
+            bool stalled = waiting(unsigned(i));
+            stats[i].stall_cycles += stalled;
+            if (i != owner) {
+                stats[i].held_cycles++;
+                contended |= stalled && busy;
+            }
+        }
+        contention_cycles += contended;
+    }
+};
+
+#endif // FX68K_SYSTEM_H
@@ -0,0 +1,130 @@
+// GDB server for guest code on the fx68k RTL
+//
+// Loads raw binary images like fx68k_profile, resets the core and stops at the first
+// instruction, then waits for gdb on 127.0.0.1:PORT or a Unix socket (gdbstub.h):
+//
+//     m68k-elf-gdb prog.elf -ex "target remote :2331"
+//
+// --reverse keeps a history of the run for reverse-step/reverse-continue (reverse.h); the
+// model is built with --savable for that.
+#include "fx68k_harness.h"
+#include "gdbstub.h"
+#include "reverse.h"
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// FILE or FILE@ADDR (hex), big endian image as seen by the CPU
+static bool load_image(Fx68kHarness& hw, const std::string& spec) {
+    size_t at = spec.rfind('@');
+    std::string filename = spec.substr(0, at);
+    uint32_t addr = (at == std::string::npos) ? 0 : std::stoul(spec.substr(at + 1), nullptr, 16);
+
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open " << filename << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    bytes.resize((bytes.size() + 1) & ~size_t(1));
+
+    std::vector<uint16_t> words(bytes.size() / 2);
+    for (size_t i = 0; i < words.size(); i++) {
+        words[i] = (bytes[i * 2] << 8) | bytes[i * 2 + 1];
+    }
+    hw.mem.load(addr, words);
+    std::cout << "Loaded " << filename << " at $" << std::hex << addr << std::dec
+              << " (" << bytes.size() << " bytes)" << std::endl;
+    return true;
+}
+
+static void print_help(const char* prog) {
+    std::cout << "Usage: " << prog << " [options] --load FILE[@ADDR] ..." << std::endl;
+    std::cout << "  --load FILE[@ADDR]  Raw binary image, hex load address (default 0, vectors included)" << std::endl;
+    std::cout << "  --port N            TCP port on 127.0.0.1 (default 2331)" << std::endl;
+    std::cout << "  --unix PATH         Unix socket instead of TCP" << std::endl;
+    std::cout << "  --reverse           Keep a history for reverse-step and reverse-continue" << std::endl;
+    std::cout << "  --history-mb N      History budget (default 256)" << std::endl;
+    std::cout << "  --snapshot-every N  Cycles between history snapshots (default 100000)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    Verilated::commandArgs(argc, argv);
+    Fx68kHarness::command_args(argc, argv);
+
+    std::vector<std::string> images;
+    int port = 2331;
+    std::string unix_path;
+    bool reverse = false;
+    uint64_t history_mb = ReverseExecution::DEFAULT_BUDGET >> 20;
+    uint64_t snapshot_every = ReverseExecution::DEFAULT_INTERVAL;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--load" && i + 1 < argc) {
+            images.push_back(argv[++i]);
+        } else if (arg == "--port" && i + 1 < argc) {
+            port = std::stoi(argv[++i]);
+        } else if (arg == "--unix" && i + 1 < argc) {
+            unix_path = argv[++i];
+        } else if (arg == "--reverse") {
+            reverse = true;
+        } else if (arg == "--history-mb" && i + 1 < argc) {
+            history_mb = std::stoull(argv[++i]);
+        } else if (arg == "--snapshot-every" && i + 1 < argc) {
+            snapshot_every = std::stoull(argv[++i]);
+        } else if (arg == "--help" || arg == "-h") {
+            print_help(argv[0]);
+            return 0;
+        }
+    }
+
+    if (images.empty()) {
+        print_help(argv[0]);
+        return 2;
+    }
+
+    std::cout << "Fx68k GDB Server" << std::endl;
+    std::cout << "================" << std::endl;
+
+    Telemetry::process().set_test(0, "gdb " + images[0]);
+    Fx68kHarness hw;
+    for (const std::string& spec : images) {
+        if (!load_image(hw, spec)) {
+            return 2;
+        }
+    }
+
+    std::unique_ptr<ReverseExecution> rev;
+    if (reverse) rev.reset(new ReverseExecution(hw, history_mb << 20, snapshot_every));
+    GdbStub stub(hw, rev.get());
+    std::string error;
+    if (!stub.start(error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    if (!(unix_path.empty() ? stub.listen_tcp(port, error) : stub.listen_unix(unix_path, error))) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+    std::cout << "Stopped at the first instruction, waiting for gdb on "
+              << (unix_path.empty() ? "127.0.0.1:" + std::to_string(port) : unix_path)
+              << (rev ? " (reverse execution on)" : "") << std::endl;
+    if (!stub.serve(error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+
+    const GdbStub::Stats& s = stub.stats;
+    std::cout << "\n=== GDB Server Summary ===" << std::endl;
+    std::cout << "Cycles: " << hw.cycles() << (hw.halted() ? " (CPU halted)" : "") << std::endl;
+    std::cout << "Packets: " << s.packets << ", resumes: " << s.resumes << ", reverse: " << s.reverse << std::endl;
+    std::cout << "Breakpoint hits: " << s.breakpoint_hits << ", watchpoint hits: " << s.watch_hits << std::endl;
+    if (rev) {
+        std::printf("History: %zu snapshots, %.2f MB, %llu edges replayed\n", rev->snapshot_count(),
+                    rev->bytes() / 1048576.0, (unsigned long long)rev->stats.replayed_ticks);
+    }
+    return 0;
+}
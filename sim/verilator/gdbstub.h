@@ -0,0 +1,686 @@
+// GDB remote serial protocol stub for a harness
+//
+// GdbStub serves one gdb (m68k-elf-gdb, gdb-multiarch) over a local TCP port or a Unix
+// socket: "target remote :PORT" or "target remote PATH". It offers registers D0-D7, A0-A7,
+// SR and PC through a target description, memory read and write, breakpoints (Z0/Z1, the
+// guest code is not patched), write/read/access watchpoints (Z2-Z4), continue, single step
+// and Ctrl-C. With a ReverseExecution (reverse.h) it also takes reverse-step and
+// reverse-continue.
+//
+// The core stops right after the clock edge that loads IRD, before the instruction changes
+// anything: PC is the address of that instruction (ArchState::pc() runs ahead with prefetch).
+// A watchpoint stops at the instruction start that follows the access. 's' steps one
+// instruction, or after "monitor step-mode bus" one bus cycle, or after "monitor step-mode
+// halt" one bus cycle through HALTn, the way 68000 hardware single steps: HALTn goes high
+// until the core starts a bus cycle and low again, and the core waits after that cycle. The
+// core then stays held until the next continue.
+//
+// Breakpoints and watchpoints mark their pages in FlatMemory; the instruction and bus hooks
+// look up the exact address only in a marked page, so they can stay armed at full speed.
+//
+// PC can only be written with its current value, see arch_state.h.
+#ifndef FX68K_GDBSTUB_H
+#define FX68K_GDBSTUB_H
+
+#include "fx68k_harness.h"
+#include "arch_state.h"
+#include "reverse.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+class GdbStub : public InstructionObserver, public WatchTarget {
+public:
+    enum RunMode { CONTINUE, STEP_INSTRUCTION, STEP_BUS, STEP_HALT };
+
+    static const int SIGINT_GDB = 2;
+    static const int SIGTRAP_GDB = 5;
+    static const int SIGBUS_GDB = 10;
+    static const uint64_t POLL_TICKS = 0x4000;         // Between checks for Ctrl-C
+    static const uint64_t STARTUP_CYCLES = 1000;       // Reset to the first instruction
+    static const uint64_t BUS_STEP_TICKS = 10000;      // Longest wait for a bus cycle
+
+    struct Stats {
+        uint64_t packets;
+        uint64_t resumes;
+        uint64_t breakpoint_hits;
+        uint64_t watch_hits;
+        uint64_t reverse;
+    };
+
+    Stats stats;
+    RunMode step_mode;              // What 's' does
+
+    // rev, if given, must not be started yet: start() does that
+    GdbStub(Fx68kHarness& hw, ReverseExecution* rev = nullptr)
+        : stats(), step_mode(STEP_INSTRUCTION), hw(hw), rev(rev), listen_fd(-1), fd(-1), no_ack(false),
+          running(false), mode(STEP_INSTRUCTION), stop_now(false), pc(0), stop_reply("S05"), watch_pending(false),
+          hit(), hit_addr(0), hit_tick(0), last_pred(0), halt_held(false) {
+        hw.insn_observer = this;
+        hw.watch = this;
+    }
+
+    ~GdbStub() {
+        if (fd >= 0) close(fd);
+        if (listen_fd >= 0) close(listen_fd);
+        if (!unix_path.empty()) unlink(unix_path.c_str());
+        hw.insn_observer = nullptr;
+        hw.watch = nullptr;
+    }
+
+    // Reset, and stop at the first instruction
+    bool start(std::string& error) {
+        hw.cpu->HALTn = 1;
+        halt_held = false;
+        hw.reset();
+        if (!hw.run_until([&] { return hw.ird_load_pending(); }, STARTUP_CYCLES)) {
+            error = "core did not reach its first instruction after reset";
+            return false;
+        }
+        hw.tick();
+        if (rev && !rev->start(error)) return false;
+        stop_reply = "S05";
+        return true;
+    }
+
+    bool listen_tcp(int port, std::string& error) {
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr = sockaddr_in();
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(uint16_t(port));
+        if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+            || listen(listen_fd, 1) != 0) {
+            error = "could not listen on 127.0.0.1:" + std::to_string(port) + ": " + std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    bool listen_unix(const std::string& path, std::string& error) {
+        sockaddr_un addr = sockaddr_un();
+        if (path.size() >= sizeof(addr.sun_path)) {
+            error = "socket path too long: " + path;
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        unlink(path.c_str());
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+            || listen(listen_fd, 1) != 0) {
+            error = "could not listen on " + path + ": " + std::strerror(errno);
+            return false;
+        }
+        unix_path = path;
+        return true;
+    }
+
+    // Waits for gdb, then serves it until it detaches, kills or goes away
+    bool serve(std::string& error) {
+        fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            error = std::string("accept: ") + std::strerror(errno);
+            return false;
+        }
+        if (unix_path.empty()) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        std::string packet;
+        while (read_packet(packet)) {
+            stats.packets++;
+            if (!handle(packet)) break;
+        }
+        close(fd);
+        fd = -1;
+        return true;
+    }
+
+    void instruction(uint32_t addr, uint16_t, uint64_t) override {
+        pc = addr;
+        if (!running) return;
+        if (mode == STEP_INSTRUCTION || watch_pending) stop_now = true;
+        if (breakpoint(addr)) {
+            stop_now = true;
+            stats.breakpoint_hits++;
+        }
+    }
+
+    void watch_hit(const BusCycle& cycle) override {
+        if ((cycle.fc & 3) == 2) return;               // Program fetches are not data reads
+        uint32_t lo = cycle.addr + (cycle.upper || !cycle.lower ? 0 : 1);
+        uint32_t hi = cycle.addr + (cycle.lower || !cycle.upper ? 2 : 1);
+        for (const Watchpoint& w : watchpoints) {
+            if (lo >= w.addr + w.size || hi <= w.addr) continue;
+            if (w.type == WATCH_WRITE && !cycle.write) continue;
+            if (w.type == WATCH_READ && cycle.write) continue;
+            watch_pending = true;
+            hit = w;
+            hit_addr = std::max(lo, w.addr);
+            hit_tick = rev ? rev->position() : 0;
+            if (running) stats.watch_hits++;
+            return;
+        }
+    }
+
+private:
+    // Z packet types 2-4
+    enum WatchType { WATCH_WRITE = 2, WATCH_READ = 3, WATCH_ACCESS = 4 };
+
+    struct Watchpoint {
+        uint32_t addr;
+        uint32_t size;
+        int type;
+    };
+
+    Fx68kHarness& hw;
+    ReverseExecution* rev;
+    int listen_fd;
+    int fd;
+    std::string unix_path;
+    bool no_ack;
+
+    bool running;                   // Inside resume()
+    RunMode mode;                   // Of this resume
+    bool stop_now;                  // Stop after the current edge
+    uint32_t pc;                    // Opcode address of the last instruction start
+    std::string stop_reply;         // Of the last stop, for '?'
+
+    std::unordered_set<uint32_t> breakpoints;
+    std::vector<Watchpoint> watchpoints;
+    bool watch_pending;             // Hit since the last instruction start
+    Watchpoint hit;
+    uint32_t hit_addr;
+    uint64_t hit_tick;              // Position of the hit, with reverse execution
+    uint64_t last_pred;             // Position of the last reverse_continue() check
+
+    bool halt_held;                 // HALTn low after a STEP_HALT
+
+    bool breakpoint(uint32_t addr) const {
+        return (hw.mem.marks(addr) & FlatMemory::MARK_EXEC) && breakpoints.count(addr);
+    }
+
+    void update_marks() {
+        hw.mem.clear_marks();
+        for (uint32_t addr : breakpoints) hw.mem.mark(addr, 2, FlatMemory::MARK_EXEC);
+        for (const Watchpoint& w : watchpoints) {
+            uint8_t bits = w.type == WATCH_WRITE ? FlatMemory::MARK_WRITE
+                         : w.type == WATCH_READ ? FlatMemory::MARK_READ
+                         : FlatMemory::MARK_READ | FlatMemory::MARK_WRITE;
+            hw.mem.mark(w.addr, w.size, bits);
+        }
+    }
+
+    void tick() {
+        if (rev) {
+            rev->tick();
+        } else {
+            hw.tick();
+        }
+    }
+
+    // -- Running
+
+    // Clocks until a breakpoint, watchpoint, the end of a step, a halted core or Ctrl-C
+    std::string resume(RunMode how) {
+        stats.resumes++;
+        if (hw.halted()) return stop(SIGBUS_GDB, "");
+        if (how == STEP_HALT) return halt_step();
+        release_halt();
+        running = true;
+        mode = how;
+        stop_now = false;
+        watch_pending = false;
+        uint64_t bus_count = hw.bus.reads + hw.bus.writes + hw.bus.iack;
+        int signal = SIGTRAP_GDB;
+        for (uint64_t n = 1; ; n++) {
+            tick();
+            if (stop_now) break;
+            if (how == STEP_BUS && hw.bus.reads + hw.bus.writes + hw.bus.iack != bus_count) break;
+            if (hw.halted()) {
+                signal = SIGBUS_GDB;
+                break;
+            }
+            if (n % POLL_TICKS == 0 && interrupted()) {
+                signal = SIGINT_GDB;
+                break;
+            }
+        }
+        running = false;
+        if (signal != SIGTRAP_GDB) return stop(signal, "");
+        if (watch_pending) return stop_watch();
+        return stop(SIGTRAP_GDB, how == CONTINUE ? "swbreak:;" : "");
+    }
+
+    // The core ends the bus cycle it is in, then starts one more and waits after it
+    std::string halt_step() {
+        Vfx68k* cpu = hw.cpu;
+        if (!halt_held) {
+            cpu->HALTn = 0;
+            halt_held = true;
+        } else {
+            cpu->HALTn = 1;
+            for (uint64_t n = 0; n < BUS_STEP_TICKS && cpu->ASn; n++) tick();
+            cpu->HALTn = 0;
+        }
+        for (uint64_t n = 0; n < BUS_STEP_TICKS && !cpu->ASn; n++) tick();
+        // A couple more edges for the arbiter to see HALTn before the next cycle could start
+        for (int n = 0; n < 4; n++) tick();
+        return stop(SIGTRAP_GDB, "");
+    }
+
+    void release_halt() {
+        if (halt_held) hw.cpu->HALTn = 1;
+        halt_held = false;
+    }
+
+    // A Ctrl-C from gdb while running
+    bool interrupted() {
+        pollfd p = { fd, POLLIN, 0 };
+        if (poll(&p, 1, 0) <= 0) return false;
+        char c = 0;
+        return recv(fd, &c, 1, 0) == 1 && c == 0x03;
+    }
+
+    std::string stop(int signal, const std::string& reason) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "T%02x", signal);
+        stop_reply = buf + reason;
+        return stop_reply;
+    }
+
+    std::string stop_watch() {
+        const char* kind = hit.type == WATCH_WRITE ? "watch" : hit.type == WATCH_READ ? "rwatch" : "awatch";
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%s:%x;", kind, hit_addr);
+        watch_pending = false;
+        return stop(SIGTRAP_GDB, buf);
+    }
+
+    // -- Reverse
+
+    std::string reverse(bool step) {
+        if (!rev) return "E01";
+        stats.reverse++;
+        release_halt();
+        std::string error;
+        bool found;
+        bool by_watch = false;
+        Watchpoint watch_found = Watchpoint();
+        uint32_t watch_addr = 0;
+        if (step) {
+            found = rev->reverse_step(error);
+        } else {
+            last_pred = 0;
+            found = rev->reverse_continue([&](uint32_t addr) {
+                // A watch hit since the previous instruction start. Scans go back a snapshot
+                // interval at a time, a hit left from a later interval is ahead of now.
+                uint64_t now = rev->position();
+                uint64_t from = last_pred <= now ? last_pred : 0;
+                last_pred = now;
+                bool watched = watch_pending && hit_tick < now && hit_tick >= from;
+                watch_pending = false;
+                if (!watched && !breakpoint(addr)) return false;
+                // The last match of the scan is where it stops
+                by_watch = watched;
+                watch_found = hit;
+                watch_addr = hit_addr;
+                return true;
+            }, error);
+        }
+        pc = rev->boundary_addr;
+        watch_pending = false;
+        halt_held = !hw.cpu->HALTn;
+        if (!found) return stop(SIGTRAP_GDB, "replaylog:begin;");
+        if (by_watch) {
+            hit = watch_found;
+            hit_addr = watch_addr;
+            return stop_watch();
+        }
+        return stop(SIGTRAP_GDB, step ? "" : "swbreak:;");
+    }
+
+    // -- Packets
+
+    static int hex_digit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    static std::string hex(const std::string& bytes) {
+        static const char* digits = "0123456789abcdef";
+        std::string s;
+        for (unsigned char c : bytes) {
+            s += digits[c >> 4];
+            s += digits[c & 15];
+        }
+        return s;
+    }
+
+    static std::string unhex(const std::string& s) {
+        std::string bytes;
+        for (size_t i = 0; i + 1 < s.size(); i += 2) {
+            bytes += char(hex_digit(s[i]) * 16 + hex_digit(s[i + 1]));
+        }
+        return bytes;
+    }
+
+    static std::string hex32(uint32_t v) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "%08x", v);
+        return buf;
+    }
+
+    static uint32_t parse_hex(const std::string& s, size_t& pos) {
+        uint32_t v = 0;
+        for (int d; pos < s.size() && (d = hex_digit(s[pos])) >= 0; pos++) v = (v << 4) | d;
+        return v;
+    }
+
+    bool read_byte(char& c) {
+        return recv(fd, &c, 1, 0) == 1;
+    }
+
+    // The next packet, acknowledged, with '}' escapes removed
+    bool read_packet(std::string& packet) {
+        for (;;) {
+            char c;
+            do {
+                if (!read_byte(c)) return false;
+            } while (c != '$');
+            packet.clear();
+            uint8_t sum = 0;
+            bool escape = false;
+            while (read_byte(c) && c != '#') {
+                sum += uint8_t(c);
+                if (escape) {
+                    packet += char(c ^ 0x20);
+                    escape = false;
+                } else if (c == '}') {
+                    escape = true;
+                } else {
+                    packet += c;
+                }
+            }
+            char check[2];
+            if (!read_byte(check[0]) || !read_byte(check[1])) return false;
+            bool ok = hex_digit(check[0]) * 16 + hex_digit(check[1]) == sum;
+            if (!no_ack && send(fd, ok ? "+" : "-", 1, 0) != 1) return false;
+            if (ok) return true;
+        }
+    }
+
+    void send_packet(const std::string& data) {
+        uint8_t sum = 0;
+        for (unsigned char c : data) sum += c;
+        char tail[4];
+        std::snprintf(tail, sizeof(tail), "#%02x", sum);
+        std::string out = "$" + data + tail;
+        for (;;) {
+            if (send(fd, out.data(), out.size(), 0) != ssize_t(out.size()) || no_ack) return;
+            char c;
+            do {
+                if (!read_byte(c)) return;
+            } while (c != '+' && c != '-');
+            if (c == '+') return;
+        }
+    }
+
+    // False to end the session
+    bool handle(const std::string& p) {
+        char cmd = p.empty() ? 0 : p[0];
+        switch (cmd) {
+        case '?':
+            send_packet(stop_reply);
+            return true;
+        case 'g':
+            send_packet(read_registers());
+            return true;
+        case 'G':
+            send_packet(write_registers(p.substr(1)));
+            return true;
+        case 'p': {
+            size_t pos = 1;
+            uint32_t n = parse_hex(p, pos);
+            send_packet(n < 18 ? read_registers().substr(n * 8, 8) : "E01");
+            return true;
+        }
+        case 'P': {
+            size_t pos = 1;
+            uint32_t n = parse_hex(p, pos);
+            pos++;
+            send_packet(write_register(n, parse_hex(p, pos)) ? "OK" : "E01");
+            return true;
+        }
+        case 'm':
+        case 'M':
+        case 'X':
+            send_packet(memory(p));
+            return true;
+        case 'c':
+        case 'C':
+            send_packet(resume(CONTINUE));
+            return true;
+        case 's':
+        case 'S':
+            send_packet(resume(step_mode));
+            return true;
+        case 'b':
+            if (p == "bs" || p == "bc") {
+                send_packet(reverse(p == "bs"));
+            } else {
+                send_packet("");
+            }
+            return true;
+        case 'Z':
+        case 'z':
+            send_packet(point(p));
+            return true;
+        case 'H':
+        case 'T':
+            send_packet("OK");
+            return true;
+        case 'D':
+            send_packet("OK");
+            return false;
+        case 'k':
+            return false;
+        case 'Q':
+            if (p == "QStartNoAckMode") {
+                send_packet("OK");
+                no_ack = true;
+            } else {
+                send_packet("");
+            }
+            return true;
+        case 'q':
+            send_packet(query(p));
+            return true;
+        case 'v':
+            if (p.compare(0, 6, "vKill;") == 0) {
+                send_packet("OK");
+                return false;
+            }
+            send_packet("");
+            return true;
+        default:
+            send_packet("");
+            return true;
+        }
+    }
+
+    // D0-D7, A0-A7, SR, PC, as in the target description
+    std::string read_registers() const {
+        ArchState arch(hw.cpu);
+        std::string s;
+        for (int i = 0; i < 8; i++) s += hex32(arch.d(i));
+        for (int i = 0; i < 8; i++) s += hex32(arch.a(i));
+        s += hex32(arch.sr());
+        s += hex32(pc);
+        return s;
+    }
+
+    bool write_register(uint32_t n, uint32_t value) {
+        ArchState arch(hw.cpu);
+        if (n < 8) {
+            arch.set_d(n, value);
+        } else if (n < 16) {
+            arch.set_a(n - 8, value);
+        } else if (n == 16) {
+            arch.set_sr(uint16_t(value));
+        } else if (n == 17) {
+            return (value & FlatMemory::ADDR_MASK) == pc;
+        } else {
+            return false;
+        }
+        if (rev) rev->external_change();
+        return true;
+    }
+
+    std::string write_registers(const std::string& data) {
+        bool ok = true;
+        for (uint32_t n = 0; n < 18 && (n + 1) * 8 <= data.size(); n++) {
+            size_t pos = n * 8;
+            uint32_t value = parse_hex(data.substr(0, (n + 1) * 8), pos);
+            ok &= write_register(n, value);
+        }
+        return ok ? "OK" : "E01";
+    }
+
+    // m addr,len / M addr,len:hex / X addr,len:binary
+    std::string memory(const std::string& p) {
+        size_t pos = 1;
+        uint32_t addr = parse_hex(p, pos);
+        pos++;
+        uint32_t len = parse_hex(p, pos);
+        if (p[0] == 'm') {
+            std::string bytes;
+            for (uint32_t i = 0; i < len; i++) bytes += char(hw.mem.read_byte(addr + i));
+            return hex(bytes);
+        }
+        if (pos >= p.size() || p[pos] != ':') return "E01";
+        std::string data = p.substr(pos + 1);
+        if (p[0] == 'M') data = unhex(data);
+        if (data.size() < len) return "E01";
+        for (uint32_t i = 0; i < len; i++) hw.mem.write_byte(addr + i, uint8_t(data[i]));
+        return "OK";
+    }
+
+    // Z/z TYPE,ADDR,KIND
+    std::string point(const std::string& p) {
+        bool insert = p[0] == 'Z';
+        size_t pos = 1;
+        uint32_t type = parse_hex(p, pos);
+        pos++;
+        uint32_t addr = parse_hex(p, pos) & FlatMemory::ADDR_MASK;
+        pos++;
+        uint32_t size = parse_hex(p, pos);
+        if (type <= 1) {
+            if (insert) {
+                breakpoints.insert(addr);
+            } else {
+                breakpoints.erase(addr);
+            }
+        } else if (type <= 4) {
+            if (!size) return "E01";
+            for (auto it = watchpoints.begin(); it != watchpoints.end(); ++it) {
+                if (it->addr == addr && it->size == size && it->type == int(type)) {
+                    watchpoints.erase(it);
+                    break;
+                }
+            }
+            if (insert) watchpoints.push_back(Watchpoint{ addr, size, int(type) });
+        } else {
+            return "";
+        }
+        update_marks();
+        return "OK";
+    }
+
+    std::string query(const std::string& p) {
+        if (p.compare(0, 10, "qSupported") == 0) {
+            return std::string("PacketSize=4000;QStartNoAckMode+;qXfer:features:read+;swbreak+;hwbreak+")
+                   + (rev ? ";ReverseStep+;ReverseContinue+" : "");
+        }
+        if (p.compare(0, 31, "qXfer:features:read:target.xml:") == 0) {
+            size_t pos = 31;
+            uint32_t offset = parse_hex(p, pos);
+            pos++;
+            uint32_t length = parse_hex(p, pos);
+            std::string xml = target_xml();
+            if (offset >= xml.size()) return "l";
+            std::string part = xml.substr(offset, length);
+            return (offset + part.size() < xml.size() ? "m" : "l") + part;
+        }
+        if (p == "qAttached") return "1";
+        if (p == "qC") return "QC1";
+        if (p == "qfThreadInfo") return "m1";
+        if (p == "qsThreadInfo") return "l";
+        if (p.compare(0, 8, "qSymbol:") == 0) return "OK";
+        if (p.compare(0, 6, "qRcmd,") == 0) return monitor(unhex(p.substr(6)));
+        return "";
+    }
+
+    static std::string target_xml() {
+        std::string s = "<?xml version=\"1.0\"?><!DOCTYPE target SYSTEM \"gdb-target.dtd\"><target version=\"1.0\">"
+                        "<architecture>m68k</architecture><feature name=\"org.gnu.gdb.m68k.core\">";
+        for (int i = 0; i < 8; i++) s += "<reg name=\"d" + std::to_string(i) + "\" bitsize=\"32\"/>";
+        for (int i = 0; i < 6; i++) s += "<reg name=\"a" + std::to_string(i) + "\" bitsize=\"32\" type=\"data_ptr\"/>";
+        s += "<reg name=\"fp\" bitsize=\"32\" type=\"data_ptr\"/><reg name=\"sp\" bitsize=\"32\" type=\"data_ptr\"/>"
+             "<reg name=\"ps\" bitsize=\"32\"/><reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\"/>"
+             "</feature></target>";
+        return s;
+    }
+
+    // "monitor ..." commands, the text goes back in O packets
+    std::string monitor(const std::string& line) {
+        std::istringstream in(line);
+        std::string cmd, arg;
+        in >> cmd >> arg;
+        std::ostringstream out;
+        if (cmd == "step-mode" && (arg == "insn" || arg == "bus" || arg == "halt")) {
+            step_mode = arg == "insn" ? STEP_INSTRUCTION : arg == "bus" ? STEP_BUS : STEP_HALT;
+            out << "stepi now steps one " << (arg == "insn" ? "instruction" : "bus cycle")
+                << (arg == "halt" ? " through HALTn" : "") << "\n";
+        } else if (cmd == "cycles") {
+            out << "cycle " << hw.cycles() << ", " << hw.bus.reads << " reads, " << hw.bus.writes << " writes, "
+                << hw.bus.iack << " acknowledges" << (halt_held ? ", held by HALTn" : "") << "\n";
+        } else if (cmd == "history" && rev) {
+            char buf[160];
+            std::snprintf(buf, sizeof(buf), "clock edges %llu-%llu, at %llu, %zu snapshots, %.2f MB\n",
+                          (unsigned long long)rev->earliest(), (unsigned long long)rev->latest(),
+                          (unsigned long long)rev->position(), rev->snapshot_count(), rev->bytes() / 1048576.0);
+            out << buf;
+        } else if (cmd == "reset") {
+            std::string error;
+            if (!start(error)) return "E01";
+            out << "reset, stopped at the first instruction; flushregs to see it\n";
+        } else {
+            out << "monitor step-mode insn|bus|halt  what stepi does\n"
+                << "monitor cycles                   clock and bus counts\n"
+                << "monitor reset                    reset the core\n";
+            if (rev) out << "monitor history                  reverse execution history\n";
+        }
+        send_packet("O" + hex(out.str()));
+        return "OK";
+    }
+};
+
+#endif // FX68K_GDBSTUB_H
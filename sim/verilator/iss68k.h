@@ -0,0 +1,1021 @@
+// Instruction level 68000 model, to fast-forward a guest before the RTL takes over
+//
+// Iss68k executes one whole instruction per step() on a FlatMemory, with no bus cycles or
+// timing: SR, the data and address registers, both stack pointers and PC are all there is.
+// Exceptions raised by instructions (TRAP, TRAPV, CHK, divide by zero, privilege violation,
+// illegal and line A/F opcodes) are processed as on the 68000. There are no interrupts.
+//
+// Anything it does not model stops it before the instruction, with the state as it was:
+// address errors, trace, STOP, RESET, accesses to I/O windows (a HostChannel, E bus devices)
+// and opcodes it does not decode. Memory writes of the aborted instruction are rolled back
+// from an undo log, so the RTL can run that instruction itself. See fast_forward.h.
+//
+// Flags the 68000 leaves undefined (N/Z/V of the BCD and divide overflow cases, CHK's Z/V/C)
+// follow the usual software models and may differ from the core.
+#ifndef FX68K_ISS68K_H
+#define FX68K_ISS68K_H
+
+#include "fx68k_harness.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class Iss68k {
+public:
+    enum Stop {
+        RUNNING,
+        TARGET_PC,                  // run() reached the PC asked for
+        INSTRUCTION_LIMIT,
+        UNMODELLED,                 // Opcode, STOP or RESET left to the RTL
+        ADDRESS_ERROR,
+        TRACE,                      // T set, the trace exception is left to the RTL
+        IO_ACCESS,
+    };
+
+    static const uint32_t NO_TARGET = ~0u;
+
+    uint32_t d[8];
+    uint32_t a[8];                  // a[7] is the stack pointer of the current mode
+    uint32_t pc;
+    uint16_t sr;
+    uint64_t instructions;
+    uint32_t stop_pc;               // Instruction the last stop happened on
+    const EBus* ebus;               // Its device ranges are I/O windows
+
+    explicit Iss68k(FlatMemory& mem) : pc(0), sr(0x2700), instructions(0), stop_pc(0), ebus(nullptr),
+                                       mem(mem), other_sp(0), fault(RUNNING), insn_pc(0) {
+        for (int i = 0; i < 8; i++) d[i] = a[i] = 0;
+    }
+
+    static const char* stop_name(Stop s) {
+        static const char* NAMES[] = { "running", "target PC", "instruction limit", "unmodelled instruction",
+                                       "address error", "trace", "I/O access" };
+        return NAMES[s];
+    }
+
+    // Length of an instruction in words, opcode included. On the 68000 it follows from the
+    // opcode alone. Encodings the model does not decode count as one word.
+    static unsigned words(uint16_t op) {
+        int mode = (op >> 3) & 7, reg = op & 7;
+        int bits = (op >> 6) & 3, opmode = (op >> 6) & 7;
+        switch (op >> 12) {
+        case 0x0:
+            if ((op & 0x0138) == 0x0108) return 2;
+            if (op & 0x0100) return 1 + ea_words(mode, reg, 1);
+            if ((op & 0x0F00) == 0x0800) return 2 + ea_words(mode, reg, 1);
+            if (bits == 3) return 1;
+            if (mode == 7 && reg == 4) return 2;
+            return 1 + (bits == 2 ? 2 : 1) + ea_words(mode, reg, size_of(bits));
+        case 0x1:
+        case 0x2:
+        case 0x3: {
+            int size = (op >> 12) == 1 ? 1 : (op >> 12) == 2 ? 4 : 2;
+            return 1 + ea_words(mode, reg, size) + ea_words((op >> 6) & 7, (op >> 9) & 7, size);
+        }
+        case 0x4:
+            if ((op & 0xFFF8) == 0x4E50 || op == 0x4E72) return 2;
+            if ((op & 0xFFC0) == 0x4E40 || op == 0x4AFC) return 1;
+            if ((op & 0xFB80) == 0x4880 && mode != 0) return 2 + ea_words(mode, reg, 4);
+            if ((op & 0xF900) == 0x4000 || (op & 0xFF00) == 0x4A00) {
+                return 1 + ea_words(mode, reg, bits == 3 ? 2 : size_of(bits));
+            }
+            return 1 + ea_words(mode, reg, (op & 0x01C0) == 0x01C0 || (op & 0xFFC0) == 0x4840 ? 4 : 2);
+        case 0x5:
+            if (bits == 3 && mode == 1) return 2;
+            return 1 + ea_words(mode, reg, bits == 3 ? 1 : size_of(bits));
+        case 0x6:
+            return (op & 0xFF) ? 1 : 2;
+        case 0x8:
+        case 0x9:
+        case 0xB:
+        case 0xC:
+        case 0xD: {
+            int size = opmode == 3 ? 2 : opmode == 7 ? (((op >> 12) & 3) == 0 ? 2 : 4) : size_of(opmode & 3);
+            return 1 + ea_words(mode, reg, size);
+        }
+        case 0xE:
+            return bits == 3 ? 1 + ea_words(mode, reg, 2) : 1;
+        default:
+            return 1;
+        }
+    }
+
+    // Any access to [base, base + size) stops the model
+    void add_io(uint32_t base, uint32_t size) { io.push_back(std::make_pair(base, base + size)); }
+
+    // The reset exception: SSP and PC from vectors 0 and 1, supervisor mode, interrupts masked
+    void reset() {
+        sr = 0x2700;
+        a[7] = mem.read_long(0);
+        other_sp = 0;
+        pc = mem.read_long(4) & FlatMemory::ADDR_MASK;
+        instructions = 0;
+    }
+
+    bool supervisor() const { return sr & SR_S; }
+    uint32_t usp() const { return supervisor() ? other_sp : a[7]; }
+    uint32_t ssp() const { return supervisor() ? a[7] : other_sp; }
+
+    // Switches a[7] when S changes
+    void set_sr(uint16_t value) {
+        value &= 0xA71F;
+        if ((value ^ sr) & SR_S) std::swap(a[7], other_sp);
+        sr = value;
+    }
+
+    // Until PC reaches target_pc at an instruction boundary, max_instructions have run, or a stop
+    Stop run(uint64_t max_instructions, uint32_t target_pc = NO_TARGET) {
+        uint64_t limit = instructions + max_instructions;
+        for (;;) {
+            if (pc == target_pc) return TARGET_PC;
+            if (instructions >= limit) return INSTRUCTION_LIMIT;
+            Stop s = step();
+            if (s != RUNNING) return s;
+        }
+    }
+
+    // One instruction, or none and the reason
+    Stop step() {
+        stop_pc = pc;
+        if (sr & SR_T) return TRACE;
+        uint32_t saved_d[8], saved_a[8];
+        std::copy(d, d + 8, saved_d);
+        std::copy(a, a + 8, saved_a);
+        uint16_t saved_sr = sr;
+        uint32_t saved_sp = other_sp;
+        undo.clear();
+        fault = RUNNING;
+        insn_pc = pc;
+
+        execute(fetch16());
+
+        if (fault != RUNNING) {
+            for (size_t i = undo.size(); i-- > 0;) mem.write_word(undo[i].first, undo[i].second);
+            std::copy(saved_d, saved_d + 8, d);
+            std::copy(saved_a, saved_a + 8, a);
+            sr = saved_sr;
+            other_sp = saved_sp;
+            pc = insn_pc;
+            return fault;
+        }
+        instructions++;
+        return RUNNING;
+    }
+
+private:
+    static const uint16_t SR_T = 0x8000, SR_S = 0x2000;
+    static const uint16_t C = 1, V = 2, Z = 4, N = 8, X = 16;
+
+    // Addressing mode classes, a bit per mode: Dn An (An) (An)+ -(An) d16(An) d8(An,Xn)
+    // abs.W abs.L d16(PC) d8(PC,Xn) #imm
+    static const unsigned ALL = 0xFFF, DATA = 0xFFD, MEMORY = 0xFFC, CONTROL = 0x7E4;
+    static const unsigned ALTERABLE = 0x1FF, DATA_ALT = 0x1FD, MEM_ALT = 0x1FC, CONTROL_ALT = 0x1E4;
+    static const int IMMEDIATE = 8;
+
+    struct Ea {
+        int mode;                   // 0 Dn, 1 An, IMMEDIATE, anything else memory at addr
+        int reg;
+        uint32_t addr;              // Or the immediate value
+    };
+
+    FlatMemory& mem;
+    std::vector<std::pair<uint32_t, uint32_t>> io;
+    uint32_t other_sp;              // Stack pointer of the other mode
+    Stop fault;
+    uint32_t insn_pc;
+    std::vector<std::pair<uint32_t, uint16_t>> undo;
+
+    static uint32_t mask(int size) { return size == 1 ? 0xFF : size == 2 ? 0xFFFF : 0xFFFFFFFF; }
+    static uint32_t msb(int size) { return size == 1 ? 0x80 : size == 2 ? 0x8000 : 0x80000000; }
+    static uint32_t sext(uint32_t v, int size) {
+        return size == 1 ? uint32_t(int32_t(int8_t(v))) : size == 2 ? uint32_t(int32_t(int16_t(v))) : v;
+    }
+    static int size_of(int bits) { return bits == 0 ? 1 : bits == 1 ? 2 : 4; }
+
+    static unsigned ea_words(int mode, int reg, int size) {
+        if (mode == 5 || mode == 6) return 1;
+        if (mode != 7) return 0;
+        return reg == 1 ? 2 : reg == 4 ? (size == 4 ? 2 : 1) : reg < 4 ? 1 : 0;
+    }
+
+    void fail(Stop reason) {
+        if (fault == RUNNING) fault = reason;
+    }
+
+    bool io_hit(uint32_t addr) const {
+        for (const auto& w : io) {
+            if (addr >= w.first && addr < w.second) return true;
+        }
+        unsigned reg;
+        bool odd_lane;
+        return ebus && ebus->decode(addr & ~1u, reg, odd_lane);
+    }
+
+    bool accessible(uint32_t addr, int size) {
+        if (fault != RUNNING) return false;
+        if (size > 1 && (addr & 1)) {
+            fail(ADDRESS_ERROR);
+            return false;
+        }
+        if (!io.empty() || ebus) {
+            if (io_hit(addr) || (size == 4 && io_hit((addr + 2) & FlatMemory::ADDR_MASK))) {
+                fail(IO_ACCESS);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint32_t read(uint32_t addr, int size) {
+        addr &= FlatMemory::ADDR_MASK;
+        if (!accessible(addr, size)) return 0;
+        return size == 1 ? mem.read_byte(addr) : size == 2 ? mem.read_word(addr) : mem.read_long(addr);
+    }
+
+    void write(uint32_t addr, int size, uint32_t value) {
+        addr &= FlatMemory::ADDR_MASK;
+        if (!accessible(addr, size)) return;
+        undo.push_back(std::make_pair(addr & ~1u, mem.read_word(addr)));
+        if (size == 1) {
+            mem.write_byte(addr, uint8_t(value));
+        } else if (size == 2) {
+            mem.write_word(addr, uint16_t(value));
+        } else {
+            uint32_t low = (addr + 2) & FlatMemory::ADDR_MASK;
+            undo.push_back(std::make_pair(low, mem.read_word(low)));
+            mem.write_word(addr, uint16_t(value >> 16));
+            mem.write_word(low, uint16_t(value));
+        }
+    }
+
+    uint16_t fetch16() {
+        if (pc & 1) {
+            fail(ADDRESS_ERROR);
+            return 0x4E71;
+        }
+        uint16_t w = mem.read_word(pc);
+        pc = (pc + 2) & FlatMemory::ADDR_MASK;
+        return w;
+    }
+
+    uint32_t fetch32() {
+        uint32_t high = fetch16();
+        return (high << 16) | fetch16();
+    }
+
+    void push(uint32_t value, int size) {
+        a[7] -= size;
+        write(a[7], size, value);
+    }
+
+    uint32_t pop(int size) {
+        uint32_t value = read(a[7], size);
+        a[7] += size;
+        return value;
+    }
+
+    void set_ccr(uint16_t bits, uint16_t affected) { sr = (sr & ~affected) | (bits & affected); }
+
+    void set_logic(uint32_t r, int size) {
+        r &= mask(size);
+        set_ccr(((r & msb(size)) ? N : 0) | (r ? 0 : Z), N | Z | V | C);
+    }
+
+    bool cond(int cc) const {
+        bool c = sr & C, v = sr & V, z = sr & Z, n = sr & N;
+        switch (cc) {
+        case 0: return true;
+        case 1: return false;
+        case 2: return !c && !z;
+        case 3: return c || z;
+        case 4: return !c;
+        case 5: return c;
+        case 6: return !z;
+        case 7: return z;
+        case 8: return !v;
+        case 9: return v;
+        case 10: return !n;
+        case 11: return n;
+        case 12: return n == v;
+        case 13: return n != v;
+        case 14: return !z && n == v;
+        default: return z || n != v;
+        }
+    }
+
+    // extend: ADDX/SUBX/NEGX, which add X and only clear Z
+    uint32_t add(uint32_t s, uint32_t dst, int size, bool extend = false) {
+        uint32_t m = mask(size), top = msb(size);
+        s &= m;
+        dst &= m;
+        uint32_t r = (s + dst + (extend && (sr & X))) & m;
+        bool c = ((s & dst) | (~r & dst) | (s & ~r)) & top;
+        bool v = ((s & dst & ~r) | (~s & ~dst & r)) & top;
+        bool z = extend ? ((sr & Z) && !r) : !r;
+        set_ccr((c ? X | C : 0) | (v ? V : 0) | (z ? Z : 0) | ((r & top) ? N : 0), X | N | Z | V | C);
+        return r;
+    }
+
+    // dst - s; compare leaves X alone
+    uint32_t sub(uint32_t s, uint32_t dst, int size, bool extend = false, bool compare = false) {
+        uint32_t m = mask(size), top = msb(size);
+        s &= m;
+        dst &= m;
+        uint32_t r = (dst - s - (extend && (sr & X))) & m;
+        bool c = ((s & ~dst) | (r & ~dst) | (s & r)) & top;
+        bool v = ((~s & dst & ~r) | (s & ~dst & r)) & top;
+        bool z = extend ? ((sr & Z) && !r) : !r;
+        uint16_t flags = (c ? C : 0) | (v ? V : 0) | (z ? Z : 0) | ((r & top) ? N : 0);
+        if (compare) {
+            set_ccr(flags, N | Z | V | C);
+        } else {
+            set_ccr(flags | (c ? X : 0), X | N | Z | V | C);
+        }
+        return r;
+    }
+
+    // Group 1 and 2 exception: short frame on the supervisor stack
+    void exception(unsigned vector, uint32_t return_pc) {
+        uint16_t old = sr;
+        set_sr((sr | SR_S) & ~SR_T);
+        push(return_pc, 4);
+        push(old, 2);
+        pc = read(vector * 4, 4) & FlatMemory::ADDR_MASK;
+    }
+
+    bool privileged() {
+        if (supervisor()) return true;
+        exception(8, insn_pc);
+        return false;
+    }
+
+    bool check(int mode, int reg, unsigned allowed) {
+        int index = mode < 7 ? mode : (reg < 5 ? 7 + reg : 12);
+        if (index > 11 || !((allowed >> index) & 1)) {
+            fail(UNMODELLED);
+            return false;
+        }
+        return true;
+    }
+
+    uint32_t indexed(uint32_t base) {
+        uint16_t ext = fetch16();
+        int r = (ext >> 12) & 15;
+        uint32_t x = r < 8 ? d[r] : a[r - 8];
+        if (!(ext & 0x0800)) x = sext(x, 2);
+        return base + x + uint32_t(int32_t(int8_t(ext)));
+    }
+
+    Ea ea(int mode, int reg, int size) {
+        Ea e = { mode, reg, 0 };
+        int step = (size == 1 && reg == 7) ? 2 : size;
+        switch (mode) {
+        case 0:
+        case 1:
+            break;
+        case 2:
+            e.addr = a[reg];
+            break;
+        case 3:
+            e.addr = a[reg];
+            a[reg] += step;
+            break;
+        case 4:
+            a[reg] -= step;
+            e.addr = a[reg];
+            break;
+        case 5:
+            e.addr = a[reg] + sext(fetch16(), 2);
+            break;
+        case 6:
+            e.addr = indexed(a[reg]);
+            break;
+        default:
+            switch (reg) {
+            case 0: e.addr = sext(fetch16(), 2); break;
+            case 1: e.addr = fetch32(); break;
+            case 2: e.addr = pc; e.addr += sext(fetch16(), 2); break;
+            case 3: e.addr = indexed(pc); break;
+            default:
+                e.mode = IMMEDIATE;
+                e.addr = size == 4 ? fetch32() : fetch16() & mask(size);
+                break;
+            }
+        }
+        return e;
+    }
+
+    uint32_t read_ea(const Ea& e, int size) {
+        if (e.mode == 0) return d[e.reg] & mask(size);
+        if (e.mode == 1) return a[e.reg] & mask(size);
+        if (e.mode == IMMEDIATE) return e.addr;
+        return read(e.addr, size);
+    }
+
+    void write_ea(const Ea& e, int size, uint32_t value) {
+        if (e.mode == 0) {
+            d[e.reg] = (d[e.reg] & ~mask(size)) | (value & mask(size));
+        } else if (e.mode == 1) {
+            a[e.reg] = value;
+        } else {
+            write(e.addr, size, value);
+        }
+    }
+
+    void execute(uint16_t op) {
+        int mode = (op >> 3) & 7;
+        int reg = op & 7;
+        int rx = (op >> 9) & 7;
+        switch (op >> 12) {
+        case 0x0: group_immediate(op, mode, reg, rx); break;
+        case 0x1: move(op, 1); break;
+        case 0x2: move(op, 4); break;
+        case 0x3: move(op, 2); break;
+        case 0x4: group_misc(op, mode, reg, rx); break;
+        case 0x5: group_quick(op, mode, reg, rx); break;
+        case 0x6: branch(op); break;
+        case 0x7:
+            if (op & 0x0100) {
+                fail(UNMODELLED);
+            } else {
+                d[rx] = sext(op & 0xFF, 1);
+                set_logic(d[rx], 4);
+            }
+            break;
+        case 0x8: group_or(op, mode, reg, rx); break;
+        case 0x9: group_add(op, mode, reg, rx, false); break;
+        case 0xA: exception(10, insn_pc); break;
+        case 0xB: group_cmp(op, mode, reg, rx); break;
+        case 0xC: group_and(op, mode, reg, rx); break;
+        case 0xD: group_add(op, mode, reg, rx, true); break;
+        case 0xE: group_shift(op, mode, reg, rx); break;
+        default: exception(11, insn_pc); break;
+        }
+    }
+
+    void move(uint16_t op, int size) {
+        int dmode = (op >> 6) & 7, dreg = (op >> 9) & 7;
+        if (!check(op >> 3 & 7, op & 7, size == 1 ? DATA : ALL)) return;
+        if (!check(dmode, dreg, size == 1 ? DATA_ALT : ALTERABLE)) return;
+        if (dmode == 1 && size == 1) return fail(UNMODELLED);
+        uint32_t v = read_ea(ea(op >> 3 & 7, op & 7, size), size);
+        if (dmode == 1) {
+            a[dreg] = sext(v, size);            // MOVEA
+            return;
+        }
+        write_ea(ea(dmode, dreg, size), size, v);
+        set_logic(v, size);
+    }
+
+    void bit_op(int type, uint32_t bit, int mode, int reg) {
+        int size = mode == 0 ? 4 : 1;
+        if (!check(mode, reg, type == 0 ? DATA : DATA_ALT)) return;
+        Ea e = ea(mode, reg, size);
+        uint32_t v = read_ea(e, size);
+        uint32_t m = 1u << (bit & (size == 4 ? 31 : 7));
+        set_ccr((v & m) ? 0 : Z, Z);
+        if (type == 1) write_ea(e, size, v ^ m);
+        if (type == 2) write_ea(e, size, v & ~m);
+        if (type == 3) write_ea(e, size, v | m);
+    }
+
+    void group_immediate(uint16_t op, int mode, int reg, int rx) {
+        if ((op & 0x0138) == 0x0108) {
+            // MOVEP: alternate bytes from d16(Ay)
+            uint32_t addr = a[reg] + sext(fetch16(), 2);
+            int size = (op & 0x0040) ? 4 : 2;
+            if (op & 0x0080) {
+                for (int i = size - 1; i >= 0; i--, addr += 2) write(addr, 1, d[rx] >> (i * 8));
+            } else {
+                uint32_t v = 0;
+                for (int i = 0; i < size; i++, addr += 2) v = (v << 8) | read(addr, 1);
+                write_ea(Ea{ 0, rx, 0 }, size, v);
+            }
+            return;
+        }
+        if (op & 0x0100) return bit_op((op >> 6) & 3, d[rx], mode, reg);
+        if ((op & 0x0F00) == 0x0800) {
+            uint32_t bit = fetch16() & 0xFF;
+            int type = (op >> 6) & 3;
+            if (mode == 7 && reg == 4) return fail(UNMODELLED);
+            return bit_op(type, bit, mode, reg);
+        }
+
+        int kind = rx;
+        int bits = (op >> 6) & 3;
+        if (bits == 3 || kind == 4 || kind == 7) return fail(UNMODELLED);
+        int size = size_of(bits);
+        if (mode == 7 && reg == 4 && (kind == 0 || kind == 1 || kind == 5)) {
+            // To CCR (byte) or SR (word)
+            if (bits > 1) return fail(UNMODELLED);
+            if (bits == 1 && !privileged()) return;
+            uint16_t imm = fetch16() & (bits == 0 ? 0x00FF : 0xFFFF);
+            uint16_t cur = sr & (bits == 0 ? 0x00FF : 0xFFFF);
+            uint16_t v = kind == 0 ? (cur | imm) : kind == 1 ? (cur & imm) : (cur ^ imm);
+            if (bits == 0) {
+                set_ccr(v, 0x1F);
+            } else {
+                set_sr(v);
+            }
+            return;
+        }
+        if (!check(mode, reg, DATA_ALT)) return;
+        uint32_t imm = size == 4 ? fetch32() : fetch16() & mask(size);
+        Ea e = ea(mode, reg, size);
+        uint32_t v = read_ea(e, size);
+        switch (kind) {
+        case 0: v |= imm; set_logic(v, size); write_ea(e, size, v); break;
+        case 1: v &= imm; set_logic(v, size); write_ea(e, size, v); break;
+        case 2: write_ea(e, size, sub(imm, v, size)); break;
+        case 3: write_ea(e, size, add(imm, v, size)); break;
+        case 5: v ^= imm; set_logic(v, size); write_ea(e, size, v); break;
+        default: sub(imm, v, size, false, true); break;
+        }
+    }
+
+    void movem(uint16_t op, int mode, int reg) {
+        int size = (op & 0x0040) ? 4 : 2;
+        bool to_regs = op & 0x0400;
+        uint16_t list = fetch16();
+        if (to_regs) {
+            if (!check(mode, reg, mode == 3 ? ALL : CONTROL)) return;
+        } else if (mode != 4 && !check(mode, reg, CONTROL_ALT)) {
+            return;
+        }
+        if (mode == 4) {
+            // Predecrement: the list is reversed, A7 first, and the stored An is its old value
+            uint32_t addr = a[reg];
+            for (int i = 0; i < 16; i++) {
+                if (!(list & (1u << i))) continue;
+                int r = 15 - i;
+                addr -= size;
+                write(addr, size, r < 8 ? d[r] : a[r - 8]);
+            }
+            a[reg] = addr;
+            return;
+        }
+        uint32_t addr = mode == 3 ? a[reg] : ea(mode, reg, size).addr;
+        for (int r = 0; r < 16; r++) {
+            if (!(list & (1u << r))) continue;
+            if (to_regs) {
+                uint32_t v = sext(read(addr, size), size);
+                if (r < 8) d[r] = v; else a[r - 8] = v;
+            } else {
+                write(addr, size, r < 8 ? d[r] : a[r - 8]);
+            }
+            addr += size;
+        }
+        if (mode == 3) a[reg] = addr;
+    }
+
+    void group_misc(uint16_t op, int mode, int reg, int rx) {
+        int bits = (op >> 6) & 3;
+        if (op == 0x4AFC) return exception(4, insn_pc);
+        if ((op & 0xF1C0) == 0x4180) {
+            // CHK <ea>,Dn
+            if (!check(mode, reg, DATA)) return;
+            int16_t bound = int16_t(read_ea(ea(mode, reg, 2), 2));
+            int16_t v = int16_t(d[rx]);
+            if (v < 0) {
+                set_ccr(N, N);
+                exception(6, pc);
+            } else if (v > bound) {
+                set_ccr(0, N);
+                exception(6, pc);
+            }
+            return;
+        }
+        if ((op & 0xF1C0) == 0x41C0) {
+            if (!check(mode, reg, CONTROL)) return;
+            a[rx] = ea(mode, reg, 4).addr;      // LEA
+            return;
+        }
+        switch (op & 0xFFC0) {
+        case 0x40C0:
+            // MOVE from SR, not privileged on the 68000
+            if (!check(mode, reg, DATA_ALT)) return;
+            write_ea(ea(mode, reg, 2), 2, sr);
+            return;
+        case 0x44C0:
+        case 0x46C0: {
+            // MOVE to CCR / SR
+            if (!check(mode, reg, DATA)) return;
+            if ((op & 0x0200) && !privileged()) return;
+            uint16_t v = read_ea(ea(mode, reg, 2), 2);
+            if (op & 0x0200) {
+                set_sr(v);
+            } else {
+                set_ccr(v, 0x1F);
+            }
+            return;
+        }
+        case 0x4800: {
+            // NBCD
+            if (!check(mode, reg, DATA_ALT)) return;
+            Ea e = ea(mode, reg, 1);
+            uint32_t dst = read_ea(e, 1);
+            uint32_t r = (0x9A - dst - ((sr & X) ? 1 : 0)) & 0xFF;
+            if (r != 0x9A) {
+                uint32_t v = ~r;
+                if ((r & 0x0F) == 0x0A) r = (r & 0xF0) + 0x10;
+                r &= 0xFF;
+                write_ea(e, 1, r);
+                set_ccr(X | C | ((v & r & 0x80) ? V : 0), X | C | V);
+                if (r) set_ccr(0, Z);
+            } else {
+                set_ccr(0, X | C | V);
+            }
+            set_ccr((r & 0x80) ? N : 0, N);
+            return;
+        }
+        case 0x4AC0: {
+            // TAS
+            if (!check(mode, reg, DATA_ALT)) return;
+            Ea e = ea(mode, reg, 1);
+            uint32_t v = read_ea(e, 1);
+            set_logic(v, 1);
+            write_ea(e, 1, v | 0x80);
+            return;
+        }
+        case 0x4E80:
+        case 0x4EC0: {
+            // JSR / JMP
+            if (!check(mode, reg, CONTROL)) return;
+            uint32_t target = ea(mode, reg, 4).addr & FlatMemory::ADDR_MASK;
+            if (op & 0x0040) {
+                pc = target;
+            } else {
+                push(pc, 4);
+                pc = target;
+            }
+            return;
+        }
+        }
+        if ((op & 0xF900) == 0x4000 && bits != 3) {
+            // NEGX, CLR, NEG, NOT
+            int size = size_of(bits);
+            if (!check(mode, reg, DATA_ALT)) return;
+            Ea e = ea(mode, reg, size);
+            uint32_t v = read_ea(e, size);
+            switch ((op >> 9) & 3) {
+            case 0: write_ea(e, size, sub(v, 0, size, true)); break;
+            case 1: write_ea(e, size, 0); set_logic(0, size); break;
+            case 2: write_ea(e, size, sub(v, 0, size)); break;
+            default: write_ea(e, size, ~v); set_logic(~v, size); break;
+            }
+            return;
+        }
+        if ((op & 0xFFF8) == 0x4840) {
+            d[reg] = (d[reg] >> 16) | (d[reg] << 16);       // SWAP
+            set_logic(d[reg], 4);
+            return;
+        }
+        if ((op & 0xFFC0) == 0x4840) {
+            if (!check(mode, reg, CONTROL)) return;
+            uint32_t addr = ea(mode, reg, 4).addr;          // PEA
+            push(addr, 4);
+            return;
+        }
+        if ((op & 0xFFB8) == 0x4880) {
+            if (op & 0x0040) {
+                d[reg] = sext(d[reg], 2);                   // EXT.L
+                set_logic(d[reg], 4);
+            } else {
+                d[reg] = (d[reg] & 0xFFFF0000) | (sext(d[reg], 1) & 0xFFFF);    // EXT.W
+                set_logic(d[reg], 2);
+            }
+            return;
+        }
+        if ((op & 0xFB80) == 0x4880) return movem(op, mode, reg);
+        if ((op & 0xFF00) == 0x4A00) {
+            // TST
+            int size = size_of(bits);
+            if (!check(mode, reg, DATA_ALT)) return;
+            set_logic(read_ea(ea(mode, reg, size), size), size);
+            return;
+        }
+        if ((op & 0xFFF0) == 0x4E40) return exception(32 + (op & 15), pc);     // TRAP
+        if ((op & 0xFFF8) == 0x4E50) {
+            // LINK
+            // LINK A7 stores the decremented A7
+            int32_t disp = int16_t(fetch16());
+            a[7] -= 4;
+            write(a[7], 4, a[reg]);
+            a[reg] = a[7];
+            a[7] += disp;
+            return;
+        }
+        if ((op & 0xFFF8) == 0x4E58) {
+            // UNLK
+            uint32_t sp = a[reg];
+            uint32_t v = read(sp, 4);
+            a[7] = sp + 4;
+            a[reg] = v;
+            return;
+        }
+        if ((op & 0xFFF0) == 0x4E60) {
+            // MOVE An,USP / MOVE USP,An
+            if (!privileged()) return;
+            if (op & 8) {
+                a[reg] = other_sp;
+            } else {
+                other_sp = a[reg];
+            }
+            return;
+        }
+        switch (op) {
+        case 0x4E71:
+            return;                                         // NOP
+        case 0x4E73: {
+            // RTE
+            if (!privileged()) return;
+            uint16_t new_sr = pop(2);
+            pc = pop(4) & FlatMemory::ADDR_MASK;
+            set_sr(new_sr);
+            return;
+        }
+        case 0x4E75:
+            pc = pop(4) & FlatMemory::ADDR_MASK;            // RTS
+            return;
+        case 0x4E76:
+            if (sr & V) exception(7, pc);                   // TRAPV
+            return;
+        case 0x4E77: {
+            // RTR
+            uint16_t ccr = pop(2);
+            pc = pop(4) & FlatMemory::ADDR_MASK;
+            set_ccr(ccr, 0x1F);
+            return;
+        }
+        }
+        fail(UNMODELLED);                                   // RESET, STOP, illegal encodings
+    }
+
+    void group_quick(uint16_t op, int mode, int reg, int rx) {
+        int bits = (op >> 6) & 3;
+        if (bits == 3) {
+            int cc = (op >> 8) & 15;
+            if (mode == 1) {
+                // DBcc
+                uint32_t base = pc;
+                int32_t disp = int16_t(fetch16());
+                if (cond(cc)) return;
+                uint16_t count = uint16_t(uint16_t(d[reg]) - 1);
+                d[reg] = (d[reg] & 0xFFFF0000) | count;
+                if (count != 0xFFFF) pc = (base + disp) & FlatMemory::ADDR_MASK;
+                return;
+            }
+            // Scc
+            if (!check(mode, reg, DATA_ALT)) return;
+            write_ea(ea(mode, reg, 1), 1, cond(cc) ? 0xFF : 0x00);
+            return;
+        }
+        int size = size_of(bits);
+        uint32_t data = rx ? rx : 8;
+        if (mode == 1) {
+            // ADDQ/SUBQ to An: whole register, no flags
+            if (size == 1) return fail(UNMODELLED);
+            a[reg] += (op & 0x0100) ? -data : data;
+            return;
+        }
+        if (!check(mode, reg, DATA_ALT)) return;
+        Ea e = ea(mode, reg, size);
+        uint32_t v = read_ea(e, size);
+        write_ea(e, size, (op & 0x0100) ? sub(data, v, size) : add(data, v, size));
+    }
+
+    void branch(uint16_t op) {
+        int cc = (op >> 8) & 15;
+        uint32_t base = pc;
+        int32_t disp = int8_t(op & 0xFF);
+        if (!disp) disp = int16_t(fetch16());
+        if (cc == 1) push(pc, 4);                           // BSR
+        if (cc == 1 || cond(cc)) pc = (base + disp) & FlatMemory::ADDR_MASK;
+    }
+
+    // ABCD/SBCD byte, with X in; Z only cleared
+    uint32_t bcd(uint32_t s, uint32_t dst, bool subtract) {
+        uint32_t x = (sr & X) ? 1 : 0;
+        uint32_t r, v;
+        if (!subtract) {
+            r = (s & 0x0F) + (dst & 0x0F) + x;
+            v = ~r;
+            if (r > 9) r += 6;
+            r += (s & 0xF0) + (dst & 0xF0);
+        } else {
+            r = (dst & 0x0F) - (s & 0x0F) - x;
+            v = ~r;
+            if (r > 9) r -= 6;
+            r += (dst & 0xF0) - (s & 0xF0);
+        }
+        bool c = r > 0x99;
+        if (c) r = subtract ? r + 0xA0 : r - 0xA0;
+        r &= 0xFF;
+        set_ccr((c ? X | C : 0) | ((v & r & 0x80) ? V : 0) | ((r & 0x80) ? N : 0), X | C | V | N);
+        if (r) set_ccr(0, Z);
+        return r;
+    }
+
+    // ABCD/SBCD/ADDX/SUBX operands: Dy,Dx or -(Ay),-(Ax)
+    template <class Op>
+    void extended(uint16_t op, int reg, int rx, int size, Op f) {
+        if (op & 0x0008) {
+            Ea src = ea(4, reg, size);
+            uint32_t s = read_ea(src, size);
+            Ea dst = ea(4, rx, size);
+            write_ea(dst, size, f(s, read_ea(dst, size)));
+        } else {
+            write_ea(Ea{ 0, rx, 0 }, size, f(d[reg] & mask(size), d[rx] & mask(size)));
+        }
+    }
+
+    void group_or(uint16_t op, int mode, int reg, int rx) {
+        int opmode = (op >> 6) & 7;
+        if (opmode == 3 || opmode == 7) {
+            // DIVU / DIVS
+            if (!check(mode, reg, DATA)) return;
+            uint32_t s = read_ea(ea(mode, reg, 2), 2);
+            if (!s) {
+                set_ccr(0, C);
+                return exception(5, pc);
+            }
+            if (opmode == 3) {
+                uint32_t q = d[rx] / s, r = d[rx] % s;
+                if (q > 0xFFFF) return set_ccr(N | V, N | V | C);
+                d[rx] = (r << 16) | q;
+            } else {
+                int32_t dividend = int32_t(d[rx]), divisor = int16_t(s);
+                if (dividend == INT32_MIN && divisor == -1) return set_ccr(N | V, N | V | C);
+                int32_t q = dividend / divisor, r = dividend % divisor;
+                if (q != int16_t(q)) return set_ccr(N | V, N | V | C);
+                d[rx] = (uint32_t(r) << 16) | (uint32_t(q) & 0xFFFF);
+            }
+            set_logic(d[rx], 2);
+            return;
+        }
+        if ((op & 0x01F0) == 0x0100) {
+            return extended(op, reg, rx, 1, [this](uint32_t s, uint32_t dst) { return bcd(s, dst, true); });
+        }
+        logic_op(op, mode, reg, rx, [](uint32_t x, uint32_t y) { return x | y; });
+    }
+
+    void group_and(uint16_t op, int mode, int reg, int rx) {
+        int opmode = (op >> 6) & 7;
+        if (opmode == 3 || opmode == 7) {
+            // MULU / MULS
+            if (!check(mode, reg, DATA)) return;
+            uint32_t s = read_ea(ea(mode, reg, 2), 2);
+            if (opmode == 3) {
+                d[rx] = (d[rx] & 0xFFFF) * s;
+            } else {
+                d[rx] = uint32_t(int32_t(int16_t(d[rx])) * int32_t(int16_t(s)));
+            }
+            set_logic(d[rx], 4);
+            return;
+        }
+        if ((op & 0x01F0) == 0x0100) {
+            return extended(op, reg, rx, 1, [this](uint32_t s, uint32_t dst) { return bcd(s, dst, false); });
+        }
+        if ((op & 0x01F8) == 0x0140) return std::swap(d[rx], d[reg]);     // EXG Dx,Dy
+        if ((op & 0x01F8) == 0x0148) return std::swap(a[rx], a[reg]);     // EXG Ax,Ay
+        if ((op & 0x01F8) == 0x0188) return std::swap(d[rx], a[reg]);     // EXG Dx,Ay
+        logic_op(op, mode, reg, rx, [](uint32_t x, uint32_t y) { return x & y; });
+    }
+
+    // OR/AND: <ea>,Dn or Dn,<ea>
+    template <class Op>
+    void logic_op(uint16_t op, int mode, int reg, int rx, Op f) {
+        int size = size_of((op >> 6) & 3);
+        if (op & 0x0100) {
+            if (!check(mode, reg, MEM_ALT)) return;
+            Ea e = ea(mode, reg, size);
+            uint32_t v = f(read_ea(e, size), d[rx]);
+            write_ea(e, size, v);
+            set_logic(v, size);
+        } else {
+            if (!check(mode, reg, DATA)) return;
+            uint32_t v = f(read_ea(ea(mode, reg, size), size), d[rx]);
+            write_ea(Ea{ 0, rx, 0 }, size, v);
+            set_logic(v, size);
+        }
+    }
+
+    // ADD/SUB, ADDA/SUBA, ADDX/SUBX
+    void group_add(uint16_t op, int mode, int reg, int rx, bool is_add) {
+        int opmode = (op >> 6) & 7;
+        if (opmode == 3 || opmode == 7) {
+            int size = opmode == 3 ? 2 : 4;
+            if (!check(mode, reg, ALL)) return;
+            uint32_t s = sext(read_ea(ea(mode, reg, size), size), size);
+            a[rx] = is_add ? a[rx] + s : a[rx] - s;
+            return;
+        }
+        int size = size_of(opmode & 3);
+        if ((op & 0x0130) == 0x0100) {
+            return extended(op, reg, rx, size, [this, size, is_add](uint32_t s, uint32_t dst) {
+                return is_add ? add(s, dst, size, true) : sub(s, dst, size, true);
+            });
+        }
+        if (op & 0x0100) {
+            if (!check(mode, reg, MEM_ALT)) return;
+            Ea e = ea(mode, reg, size);
+            uint32_t v = read_ea(e, size);
+            write_ea(e, size, is_add ? add(d[rx], v, size) : sub(d[rx], v, size));
+        } else {
+            if (!check(mode, reg, ALL) || (mode == 1 && size == 1)) return fail(UNMODELLED);
+            uint32_t s = read_ea(ea(mode, reg, size), size);
+            write_ea(Ea{ 0, rx, 0 }, size, is_add ? add(s, d[rx], size) : sub(s, d[rx], size));
+        }
+    }
+
+    // CMP, CMPA, CMPM, EOR
+    void group_cmp(uint16_t op, int mode, int reg, int rx) {
+        int opmode = (op >> 6) & 7;
+        if (opmode == 3 || opmode == 7) {
+            int size = opmode == 3 ? 2 : 4;
+            if (!check(mode, reg, ALL)) return;
+            uint32_t s = sext(read_ea(ea(mode, reg, size), size), size);
+            sub(s, a[rx], 4, false, true);
+            return;
+        }
+        int size = size_of(opmode & 3);
+        if (opmode < 3) {
+            if (!check(mode, reg, ALL) || (mode == 1 && size == 1)) return fail(UNMODELLED);
+            sub(read_ea(ea(mode, reg, size), size), d[rx], size, false, true);
+            return;
+        }
+        if (mode == 1) {
+            // CMPM (Ay)+,(Ax)+
+            uint32_t s = read_ea(ea(3, reg, size), size);
+            uint32_t dst = read_ea(ea(3, rx, size), size);
+            sub(s, dst, size, false, true);
+            return;
+        }
+        if (!check(mode, reg, DATA_ALT)) return;
+        Ea e = ea(mode, reg, size);
+        uint32_t v = read_ea(e, size) ^ d[rx];
+        write_ea(e, size, v);
+        set_logic(v, size);
+    }
+
+    // ASx/LSx/ROXx/ROx one bit at a time; count 0 leaves X and clears C (ROXx: C = X)
+    uint32_t shift(int type, bool left, uint32_t v, unsigned count, int size) {
+        uint32_t m = mask(size), top = msb(size);
+        v &= m;
+        bool x = sr & X, c = false, overflow = false;
+        for (unsigned i = 0; i < count; i++) {
+            if (left) {
+                c = v & top;
+                uint32_t r;
+                switch (type) {
+                case 2: r = (v << 1) | x; break;
+                case 3: r = (v << 1) | c; break;
+                default: r = v << 1; break;
+                }
+                r &= m;
+                if (type == 0 && ((r ^ v) & top)) overflow = true;
+                v = r;
+            } else {
+                c = v & 1;
+                switch (type) {
+                case 0: v = (v >> 1) | (v & top); break;
+                case 1: v >>= 1; break;
+                case 2: v = (v >> 1) | (x ? top : 0); break;
+                default: v = (v >> 1) | (c ? top : 0); break;
+                }
+            }
+            if (type != 3) x = c;
+        }
+        uint16_t flags = ((v & top) ? N : 0) | (v ? 0 : Z) | (overflow ? V : 0);
+        if (type == 2) {
+            flags |= x ? C : 0;
+        } else {
+            flags |= c ? C : 0;
+        }
+        uint16_t affected = N | Z | V | C;
+        if (count && type != 3) {
+            flags |= x ? X : 0;
+            affected |= X;
+        }
+        set_ccr(flags, affected);
+        return v;
+    }
+
+    void group_shift(uint16_t op, int mode, int reg, int rx) {
+        int bits = (op >> 6) & 3;
+        bool left = op & 0x0100;
+        if (bits == 3) {
+            // Memory, one bit of a word
+            if (op & 0x0800) return fail(UNMODELLED);
+            if (!check(mode, reg, MEM_ALT)) return;
+            Ea e = ea(mode, reg, 2);
+            write_ea(e, 2, shift((op >> 9) & 3, left, read_ea(e, 2), 1, 2));
+            return;
+        }
+        int size = size_of(bits);
+        unsigned count = (op & 0x0020) ? (d[rx] & 63) : (rx ? rx : 8);
+        write_ea(Ea{ 0, reg, 0 }, size, shift((op >> 3) & 3, left, d[reg], count, size));
+    }
+};
+
+#endif // FX68K_ISS68K_H
@@ -0,0 +1,174 @@
+// Initial guest memory for the testbenches
+//
+// sim/common/memory_map.json describes what a testbench instance starts with: named regions
+// with fills, address patterns, vector tables and raw images. scripts/memmap_pack.py compiles
+// it into the binary loaded with +memimage=<file>; without one, default_map() builds the same
+// layout in code. Either way the image is compiled once per process into contiguous segments
+// and each instance copies them in with one load() per segment.
+//
+// Binary layout (little endian): "FX68MEM1" u32 segment_count, then per segment u32 byte
+// address, u32 word_count, word_count x u16 (upper byte at the even address).
+#ifndef FX68K_MEMORY_IMAGE_H
+#define FX68K_MEMORY_IMAGE_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+static const char MEMORY_IMAGE_MAGIC[8] = { 'F', 'X', '6', '8', 'M', 'E', 'M', '1' };
+
+class MemoryImage {
+public:
+    static const uint32_t ADDR_MASK = 0x00FFFFFF;
+
+    struct Segment {
+        uint32_t addr;
+        std::vector<uint16_t> words;
+    };
+
+    std::vector<Segment> segments;              // Ascending, contiguous runs of words
+
+    // Region builders, same meaning as in memory_map.json: end is exclusive and a later region
+    // overrides the words an earlier one set. compile() turns them into segments.
+    void fill(uint32_t start, uint32_t end, uint16_t value) {
+        for (uint32_t addr = start; addr < end; addr += 2) pending[addr & ADDR_MASK] = value;
+    }
+
+    void address_pattern(uint32_t start, uint32_t end) {
+        for (uint32_t addr = start; addr < end; addr += 2) pending[addr & ADDR_MASK] = addr & 0xFFFF;
+    }
+
+    void vector_table(uint32_t base, uint32_t first, uint32_t count, uint32_t target) {
+        for (uint32_t vector = first; vector < first + count; vector++) {
+            uint32_t addr = (base + vector * 4) & ADDR_MASK;
+            pending[addr] = target >> 16;
+            pending[(addr + 2) & ADDR_MASK] = target & 0xFFFF;
+        }
+    }
+
+    void compile() {
+        segments.clear();
+        for (const auto& w : pending) {
+            if (segments.empty() || segments.back().addr + segments.back().words.size() * 2 != w.first) {
+                segments.push_back(Segment{ w.first, {} });
+            }
+            segments.back().words.push_back(w.second);
+        }
+        pending.clear();
+    }
+
+    bool load_binary(const std::string& filename, std::string& error) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            error = "could not open memory image " + filename;
+            return false;
+        }
+
+        char magic[8];
+        uint32_t count = 0;
+        file.read(magic, sizeof(magic));
+        file.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (!file || std::memcmp(magic, MEMORY_IMAGE_MAGIC, sizeof(magic)) != 0) {
+            error = filename + " is not an fx68k memory image";
+            return false;
+        }
+
+        segments.assign(count, Segment());
+        for (Segment& s : segments) {
+            uint32_t header[2];
+            file.read(reinterpret_cast<char*>(header), sizeof(header));
+            if (!file || header[1] > (ADDR_MASK + 1) / 2) {
+                error = filename + " is truncated";
+                return false;
+            }
+            s.addr = header[0] & ADDR_MASK;
+            s.words.resize(header[1]);
+            file.read(reinterpret_cast<char*>(s.words.data()), s.words.size() * 2);
+        }
+        if (!file) {
+            error = filename + " is truncated";
+            return false;
+        }
+        return true;
+    }
+
+    // The binary layout memmap_pack.py writes, for comparing the two
+    bool save_binary(const std::string& filename, std::string& error) const {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            error = "could not write memory image " + filename;
+            return false;
+        }
+        uint32_t count = uint32_t(segments.size());
+        file.write(MEMORY_IMAGE_MAGIC, sizeof(MEMORY_IMAGE_MAGIC));
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const Segment& s : segments) {
+            uint32_t header[2] = { s.addr, uint32_t(s.words.size()) };
+            file.write(reinterpret_cast<const char*>(header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(s.words.data()), s.words.size() * 2);
+        }
+        file.close();
+        if (!file) {
+            error = "could not write memory image " + filename;
+            return false;
+        }
+        return true;
+    }
+
+    size_t word_count() const {
+        size_t n = 0;
+        for (const Segment& s : segments) n += s.words.size();
+        return n;
+    }
+
+    // Copy into a testbench memory model, anything with load(addr, words)
+    template <class Memory>
+    void install(Memory& memory) const {
+        for (const Segment& s : segments) {
+            memory.load(s.addr, s.words);
+        }
+    }
+
+    // Images are immutable once loaded, so one copy serves every instance in the process
+    static std::shared_ptr<const MemoryImage> shared(const std::string& filename, std::string& error) {
+        static std::mutex lock;
+        static std::map<std::string, std::shared_ptr<const MemoryImage>> cache;
+
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = cache.find(filename);
+        if (it != cache.end()) {
+            return it->second;
+        }
+
+        std::shared_ptr<MemoryImage> image(new MemoryImage);
+        if (!image->load_binary(filename, error)) {
+            return nullptr;
+        }
+        cache[filename] = image;
+        return image;
+    }
+
+    // The layout of sim/common/memory_map.json, for runs without +memimage=. Keep the two in
+    // step: make test_memimage compares this with the packed map.
+    static std::shared_ptr<const MemoryImage> default_map() {
+        static const std::shared_ptr<const MemoryImage> image = [] {
+            std::shared_ptr<MemoryImage> m(new MemoryImage);
+            m->fill(0x00F000, 0x010000, 0xDEAD);        // stack
+            m->address_pattern(0x001000, 0x002000);     // data
+            m->vector_table(0x000000, 1, 127, 0);       // exception_vectors
+            m->compile();
+            return m;
+        }();
+        return image;
+    }
+
+private:
+    std::map<uint32_t, uint16_t> pending;       // By byte address until compile()
+};
+
+#endif // FX68K_MEMORY_IMAGE_H
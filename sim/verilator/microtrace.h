@@ -0,0 +1,215 @@
+// Micro-PC trace for fx68k
+//
+// Records microAddr once per microcycle (the T4 edge that loads the next micro address).
+// Each entry is predicted from the successor last seen after the previous address; microcode
+// is mostly straight line, so a hit costs one bit and a miss eleven (a flag and the address).
+// Entries are grouped in chunks with the predictor reset at each chunk start. With a chunk
+// limit only the most recent chunks are kept, so the trace can stay on during long fuzz runs
+// and be written out only when something fails.
+//
+// File layout (little endian):
+//   header: "FX68UTRC" u32 version, u32 chunk_count, u64 dropped_entries
+//   chunk:  u32 entries, u32 word_count, word_count x u64 bit stream (LSB first)
+// Decoded by fx68k_microtrace (microtrace_decode.cpp).
+#ifndef FX68K_MICROTRACE_H
+#define FX68K_MICROTRACE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+static const char MICROTRACE_MAGIC[8] = { 'F', 'X', '6', '8', 'U', 'T', 'R', 'C' };
+static const uint32_t MICROTRACE_VERSION = 1;
+
+static const uint32_t MICROTRACE_ADDR_BITS = 10;
+static const uint32_t MICROTRACE_CHUNK_ENTRIES = 1 << 16;
+
+// Successor table shared by recorder and decoder
+class MicroPredictor {
+public:
+    MicroPredictor() { reset(); }
+
+    void reset() {
+        std::fill(next, next + (1 << MICROTRACE_ADDR_BITS) + 1, 0xFFFF);
+        prev = 1 << MICROTRACE_ADDR_BITS;
+    }
+
+    uint16_t predict() const { return next[prev]; }
+
+    void update(uint16_t addr) {
+        next[prev] = addr;
+        prev = addr;
+    }
+
+private:
+    uint16_t next[(1 << MICROTRACE_ADDR_BITS) + 1];     // Last slot: start of chunk
+    uint16_t prev;
+};
+
+struct MicroTraceChunk {
+    uint32_t entries;
+    std::vector<uint64_t> words;
+};
+
+class MicroTrace {
+public:
+    // max_chunks 0 keeps everything
+    explicit MicroTrace(size_t max_chunks = 0) : limit(max_chunks), acc(0), bits(0), dropped(0) {
+        current.entries = 0;
+        current.words.reserve(MICROTRACE_CHUNK_ENTRIES / 32);
+    }
+
+    void record(uint16_t addr) {
+        if (addr == predictor.predict()) {
+            put_bits(1, 1);
+        } else {
+            put_bits(uint64_t(addr) << 1, MICROTRACE_ADDR_BITS + 1);
+        }
+        predictor.update(addr);
+
+        if (++current.entries == MICROTRACE_CHUNK_ENTRIES) {
+            finish_chunk();
+        }
+    }
+
+    uint64_t entries() const {
+        uint64_t n = current.entries;
+        for (const MicroTraceChunk& c : chunks) n += c.entries;
+        return n;
+    }
+
+    size_t bytes() const {
+        size_t n = current.words.size() * 8;
+        for (const MicroTraceChunk& c : chunks) n += c.words.size() * 8;
+        return n;
+    }
+
+    bool write(const std::string& filename) const {
+        FILE* file = std::fopen(filename.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+
+        MicroTraceChunk tail = current;
+        if (bits) tail.words.push_back(acc);
+
+        uint32_t count = uint32_t(chunks.size() + (tail.entries ? 1 : 0));
+        std::fwrite(MICROTRACE_MAGIC, 1, sizeof(MICROTRACE_MAGIC), file);
+        std::fwrite(&MICROTRACE_VERSION, 4, 1, file);
+        std::fwrite(&count, 4, 1, file);
+        std::fwrite(&dropped, 8, 1, file);
+        for (const MicroTraceChunk& c : chunks) {
+            write_chunk(file, c);
+        }
+        if (tail.entries) {
+            write_chunk(file, tail);
+        }
+        return std::fclose(file) == 0;
+    }
+
+private:
+    size_t limit;
+    std::deque<MicroTraceChunk> chunks;
+    MicroTraceChunk current;
+    MicroPredictor predictor;
+    uint64_t acc;
+    unsigned bits;
+    uint64_t dropped;
+
+    void put_bits(uint64_t value, unsigned width) {
+        acc |= value << bits;
+        bits += width;
+        if (bits >= 64) {
+            current.words.push_back(acc);
+            bits -= 64;
+            acc = bits ? value >> (width - bits) : 0;
+        }
+    }
+
+    void finish_chunk() {
+        if (bits) current.words.push_back(acc);
+        acc = 0;
+        bits = 0;
+        predictor.reset();
+
+        chunks.push_back(std::move(current));
+        current = MicroTraceChunk();
+        current.entries = 0;
+        current.words.reserve(MICROTRACE_CHUNK_ENTRIES / 32);
+        if (limit && chunks.size() > limit) {
+            dropped += chunks.front().entries;
+            chunks.pop_front();
+        }
+    }
+
+    static void write_chunk(FILE* file, const MicroTraceChunk& c) {
+        uint32_t words = uint32_t(c.words.size());
+        std::fwrite(&c.entries, 4, 1, file);
+        std::fwrite(&words, 4, 1, file);
+        std::fwrite(c.words.data(), 8, c.words.size(), file);
+    }
+};
+
+// Reads a whole trace back into micro addresses
+inline bool read_microtrace(const std::string& filename, std::vector<uint16_t>& addrs,
+                            uint64_t& dropped, std::string& error) {
+    FILE* file = std::fopen(filename.c_str(), "rb");
+    if (!file) {
+        error = "could not open " + filename;
+        return false;
+    }
+
+    char magic[8];
+    uint32_t version = 0, count = 0;
+    bool ok = std::fread(magic, 1, 8, file) == 8 && std::memcmp(magic, MICROTRACE_MAGIC, 8) == 0
+           && std::fread(&version, 4, 1, file) == 1 && std::fread(&count, 4, 1, file) == 1
+           && std::fread(&dropped, 8, 1, file) == 1;
+    if (!ok || version != MICROTRACE_VERSION) {
+        std::fclose(file);
+        error = filename + " is not a micro-PC trace";
+        return false;
+    }
+
+    addrs.clear();
+    MicroPredictor predictor;
+    std::vector<uint64_t> words;
+    for (uint32_t c = 0; c < count; c++) {
+        uint32_t entries = 0, word_count = 0;
+        if (std::fread(&entries, 4, 1, file) != 1 || std::fread(&word_count, 4, 1, file) != 1) {
+            break;
+        }
+        words.resize(word_count);
+        if (std::fread(words.data(), 8, word_count, file) != word_count) {
+            break;
+        }
+
+        predictor.reset();
+        uint64_t pos = 0;
+        auto get_bits = [&](unsigned width) {
+            uint64_t v = 0;
+            for (unsigned i = 0; i < width; i++, pos++) {
+                v |= ((words[pos >> 6] >> (pos & 63)) & 1) << i;
+            }
+            return v;
+        };
+        for (uint32_t i = 0; i < entries && pos < uint64_t(word_count) * 64; i++) {
+            uint16_t addr = get_bits(1) ? predictor.predict() : uint16_t(get_bits(MICROTRACE_ADDR_BITS));
+            predictor.update(addr);
+            addrs.push_back(addr);
+        }
+        if (c + 1 == count) {
+            std::fclose(file);
+            return true;
+        }
+    }
+
+    std::fclose(file);
+    error = filename + " is truncated";
+    return count == 0;
+}
+
+#endif // FX68K_MICROTRACE_H
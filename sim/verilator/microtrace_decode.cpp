@@ -0,0 +1,103 @@
+// Micro-PC trace decoder for fx68k
+//
+// Prints a trace written by MicroTrace (microtrace.h) as symbolic microcode steps. Field
+// decoding comes from microcode_tables.h, generated by scripts/rom_table_generator.py --cpp
+// from the same field definitions as the ROM documentation tables.
+#include "microtrace.h"
+#include "microcode_tables.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void print_help(const char* prog) {
+    std::cout << "Usage: " << prog << " [options] TRACE" << std::endl;
+    std::cout << "  --last N       Only print the last N microcycles" << std::endl;
+    std::cout << "  --nano         Also decode the nanoword of each step" << std::endl;
+    std::cout << "  --raw          Micro addresses only, one per line" << std::endl;
+    std::cout << "  --histogram    Most visited micro addresses instead of the step list" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    std::string trace;
+    uint64_t last = 0;
+    bool nano = false, raw = false, histogram = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--last" && i + 1 < argc) {
+            last = std::stoull(argv[++i]);
+        } else if (arg == "--nano") {
+            nano = true;
+        } else if (arg == "--raw") {
+            raw = true;
+        } else if (arg == "--histogram") {
+            histogram = true;
+        } else if (arg == "--help" || arg == "-h") {
+            print_help(argv[0]);
+            return 0;
+        } else {
+            trace = arg;
+        }
+    }
+
+    if (trace.empty()) {
+        std::cerr << "Error: No trace file given" << std::endl;
+        return 2;
+    }
+
+    std::vector<uint16_t> addrs;
+    uint64_t dropped = 0;
+    std::string error;
+    if (!read_microtrace(trace, addrs, dropped, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 2;
+    }
+
+    if (histogram) {
+        std::vector<std::pair<uint64_t, uint16_t>> counts(MICROCODE_DEPTH);
+        for (unsigned a = 0; a < MICROCODE_DEPTH; a++) counts[a].second = a;
+        for (uint16_t a : addrs) counts[a].first++;
+        std::sort(counts.rbegin(), counts.rend());
+
+        std::cout << "=== Micro Address Histogram ===" << std::endl;
+        for (const auto& c : counts) {
+            if (!c.first) break;
+            std::printf("%10llu %6.2f%%  %03X %-6s %s\n", (unsigned long long)c.first,
+                        100.0 * c.first / addrs.size(), c.second,
+                        MICRO_LABEL[c.second] ? MICRO_LABEL[c.second] : "", MICRO_FIELDS[c.second]);
+        }
+        return 0;
+    }
+
+    size_t start = (last && last < addrs.size()) ? addrs.size() - last : 0;
+    if (!raw && dropped) {
+        std::printf("... %llu earlier microcycles dropped by the recorder\n", (unsigned long long)dropped);
+    }
+
+    // Steps are shown inside the most recent named entry point
+    const char* routine = "";
+    for (size_t i = 0; i < start; i++) {
+        if (MICRO_LABEL[addrs[i]]) routine = MICRO_LABEL[addrs[i]];
+    }
+    for (size_t i = start; i < addrs.size(); i++) {
+        uint16_t a = addrs[i];
+        if (raw) {
+            std::printf("%03X\n", a);
+            continue;
+        }
+        if (MICRO_LABEL[a]) routine = MICRO_LABEL[a];
+        std::printf("%10llu  %03X %-6s n=%03X  %s\n", (unsigned long long)(dropped + i), a, routine,
+                    MICRO_TO_NANO[a], MICRO_FIELDS[a]);
+        if (nano) {
+            std::printf("%*s%s\n", 30, "", NANO_FIELDS[MICRO_TO_NANO[a]]);
+        }
+    }
+
+    if (!raw) {
+        std::cout << "\n=== Micro Trace Summary ===" << std::endl;
+        std::cout << "Microcycles: " << dropped + addrs.size() << " (" << addrs.size() << " in trace)" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,883 @@
+// Delta debugging minimizer for failing fx68k runs
+//
+// A reproducer is a text file, one item per line, '#' starts a comment:
+//     image FILE[@ADDR]       Raw binary image as for fx68k_profile --load, vectors included
+//     cycles N                Run length in CPU cycles after reset
+//     irq CYCLE LEVEL [LEN]   IPL LEVEL from CYCLE until acknowledged, or for LEN cycles
+//     berr RULE               Bus error rule, test_faults --rule syntax (fault_injector.h)
+//     nop ADDR                Instruction at ADDR replaced by NOPs
+//     expect FAILURE          halted | vector N | pc ADDR | stuck VERDICT | diverge
+// Addresses are hex. --stim adds the interrupt and bus error inputs of a recorded stimulus
+// stream (stimulus.h) as irq/berr lines. Its data bus replay is dropped: memory comes from the
+// images, which is what lets instructions be removed.
+//
+// Every candidate runs until it shows the expected failure, whose cycle becomes the run length
+// of the next candidates. Then, in rounds until nothing changes:
+//   - ddmin over the events, dropping subsets of irq/berr lines;
+//   - each remaining event simplified: lowest IRQ level and shortest assertion, a bus error
+//     rule narrowed to the one bus cycle it hit;
+//   - ddmin over the instructions the failing run executed, replacing them with NOPs.
+// The candidates of a step run on --jobs worker threads, a harness each. The first failing
+// candidate in order wins, so the result does not depend on the number of workers.
+//
+// "diverge" fails when the core's registers, SR or PC differ from the instruction level model
+// (iss68k.h) at an instruction boundary. The model starts from the core's registers at the
+// first instruction; comparison ends at the first interrupt or bus error, or at an instruction
+// the model leaves to the RTL.
+#include "fx68k_harness.h"
+#include "arch_state.h"
+#include "fault_injector.h"
+#include "iss68k.h"
+#include "watchdog.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint16_t NOP = 0x4E71;
+
+struct IrqEvent {
+    uint64_t cycle;
+    int level;
+    uint64_t length;                // 0: until acknowledged
+};
+
+enum ExpectKind { EXPECT_HALTED, EXPECT_VECTOR, EXPECT_PC, EXPECT_STUCK, EXPECT_DIVERGE };
+
+struct Reproducer {
+    std::vector<std::string> images;
+    uint64_t cycles;
+    std::vector<IrqEvent> irqs;
+    std::vector<FaultRule> faults;
+    std::vector<uint32_t> nops;
+    ExpectKind expect;
+    uint32_t expect_value;          // Vector, PC or Watchdog::Verdict
+
+    Reproducer() : cycles(1000000), expect(EXPECT_HALTED), expect_value(0) {}
+
+    size_t events() const { return irqs.size() + faults.size(); }
+
+    bool parse_expect(const std::string& spec, std::string& error) {
+        std::istringstream in(spec);
+        std::string kind, rest;
+        in >> kind;
+        std::getline(in >> std::ws, rest);
+        if (kind == "halted") {
+            expect = EXPECT_HALTED;
+        } else if (kind == "vector" && !rest.empty()) {
+            expect = EXPECT_VECTOR;
+            expect_value = std::stoul(rest);
+        } else if (kind == "pc" && !rest.empty()) {
+            expect = EXPECT_PC;
+            expect_value = std::stoul(rest, nullptr, 16) & FlatMemory::ADDR_MASK;
+        } else if (kind == "stuck") {
+            expect = EXPECT_STUCK;
+            for (int v = Watchdog::HALTED; v < Watchdog::VERDICTS; v++) {
+                if (rest == Watchdog::name(Watchdog::Verdict(v))) {
+                    expect_value = v;
+                    return true;
+                }
+            }
+            error = "unknown watchdog verdict: " + rest;
+            return false;
+        } else if (kind == "diverge") {
+            expect = EXPECT_DIVERGE;
+        } else {
+            error = "bad expect: " + spec;
+            return false;
+        }
+        return true;
+    }
+
+    std::string describe_expect() const {
+        char buf[64];
+        switch (expect) {
+        case EXPECT_HALTED: return "halted";
+        case EXPECT_VECTOR: return "vector " + std::to_string(expect_value);
+        case EXPECT_PC: std::snprintf(buf, sizeof(buf), "pc %06X", expect_value); return buf;
+        case EXPECT_STUCK: return std::string("stuck ") + Watchdog::name(Watchdog::Verdict(expect_value));
+        default: return "diverge";
+        }
+    }
+
+    bool load(const std::string& path, std::string& error) {
+        std::ifstream in(path);
+        if (!in.is_open()) {
+            error = "could not open " + path;
+            return false;
+        }
+        std::string line;
+        int number = 0;
+        while (std::getline(in, line)) {
+            number++;
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            std::string key, rest;
+            if (!(fields >> key)) continue;
+            std::getline(fields >> std::ws, rest);
+            std::string where = path + ":" + std::to_string(number) + ": ";
+            try {
+                if (key == "image") {
+                    images.push_back(rest);
+                } else if (key == "cycles") {
+                    cycles = std::stoull(rest);
+                } else if (key == "irq") {
+                    IrqEvent e = IrqEvent();
+                    std::istringstream v(rest);
+                    if (!(v >> e.cycle >> e.level) || e.level < 1 || e.level > 7) {
+                        error = where + "irq CYCLE LEVEL [LEN]";
+                        return false;
+                    }
+                    v >> e.length;
+                    irqs.push_back(e);
+                } else if (key == "berr") {
+                    FaultRule rule;
+                    if (!FaultRule::parse(rest, rule, error)) {
+                        error = where + error;
+                        return false;
+                    }
+                    faults.push_back(rule);
+                } else if (key == "nop") {
+                    nops.push_back(std::stoul(rest, nullptr, 16) & FlatMemory::ADDR_MASK);
+                } else if (key == "expect") {
+                    if (!parse_expect(rest, error)) {
+                        error = where + error;
+                        return false;
+                    }
+                } else {
+                    error = where + "unknown item " + key;
+                    return false;
+                }
+            } catch (const std::exception&) {
+                error = where + "bad value";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool save(const std::string& path, std::string& error) const {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            error = "could not write " + path;
+            return false;
+        }
+        out << "# fx68k reproducer" << std::endl;
+        for (const std::string& image : images) out << "image " << image << std::endl;
+        out << "cycles " << cycles << std::endl;
+        out << "expect " << describe_expect() << std::endl;
+        for (const IrqEvent& e : irqs) {
+            out << "irq " << e.cycle << " " << e.level;
+            if (e.length) out << " " << e.length;
+            out << std::endl;
+        }
+        for (const FaultRule& rule : faults) out << "berr " << rule.spec() << std::endl;
+        char buf[32];
+        for (uint32_t addr : nops) {
+            std::snprintf(buf, sizeof(buf), "nop %06X", addr);
+            out << buf << std::endl;
+        }
+        out.close();
+        if (!out) error = "could not write " + path;
+        return bool(out);
+    }
+};
+
+// Interrupt levels as IrqEvents, bus errors as single cycle rules. Edges count from the start
+// of the stream; the cycles of the reproducer from the edge that releases its last reset.
+static bool import_stimulus(const std::string& path, Reproducer& r, std::string& error) {
+    StimulusPlayer player;
+    if (!player.open(path, error)) return false;
+    std::vector<std::pair<uint64_t, uint16_t>> changes = player.pin_changes();
+    uint64_t reset_end = 0;
+    bool in_reset = false;
+    int level = 0;
+    uint64_t level_from = 0;
+    bool berr = false;
+    for (const auto& c : changes) {
+        uint16_t pins = c.second;
+        if (((pins >> PIN_extReset) & 1) || ((pins >> PIN_pwrUp) & 1)) {
+            in_reset = true;
+            continue;
+        }
+        if (in_reset) {
+            reset_end = c.first;
+            in_reset = false;
+        }
+        uint64_t cycle = (c.first - std::min(c.first, reset_end)) >> 1;
+        int now = 7 & ~(pins >> PIN_IPL0n);
+        if (now != level) {
+            if (level) r.irqs.push_back(IrqEvent{ level_from, level, std::max<uint64_t>(cycle - level_from, 1) });
+            level = now;
+            level_from = cycle;
+        }
+        bool now_berr = !((pins >> PIN_BERRn) & 1);
+        if (now_berr && !berr) {
+            // The harness drives BERRn from the edge after the cycle starts, so it started this
+            // cycle or the one before; bus cycles are further apart than that
+            FaultRule rule;
+            std::string spec = "cycle=" + std::to_string(cycle ? cycle - 1 : 0) + "-" + std::to_string(cycle) + ",max=1";
+            FaultRule::parse(spec, rule, error);
+            r.faults.push_back(rule);
+        }
+        berr = now_berr;
+    }
+    if (level) r.irqs.push_back(IrqEvent{ level_from, level, 0 });
+    return true;
+}
+
+static bool load_image(FlatMemory& mem, const std::string& spec, std::string& error) {
+    size_t at = spec.rfind('@');
+    std::string filename = spec.substr(0, at);
+    uint32_t addr = (at == std::string::npos) ? 0 : std::stoul(spec.substr(at + 1), nullptr, 16);
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        error = "could not open " + filename;
+        return false;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    bytes.resize((bytes.size() + 1) & ~size_t(1));
+    std::vector<uint16_t> words(bytes.size() / 2);
+    for (size_t i = 0; i < words.size(); i++) {
+        words[i] = (bytes[i * 2] << 8) | bytes[i * 2 + 1];
+    }
+    mem.load(addr, words);
+    return true;
+}
+
+static void apply_nops(FlatMemory& mem, const std::vector<uint32_t>& nops) {
+    for (uint32_t addr : nops) {
+        unsigned n = Iss68k::words(mem.read_word(addr));
+        for (unsigned i = 0; i < n; i++) mem.write_word(addr + i * 2, NOP);
+    }
+}
+
+struct Outcome {
+    bool failed;
+    uint64_t fail_cycle;
+    std::string detail;
+    std::vector<uint32_t> executed;         // Opcode addresses, sorted
+    std::vector<BusCycle> faulted;          // Cycles answered with BERRn
+};
+
+// One harness, reused for every candidate it is given. The images are loaded once as the
+// memory baseline; a run only changes the NOPs and the events.
+class CandidateRunner : public InstructionObserver, public IackResponder {
+public:
+    explicit CandidateRunner(const Reproducer& base) : iss(iss_mem), r(nullptr), stopped(false), comparing(false), synced(false) {
+        std::string error;
+        for (const std::string& image : base.images) {
+            load_image(hw.mem, image, error);
+            load_image(iss_mem, image, error);
+        }
+        hw.mem.commit_baseline();
+        iss_mem.commit_baseline();
+        hw.insn_observer = this;
+        hw.iack_responder = this;
+    }
+
+    Outcome run(const Reproducer& candidate) {
+        r = &candidate;
+        out = Outcome();
+        stopped = false;
+        hw.mem.restore_baseline();
+        apply_nops(hw.mem, candidate.nops);
+        if (candidate.expect == EXPECT_DIVERGE) {
+            iss_mem.restore_baseline();
+            apply_nops(iss_mem, candidate.nops);
+            comparing = true;
+            synced = false;
+        }
+        injector = BusFaultInjector();
+        for (const FaultRule& rule : candidate.faults) injector.add(rule);
+        injector.reset(1);
+        hw.bus_faults = candidate.faults.empty() ? nullptr : &injector;
+        acked.assign(candidate.irqs.size(), false);
+        executed.clear();
+
+        hw.last_vector = ~0u;
+        hw.set_ipl(0);
+        hw.reset();
+        watchdog.reset(hw.cycles());
+        while (!stopped && hw.cycles() < candidate.cycles) {
+            int level = irq_level(hw.cycles());
+            if (level) comparing = false;
+            hw.set_ipl(level);
+            hw.step_cycle();
+            if (!injector.injected.empty()) comparing = false;
+            check();
+        }
+
+        std::sort(executed.begin(), executed.end());
+        executed.erase(std::unique(executed.begin(), executed.end()), executed.end());
+        out.executed = executed;
+        out.faulted = injector.injected;
+        return out;
+    }
+
+    void instruction(uint32_t addr, uint16_t opcode, uint64_t cycle) override {
+        (void)opcode;
+        executed.push_back(addr);
+        if (stopped) return;
+        if (r->expect == EXPECT_PC && addr == r->expect_value) fail(cycle, "reached PC");
+        if (r->expect == EXPECT_DIVERGE && comparing) compare(addr, cycle);
+    }
+
+    IackReply acknowledge(int level, uint8_t& vector) override {
+        (void)vector;
+        uint64_t now = hw.cycles();
+        for (size_t i = 0; i < r->irqs.size(); i++) {
+            if (active(i, now) && r->irqs[i].level == level) acked[i] = true;
+        }
+        return IackReply::AUTOVECTOR;
+    }
+
+    // Records the pins of the runs that follow, reset included; nullptr stops
+    void record(StimulusRecorder* recorder) { hw.recorder = recorder; }
+
+    // Memory, registers and cycle count where the last run stopped, with what it executed
+    // and the bus cycles it faulted
+    uint64_t digest() const {
+        uint64_t h = 0xCBF29CE484222325ull;
+        auto fold = [&h](const void* data, size_t size) {
+            const uint8_t* p = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; i++) h = (h ^ p[i]) * 0x100000001B3ull;
+        };
+        for (uint32_t page = 0; page < FlatMemory::PAGE_COUNT; page++) {
+            fold(hw.mem.page_data(page), FlatMemory::PAGE_WORDS * 2);
+        }
+        std::string regs = ArchState(hw.cpu).snapshot().describe();
+        fold(regs.data(), regs.size());
+        uint64_t counters[] = { hw.ticks, hw.instructions, out.failed, out.fail_cycle };
+        fold(counters, sizeof(counters));
+        fold(out.executed.data(), out.executed.size() * sizeof(uint32_t));
+        for (const BusCycle& c : out.faulted) {
+            uint64_t cycle[] = { c.addr, c.start_cycle };
+            fold(cycle, sizeof(cycle));
+        }
+        return h;
+    }
+
+private:
+    Fx68kHarness hw;
+    FlatMemory iss_mem;
+    Iss68k iss;
+    BusFaultInjector injector;
+    Watchdog watchdog;
+    const Reproducer* r;
+    Outcome out;
+    bool stopped;
+    bool comparing;
+    bool synced;
+    std::vector<bool> acked;
+    std::vector<uint32_t> executed;
+
+    bool active(size_t i, uint64_t cycle) const {
+        const IrqEvent& e = r->irqs[i];
+        return cycle >= e.cycle && !acked[i] && (!e.length || cycle < e.cycle + e.length);
+    }
+
+    int irq_level(uint64_t cycle) const {
+        int level = 0;
+        for (size_t i = 0; i < r->irqs.size(); i++) {
+            if (active(i, cycle)) level = std::max(level, r->irqs[i].level);
+        }
+        return level;
+    }
+
+    void fail(uint64_t cycle, const std::string& detail) {
+        stopped = true;
+        out.failed = true;
+        out.fail_cycle = cycle;
+        out.detail = detail;
+    }
+
+    void check() {
+        if (stopped) return;
+        uint64_t now = hw.cycles();
+        switch (r->expect) {
+        case EXPECT_HALTED:
+            if (hw.halted()) fail(now, "halted");
+            break;
+        case EXPECT_VECTOR:
+            if (hw.last_vector == r->expect_value) fail(now, "took vector " + std::to_string(r->expect_value));
+            break;
+        case EXPECT_STUCK:
+            if (watchdog.sample(hw.cpu, now)) {
+                if (watchdog.verdict == Watchdog::Verdict(r->expect_value)) {
+                    fail(now, watchdog.describe());
+                } else {
+                    stopped = true;         // Stuck some other way, it will not get there
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    // At an instruction boundary: the model runs the instruction that just retired, then both
+    // must agree on every register and on the address of the instruction about to start
+    void compare(uint32_t addr, uint64_t cycle) {
+        ArchState arch(hw.cpu);
+        if (!synced) {
+            for (int i = 0; i < 8; i++) {
+                iss.d[i] = arch.d(i);
+                iss.a[i] = arch.a(i);
+            }
+            // a[7] is the stack pointer of the mode set_sr() leaves the model in
+            iss.set_sr(arch.sr() ^ 0x2000);
+            iss.a[7] = arch.supervisor() ? arch.usp() : arch.ssp();
+            iss.set_sr(arch.sr());
+            iss.a[7] = arch.sp();
+            iss.pc = addr;
+            synced = true;
+            return;
+        }
+        if (iss.step() != Iss68k::RUNNING) {
+            comparing = false;
+            return;
+        }
+        ArchSnapshot rtl = arch.snapshot();
+        ArchSnapshot model = rtl;
+        for (int i = 0; i < 8; i++) {
+            model.d[i] = iss.d[i];
+            model.a[i] = iss.a[i];
+        }
+        model.usp = iss.usp();
+        model.ssp = iss.ssp();
+        model.sr = iss.sr;
+        std::string diff = rtl.diff(model);
+        if (addr != iss.pc) {
+            char buf[64];
+            std::snprintf(buf, sizeof(buf), "%sPC=%06X (expected %06X)", diff.empty() ? "" : ", ", addr, iss.pc);
+            diff += buf;
+        }
+        if (!diff.empty()) fail(cycle, "after the instruction at " + hex(iss.stop_pc) + ": " + diff);
+    }
+
+    static std::string hex(uint32_t addr) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "%06X", addr);
+        return buf;
+    }
+};
+
+class Minimizer {
+public:
+    struct Stats {
+        uint64_t candidates;
+        uint64_t accepted;
+        size_t events_removed;
+        size_t events_simplified;
+        size_t instructions_removed;
+        uint64_t cycles_before;
+    };
+
+    Reproducer best;
+    Outcome outcome;                // Of best
+    Stats stats;
+
+    Minimizer(const Reproducer& start, unsigned jobs) : best(start), stats() {
+        for (unsigned j = 0; j < jobs; j++) runners.emplace_back(new CandidateRunner(start));
+    }
+
+    bool reproduce() {
+        std::vector<Reproducer> one(1, best);
+        if (first_failing(one) < 0) return false;
+        stats.cycles_before = best.cycles;
+        best.cycles = outcome.fail_cycle;
+        return true;
+    }
+
+    void minimize(unsigned max_rounds) {
+        for (unsigned round = 0; round < max_rounds; round++) {
+            uint64_t accepted = stats.accepted;
+            reduce_events();
+            simplify_events();
+            reduce_instructions();
+            std::cout << "  round " << round + 1 << ": " << best.events() << " events, " << best.nops.size()
+                      << " NOPs, " << best.cycles << " cycles" << std::endl;
+            if (stats.accepted == accepted) break;
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<CandidateRunner>> runners;
+
+    // Index of the first candidate that still fails, -1 if none. Taking it updates best.
+    int first_failing(const std::vector<Reproducer>& candidates) {
+        std::vector<Outcome> results(candidates.size());
+        std::atomic<size_t> first(candidates.size());
+        unsigned jobs = unsigned(std::min(runners.size(), candidates.size()));
+        std::vector<std::thread> workers;
+        for (unsigned j = 0; j < jobs; j++) {
+            workers.emplace_back([&, j]() {
+                for (size_t n = j; n < candidates.size(); n += jobs) {
+                    if (n > first.load()) break;
+                    results[n] = runners[j]->run(candidates[n]);
+                    if (!results[n].failed) continue;
+                    size_t seen = first.load();
+                    while (n < seen && !first.compare_exchange_weak(seen, n)) {}
+                }
+            });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+        stats.candidates += candidates.size();
+        size_t n = first.load();
+        if (n == candidates.size()) return -1;
+        best = candidates[n];
+        best.cycles = results[n].fail_cycle;
+        outcome = results[n];
+        return int(n);
+    }
+
+    // Classic ddmin on complements: drop one of k chunks, k doubling while nothing can go
+    template <class Item, class Build>
+    size_t ddmin(std::vector<Item> items, Build build) {
+        size_t removed = 0;
+        size_t chunks = 2;
+        while (!items.empty()) {
+            chunks = std::min(chunks, items.size());
+            std::vector<Reproducer> candidates;
+            std::vector<std::vector<Item>> kept;
+            for (size_t c = 0; c < chunks; c++) {
+                size_t lo = items.size() * c / chunks, hi = items.size() * (c + 1) / chunks;
+                std::vector<Item> rest(items.begin(), items.begin() + lo);
+                rest.insert(rest.end(), items.begin() + hi, items.end());
+                candidates.push_back(build(rest));
+                kept.push_back(rest);
+            }
+            int n = first_failing(candidates);
+            if (n >= 0) {
+                stats.accepted++;
+                removed += items.size() - kept[n].size();
+                items = kept[n];
+                chunks = std::max<size_t>(chunks - 1, 2);
+            } else if (chunks >= items.size()) {
+                break;
+            } else {
+                chunks *= 2;
+            }
+        }
+        return removed;
+    }
+
+    void reduce_events() {
+        // Events as one list: interrupts first, then bus error rules
+        std::vector<size_t> items;
+        for (size_t i = 0; i < best.events(); i++) items.push_back(i);
+        Reproducer base = best;
+        stats.events_removed += ddmin(items, [&](const std::vector<size_t>& keep) {
+            Reproducer c = base;
+            c.cycles = best.cycles;
+            c.irqs.clear();
+            c.faults.clear();
+            for (size_t i : keep) {
+                if (i < base.irqs.size()) {
+                    c.irqs.push_back(base.irqs[i]);
+                } else {
+                    c.faults.push_back(base.faults[i - base.irqs.size()]);
+                }
+            }
+            return c;
+        });
+    }
+
+    void simplify_events() {
+        for (size_t i = 0; i < best.irqs.size(); i++) {
+            // Lowest level first, then the shortest assertion
+            std::vector<Reproducer> candidates;
+            for (int level = 1; level < best.irqs[i].level; level++) {
+                candidates.push_back(best);
+                candidates.back().irqs[i].level = level;
+            }
+            if (accept(candidates)) stats.events_simplified++;
+            candidates.clear();
+            for (uint64_t length = 1; best.irqs[i].length && length < best.irqs[i].length; length *= 2) {
+                candidates.push_back(best);
+                candidates.back().irqs[i].length = length;
+            }
+            if (accept(candidates)) stats.events_simplified++;
+        }
+        for (size_t i = 0; i < best.faults.size(); i++) {
+            // One rule can only fire on the cycles it hit, try each alone
+            std::vector<Reproducer> candidates;
+            for (const BusCycle& hit : outcome.faulted) {
+                FaultRule rule;
+                std::string error;
+                std::string cycle = std::to_string(hit.start_cycle);
+                FaultRule::parse("addr=" + hex(hit.addr) + ",cycle=" + cycle + "-" + cycle + ",max=1", rule, error);
+                if (rule.spec() == best.faults[i].spec()) continue;
+                candidates.push_back(best);
+                candidates.back().faults[i] = rule;
+            }
+            if (accept(candidates)) stats.events_simplified++;
+        }
+    }
+
+    void reduce_instructions() {
+        std::vector<uint32_t> items;
+        for (uint32_t addr : outcome.executed) {
+            if (std::find(best.nops.begin(), best.nops.end(), addr) == best.nops.end()) items.push_back(addr);
+        }
+        Reproducer base = best;
+        stats.instructions_removed += ddmin(items, [&](const std::vector<uint32_t>& keep) {
+            // Everything executed and not kept, including what earlier steps dropped
+            Reproducer c = base;
+            c.cycles = best.cycles;
+            for (uint32_t addr : items) {
+                if (!std::binary_search(keep.begin(), keep.end(), addr)) c.nops.push_back(addr);
+            }
+            std::sort(c.nops.begin(), c.nops.end());
+            return c;
+        });
+    }
+
+    bool accept(const std::vector<Reproducer>& candidates) {
+        if (candidates.empty() || first_failing(candidates) < 0) return false;
+        stats.accepted++;
+        return true;
+    }
+
+    static std::string hex(uint32_t v) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "%X", v);
+        return buf;
+    }
+};
+
+// Guest for --stim-check without images: a loop storing to $2000, an interrupt handler for every
+// autovector and a bus error handler that restarts the loop on a fresh stack
+static const std::vector<std::pair<uint32_t, std::vector<uint16_t>>> STIM_CHECK_PROGRAM = {
+    { 0x000000, { 0x0000, 0xF000, 0x0000, 0x0400, 0x0000, 0x0500 } },  // SSP, PC, bus error
+    { 0x000064, { 0x0000, 0x0600, 0x0000, 0x0600, 0x0000, 0x0600, 0x0000, 0x0600,
+                  0x0000, 0x0600, 0x0000, 0x0600, 0x0000, 0x0600 } },  // Autovectors 1-7
+    { 0x000400, { 0x46FC, 0x2000,           // MOVE #$2000,SR
+                  0x7000,                   // MOVEQ #0,D0
+                  0x7200,                   // MOVEQ #0,D1
+                  0x7400,                   // MOVEQ #0,D2
+                  0x7600,                   // MOVEQ #0,D3
+                  0x207C, 0x0000, 0x2000,   // MOVEA.L #$2000,A0
+                  0x5280,                   // loop: ADDQ.L #1,D0
+                  0x2080,                   // MOVE.L D0,(A0)
+                  0xD280,                   // ADD.L D0,D1
+                  0x3141, 0x0004,           // MOVE.W D1,4(A0)
+                  0x60F4 } },               // BRA.S loop
+    { 0x000500, { 0x5283,                   // ADDQ.L #1,D3
+                  0x4FF9, 0x0000, 0xF000,   // LEA $F000,A7
+                  0x46FC, 0x2000,           // MOVE #$2000,SR
+                  0x4EF8, 0x0412 } },       // JMP loop
+    { 0x000600, { 0x5282,                   // ADDQ.L #1,D2
+                  0x2142, 0x0008,           // MOVE.L D2,8(A0)
+                  0x4E73 } },               // RTE
+};
+
+static const char* const STIM_CHECK_EVENTS[] = {
+    "irq 2000 3", "irq 9000 5 40", "irq 9010 2", "berr cycle=20000-20100,max=1", "irq 30000 7 1000",
+};
+
+// Record a run of the reproducer, import the recording into a copy without events and run that:
+// it must end in the same state. Without images the built-in guest and events are used, the
+// guest written to FILE.bin.
+static bool stimulus_round_trip(Reproducer recorded, const std::string& path, std::string& error) {
+    if (recorded.images.empty()) {
+        std::ofstream image(path + ".bin", std::ios::binary);
+        for (const auto& segment : STIM_CHECK_PROGRAM) {
+            image.seekp(segment.first);
+            for (uint16_t w : segment.second) {
+                image.put(char(w >> 8));
+                image.put(char(w & 0xFF));
+            }
+        }
+        image.close();
+        if (!image) {
+            error = "could not write " + path + ".bin";
+            return false;
+        }
+        recorded.images.push_back(path + ".bin");
+        recorded.cycles = 50000;
+        recorded.irqs.clear();
+        recorded.faults.clear();
+        for (const char* event : STIM_CHECK_EVENTS) {
+            std::istringstream in(event);
+            std::string key, rest;
+            in >> key;
+            std::getline(in >> std::ws, rest);
+            if (key == "irq") {
+                IrqEvent e = IrqEvent();
+                std::istringstream(rest) >> e.cycle >> e.level >> e.length;
+                recorded.irqs.push_back(e);
+            } else {
+                FaultRule rule;
+                FaultRule::parse(rest, rule, error);
+                recorded.faults.push_back(rule);
+            }
+        }
+    }
+
+    StimulusRecorder recorder;
+    if (!recorder.open(path)) {
+        error = "could not write " + path;
+        return false;
+    }
+    CandidateRunner first(recorded);
+    first.record(&recorder);
+    Outcome original = first.run(recorded);
+    first.record(nullptr);
+    recorder.close();
+
+    Reproducer imported = recorded;
+    imported.irqs.clear();
+    imported.faults.clear();
+    if (!import_stimulus(path, imported, error)) return false;
+    CandidateRunner second(imported);
+    Outcome replayed = second.run(imported);
+
+    std::cout << "Recorded: " << recorded.irqs.size() << " irq, " << recorded.faults.size() << " berr, "
+              << original.faulted.size() << " bus errors taken" << std::endl;
+    std::cout << "Imported: " << imported.irqs.size() << " irq, " << imported.faults.size() << " berr, "
+              << replayed.faulted.size() << " bus errors taken" << std::endl;
+    if (first.digest() != second.digest()) {
+        error = "the imported stimulus ends in a different state than the recorded run";
+        return false;
+    }
+    return true;
+}
+
+static void print_help(const char* prog) {
+    std::cout << "Usage: " << prog << " [options] [REPRODUCER]" << std::endl;
+    std::cout << "  --load FILE[@ADDR]  Add an image (as 'image' in a reproducer)" << std::endl;
+    std::cout << "  --stim FILE         Add the interrupts and bus errors of a recorded stimulus" << std::endl;
+    std::cout << "  --cycles N          Run length (default 1000000, or the reproducer's)" << std::endl;
+    std::cout << "  --expect FAILURE    halted | vector N | pc ADDR | stuck VERDICT | diverge" << std::endl;
+    std::cout << "  --out FILE          Minimized reproducer (default REPRODUCER.min or fx68k.repro)" << std::endl;
+    std::cout << "  --rounds N          At most N rounds (default 8)" << std::endl;
+    std::cout << "  --jobs N            Worker threads (default: all cores)" << std::endl;
+    std::cout << "  --stim-check FILE   Record a run into FILE, import it back and check that the" << std::endl;
+    std::cout << "                      replay ends the same (built-in guest without images)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    Verilated::commandArgs(argc, argv);
+    Fx68kHarness::command_args(argc, argv);
+
+    Reproducer repro;
+    std::string input, out_file, error;
+    std::vector<std::string> stims;
+    unsigned rounds = 8;
+    unsigned jobs = std::thread::hardware_concurrency();
+    bool cycles_set = false;
+    std::string expect;
+    std::vector<std::string> images;
+    uint64_t cycles = 0;
+    std::string stim_check;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--load" && i + 1 < argc) {
+            images.push_back(argv[++i]);
+        } else if (arg == "--stim" && i + 1 < argc) {
+            stims.push_back(argv[++i]);
+        } else if (arg == "--cycles" && i + 1 < argc) {
+            cycles = std::stoull(argv[++i]);
+            cycles_set = true;
+        } else if (arg == "--expect" && i + 1 < argc) {
+            expect = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            out_file = argv[++i];
+        } else if (arg == "--rounds" && i + 1 < argc) {
+            rounds = std::stoul(argv[++i]);
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            jobs = std::stoul(argv[++i]);
+        } else if (arg == "--stim-check" && i + 1 < argc) {
+            stim_check = argv[++i];
+        } else if (arg == "--help" || arg == "-h") {
+            print_help(argv[0]);
+            return 0;
+        } else if (arg[0] != '+' && arg[0] != '-') {
+            input = arg;
+        }
+    }
+    if (jobs == 0) jobs = 1;
+
+    if (!input.empty() && !repro.load(input, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 2;
+    }
+    repro.images.insert(repro.images.end(), images.begin(), images.end());
+    if (cycles_set) repro.cycles = cycles;
+    if (!expect.empty() && !repro.parse_expect(expect, error)) {
+        std::cerr << "Error: --expect: " << error << std::endl;
+        return 2;
+    }
+    for (const std::string& stim : stims) {
+        if (!import_stimulus(stim, repro, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 2;
+        }
+    }
+    if (!stim_check.empty()) {
+        std::cout << "Fx68k Stimulus Round Trip" << std::endl;
+        std::cout << "=========================" << std::endl;
+        bool same = stimulus_round_trip(repro, stim_check, error);
+        std::cout << "\n=== Stimulus Round Trip Summary ===" << std::endl;
+        std::cout << (same ? "Imported stimulus replays the recorded run" : "Error: " + error) << std::endl;
+        return same ? 0 : 1;
+    }
+    if (repro.images.empty()) {
+        print_help(argv[0]);
+        return 2;
+    }
+    for (const std::string& image : repro.images) {
+        FlatMemory probe;
+        if (!load_image(probe, image, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 2;
+        }
+    }
+    if (out_file.empty()) out_file = input.empty() ? "fx68k.repro" : input + ".min";
+
+    std::cout << "Fx68k Reproducer Minimizer" << std::endl;
+    std::cout << "==========================" << std::endl;
+    std::cout << "Expect: " << repro.describe_expect() << ", " << repro.events() << " events, "
+              << repro.cycles << " cycles, workers: " << jobs << std::endl;
+    Telemetry::process().set_test(0, "minimize " + repro.describe_expect());
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    Minimizer minimizer(repro, jobs);
+    if (!minimizer.reproduce()) {
+        std::cerr << "Error: the reproducer does not fail (" << repro.describe_expect() << ") within "
+                  << repro.cycles << " cycles" << std::endl;
+        return 1;
+    }
+    std::cout << "Fails at cycle " << minimizer.best.cycles << ": " << minimizer.outcome.detail << std::endl;
+    minimizer.minimize(rounds);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+
+    if (!minimizer.best.save(out_file, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 1;
+    }
+
+    const Minimizer::Stats& s = minimizer.stats;
+    std::cout << "\n=== Minimizer Summary ===" << std::endl;
+    std::cout << "Candidates: " << s.candidates << " run, " << s.accepted << " accepted, in "
+              << duration.count() << " ms" << std::endl;
+    std::cout << "Cycles: " << s.cycles_before << " -> " << minimizer.best.cycles << std::endl;
+    std::cout << "Events: " << repro.events() << " -> " << minimizer.best.events() << " ("
+              << s.events_simplified << " simplified)" << std::endl;
+    std::cout << "Instructions replaced by NOPs: " << minimizer.best.nops.size() << std::endl;
+    std::cout << "Failure: " << minimizer.outcome.detail << std::endl;
+    std::cout << "Reproducer: " << out_file << std::endl;
+    return 0;
+}
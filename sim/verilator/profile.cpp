@@ -0,0 +1,219 @@
+// Guest code profiler for fx68k
+//
+// Loads raw binary images into the flat memory, resets the core (SSP and PC come from the
+// vectors in the image) and runs it for a number of cycles under SamplingProfiler, or until
+// the watchdog (watchdog.h) finds the core halted, stopped or spinning on itself. With
+// --semihost the guest can end the run itself and print through semihost.h. --toggles adds
+// the switching activity of the run (toggle_activity.h), to compare workloads for power.
+// --fast-forward/--fast-forward-to run the start of the guest on the instruction level model
+// and profile only from where the RTL takes over (fast_forward.h).
+// Writes a flat profile and a collapsed stack file for flamegraph tools.
+#include "fx68k_harness.h"
+#include "profiler.h"
+#include "semihost.h"
+#include "fast_forward.h"
+#include "watchdog.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <memory>
+
+// FILE or FILE@ADDR (hex), big endian image as seen by the CPU
+static bool load_image(Fx68kHarness& hw, const std::string& spec) {
+    size_t at = spec.rfind('@');
+    std::string filename = spec.substr(0, at);
+    uint32_t addr = (at == std::string::npos) ? 0 : std::stoul(spec.substr(at + 1), nullptr, 16);
+
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open " << filename << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    bytes.resize((bytes.size() + 1) & ~size_t(1));
+
+    std::vector<uint16_t> words(bytes.size() / 2);
+    for (size_t i = 0; i < words.size(); i++) {
+        words[i] = (bytes[i * 2] << 8) | bytes[i * 2 + 1];
+    }
+    hw.mem.load(addr, words);
+    std::cout << "Loaded " << filename << " at $" << std::hex << addr << std::dec
+              << " (" << bytes.size() << " bytes)" << std::endl;
+    return true;
+}
+
+static void print_help(const char* prog) {
+    std::cout << "Usage: " << prog << " [options] --load FILE[@ADDR] ..." << std::endl;
+    std::cout << "  --load FILE[@ADDR] Raw binary image, hex load address (default 0, vectors included)" << std::endl;
+    std::cout << "  --cycles N         CPU cycles to run (default 10000000)" << std::endl;
+    std::cout << "  --interval N       Mean cycles between samples (default 1000)" << std::endl;
+    std::cout << "  --random           Randomize the sample interval around N" << std::endl;
+    std::cout << "  --seed N           Seed for --random (default 1)" << std::endl;
+    std::cout << "  --symbols FILE     Symbol map: nm output or an ELF32 file" << std::endl;
+    std::cout << "  --flat FILE        Flat profile (default fx68k_profile.txt)" << std::endl;
+    std::cout << "  --collapsed FILE   Collapsed stacks (default fx68k_profile.folded)" << std::endl;
+    std::cout << "  --no-watchdog      Run all cycles even when the core is stuck" << std::endl;
+    std::cout << "  --semihost         Guest calls at $FFF000: exit, console, benchmark markers" << std::endl;
+    std::cout << "  --semihost-trap N  Also install a TRAP #N handler for them" << std::endl;
+    std::cout << "  --toggles FILE     Signal toggle counts: SAIF if FILE ends in .saif, else CSV" << std::endl;
+    std::cout << "  --fast-forward N   Run the first N instructions on the instruction level model" << std::endl;
+    std::cout << "  --fast-forward-to ADDR  Same, up to the hex PC ADDR" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    Verilated::commandArgs(argc, argv);
+    Fx68kHarness::command_args(argc, argv);
+
+    std::vector<std::string> images;
+    uint64_t cycles = 10000000;
+    uint64_t interval = 1000;
+    bool randomize = false;
+    uint32_t seed = 1;
+    std::string symbol_file;
+    std::string flat_file = "fx68k_profile.txt";
+    std::string collapsed_file = "fx68k_profile.folded";
+    bool use_watchdog = true;
+    bool semihosting = false;
+    int semihost_trap = -1;
+    std::string toggle_file;
+    uint64_t ff_instructions = 0;
+    uint32_t ff_target = Iss68k::NO_TARGET;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--load" && i + 1 < argc) {
+            images.push_back(argv[++i]);
+        } else if (arg == "--cycles" && i + 1 < argc) {
+            cycles = std::stoull(argv[++i]);
+        } else if (arg == "--interval" && i + 1 < argc) {
+            interval = std::stoull(argv[++i]);
+        } else if (arg == "--random") {
+            randomize = true;
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoul(argv[++i]);
+        } else if (arg == "--symbols" && i + 1 < argc) {
+            symbol_file = argv[++i];
+        } else if (arg == "--flat" && i + 1 < argc) {
+            flat_file = argv[++i];
+        } else if (arg == "--collapsed" && i + 1 < argc) {
+            collapsed_file = argv[++i];
+        } else if (arg == "--no-watchdog") {
+            use_watchdog = false;
+        } else if (arg == "--semihost") {
+            semihosting = true;
+        } else if (arg == "--semihost-trap" && i + 1 < argc) {
+            semihosting = true;
+            semihost_trap = std::stoi(argv[++i]) & 15;
+        } else if (arg == "--toggles" && i + 1 < argc) {
+            toggle_file = argv[++i];
+        } else if (arg == "--fast-forward" && i + 1 < argc) {
+            ff_instructions = std::stoull(argv[++i]);
+        } else if (arg == "--fast-forward-to" && i + 1 < argc) {
+            ff_target = std::stoul(argv[++i], nullptr, 16) & FlatMemory::ADDR_MASK;
+        } else if (arg == "--help" || arg == "-h") {
+            print_help(argv[0]);
+            return 0;
+        }
+    }
+
+    if (images.empty()) {
+        print_help(argv[0]);
+        return 2;
+    }
+
+    std::cout << "Fx68k Guest Profiler" << std::endl;
+    std::cout << "====================" << std::endl;
+
+    SymbolMap symbols;
+    if (!symbol_file.empty()) {
+        std::string error;
+        if (!symbols.load(symbol_file, error)) {
+            std::cerr << "Error: " << symbol_file << ": " << error << std::endl;
+            return 2;
+        }
+        std::cout << "Symbols: " << symbols.size() << " from " << symbol_file << std::endl;
+    }
+
+    Telemetry::process().set_test(0, "profile " + images[0]);
+    Fx68kHarness hw;
+    for (const std::string& spec : images) {
+        if (!load_image(hw, spec)) {
+            return 2;
+        }
+    }
+
+    Semihost semihost;
+    if (semihosting) {
+        hw.host = &semihost;
+        if (semihost_trap >= 0) semihost.install_trap(hw.mem, semihost_trap);
+    }
+
+    std::unique_ptr<ToggleActivity> toggles;
+    if (!toggle_file.empty()) {
+        toggles.reset(new ToggleActivity(hw.cpu));
+    }
+
+    SamplingProfiler profiler(interval, randomize, seed);
+    hw.insn_observer = &profiler;
+    FastForward fast_forward;
+    bool fast_forwarding = ff_instructions || ff_target != Iss68k::NO_TARGET;
+    if (fast_forwarding) {
+        std::string error;
+        uint64_t limit = ff_instructions ? ff_instructions : FastForward::DEFAULT_LIMIT;
+        if (!fast_forward.run(hw, limit, ff_target, error)) {
+            std::cerr << "Error: fast forward: " << error << std::endl;
+            return 1;
+        }
+    } else {
+        hw.reset();
+    }
+    Watchdog watchdog;
+    watchdog.reset(hw.cycles());
+    hw.toggles = toggles.get();
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    hw.run_until([&] {
+        return hw.halted() || semihost.exited() || (use_watchdog && watchdog.sample(hw.cpu, hw.cycles()));
+    }, cycles);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
+
+    if (!profiler.write_flat(flat_file, symbols) || !profiler.write_collapsed(collapsed_file, symbols)) {
+        std::cerr << "Error: Could not write profile output" << std::endl;
+        return 1;
+    }
+
+    double seconds = duration.count() / 1e6;
+    std::cout << "\n=== Profile Summary ===" << std::endl;
+    std::cout << "Cycles: " << hw.cycles() << (hw.halted() ? " (CPU halted)" : "") << std::endl;
+    if (watchdog.stuck()) std::cout << "Watchdog: " << watchdog.describe() << std::endl;
+    std::cout << "Samples: " << profiler.sample_count() << std::endl;
+    std::cout << "Speed: " << (seconds > 0 ? hw.cycles() / seconds / 1e6 : 0.0) << " MHz" << std::endl;
+
+    std::vector<SamplingProfiler::ProfileLine> lines = profiler.flat_profile(symbols);
+    for (size_t i = 0; i < lines.size() && i < 10; i++) {
+        std::printf("  %6.2f%% %6.2f%%  %s\n", profiler.percent(lines[i].self), profiler.percent(lines[i].total),
+                    lines[i].name.c_str());
+    }
+    std::cout << "Flat profile: " << flat_file << std::endl;
+    std::cout << "Collapsed stacks: " << collapsed_file << std::endl;
+
+    if (fast_forwarding) fast_forward.print_summary();
+    if (toggles) {
+        std::string error;
+        bool saif = toggle_file.size() > 5 && toggle_file.compare(toggle_file.size() - 5, 5, ".saif") == 0;
+        if (!(saif ? toggles->write_saif(toggle_file, 31250, error) : toggles->write_csv(toggle_file, error))) {
+            std::cerr << "Error: " << error << std::endl;
+            return 1;
+        }
+        toggles->print_summary();
+        std::cout << "Toggle activity: " << toggle_file << std::endl;
+    }
+    if (semihosting) {
+        semihost.print_summary();
+        if (semihost.exited() && semihost.status) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,274 @@
+// Statistical guest profiler for fx68k
+//
+// Samples the executing instruction every N CPU cycles (optionally randomized around N to
+// avoid locking onto periodic guest loops) into a flat histogram and a call stack histogram.
+// Call chains are rebuilt from the instruction stream: the instruction started after a JSR/BSR
+// is pushed as callee entry, the one after RTS/RTR pops it. Exceptions are not tracked, so handlers show up under whatever
+// they interrupted. Runs as an InstructionObserver, costing a few compares per instruction.
+#ifndef FX68K_PROFILER_H
+#define FX68K_PROFILER_H
+
+#include "fx68k_harness.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Symbol {
+    uint32_t addr;
+    uint32_t size;          // 0 when unknown (nm text)
+    std::string name;
+};
+
+// Guest symbols from "nm" text output or straight from an ELF32 file
+class SymbolMap {
+public:
+    bool load(const std::string& filename, std::string& error) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            error = "could not open " + filename;
+            return false;
+        }
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        bool ok = (data.size() > 4 && data[0] == 0x7F && data[1] == 'E' && data[2] == 'L' && data[3] == 'F')
+                ? load_elf(data, error) : load_nm(data, error);
+        std::sort(symbols.begin(), symbols.end(),
+                  [](const Symbol& a, const Symbol& b) { return a.addr < b.addr; });
+        return ok;
+    }
+
+    size_t size() const { return symbols.size(); }
+
+    // Nearest symbol at or below addr, hex address when there is none
+    std::string name(uint32_t addr) const {
+        auto it = std::upper_bound(symbols.begin(), symbols.end(), addr,
+                                   [](uint32_t a, const Symbol& s) { return a < s.addr; });
+        if (it != symbols.begin()) {
+            --it;
+            if (!it->size || addr < it->addr + it->size) {
+                return it->name;
+            }
+        }
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "0x%06X", addr);
+        return buf;
+    }
+
+private:
+    std::vector<Symbol> symbols;
+
+    // "00001000 T main" or "00001000 main"
+    bool load_nm(const std::vector<uint8_t>& data, std::string& error) {
+        std::istringstream in(std::string(data.begin(), data.end()));
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string addr, type, name;
+            if (!(fields >> addr >> type)) continue;
+            if (!(fields >> name)) {
+                name = type;
+                type = "T";
+            }
+            if (addr.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) continue;
+            if (type.size() != 1 || std::string("TtWw").find(type[0]) == std::string::npos) continue;
+            symbols.push_back(Symbol{ uint32_t(std::stoul(addr, nullptr, 16)) & FlatMemory::ADDR_MASK, 0, name });
+        }
+        if (symbols.empty()) {
+            error = "no text symbols found";
+            return false;
+        }
+        return true;
+    }
+
+    bool load_elf(const std::vector<uint8_t>& data, std::string& error) {
+        if (data.size() < 52 || data[4] != 1) {
+            error = "only ELF32 is supported";
+            return false;
+        }
+        bool big = (data[5] == 2);
+        auto u16 = [&](size_t off) -> uint32_t {
+            if (off + 2 > data.size()) return 0;
+            return big ? (data[off] << 8) | data[off + 1] : data[off] | (data[off + 1] << 8);
+        };
+        auto u32 = [&](size_t off) -> uint32_t {
+            return big ? (u16(off) << 16) | u16(off + 2) : u16(off) | (u16(off + 2) << 16);
+        };
+
+        uint32_t shoff = u32(0x20), shentsize = u16(0x2E), shnum = u16(0x30);
+        for (uint32_t i = 0; i < shnum; i++) {
+            size_t sh = shoff + size_t(i) * shentsize;
+            if (u32(sh + 4) != 2) continue;                         // SHT_SYMTAB
+            uint32_t offset = u32(sh + 16), size = u32(sh + 20), entsize = u32(sh + 36);
+            size_t strtab = shoff + size_t(u32(sh + 24)) * shentsize;
+            uint32_t str_offset = u32(strtab + 16), str_size = u32(strtab + 20);
+            if (!entsize || size_t(offset) + size > data.size() || size_t(str_offset) + str_size > data.size()) {
+                break;
+            }
+
+            for (uint32_t sym = offset; sym + 16 <= offset + size; sym += entsize) {
+                uint32_t name = u32(sym), value = u32(sym + 4), sym_size = u32(sym + 8);
+                uint8_t type = data[sym + 12] & 0xF;
+                if ((type != 0 && type != 2) || !u16(sym + 14) || !name || name >= str_size) continue;
+                const char* str = reinterpret_cast<const char*>(&data[str_offset + name]);
+                std::string s(str, strnlen(str, str_size - name));
+                if (s.empty() || s[0] == '$' || s[0] == '.') continue;
+                symbols.push_back(Symbol{ value & FlatMemory::ADDR_MASK, sym_size, s });
+            }
+            return true;
+        }
+        error = "ELF file has no symbol table";
+        return false;
+    }
+};
+
+class SamplingProfiler : public InstructionObserver {
+public:
+    static const size_t MAX_DEPTH = 256;
+
+    // interval: mean CPU cycles between samples, randomize: uniform in [interval/2, 3*interval/2)
+    SamplingProfiler(uint64_t interval, bool randomize, uint32_t seed = 1)
+        : period(interval ? interval : 1), jitter(randomize), rng(seed), next_sample(0),
+          current(0), call_site(0), call_pending(false), return_pending(false), samples(0) {
+        next_sample = next_interval();
+    }
+
+    void instruction(uint32_t addr, uint16_t opcode, uint64_t cycle) override {
+        // Whatever started before the sample point was executing at it
+        while (cycle > next_sample) {
+            take_sample();
+            next_sample += next_interval();
+        }
+
+        // Calls and returns take effect once they have executed
+        if (call_pending && frames.size() < MAX_DEPTH) {
+            frames.push_back(Frame{ call_site, addr });
+        } else if (return_pending && !frames.empty()) {
+            frames.pop_back();
+        }
+        call_pending = (opcode & 0xFFC0) == 0x4E80 || (opcode & 0xFF00) == 0x6100;    // JSR, BSR
+        return_pending = opcode == 0x4E75 || opcode == 0x4E77;                      // RTS, RTR
+        call_site = addr;
+        current = addr;
+    }
+
+    uint64_t sample_count() const { return samples; }
+
+    struct ProfileLine {
+        std::string name;
+        uint64_t self;
+        uint64_t total;
+    };
+
+    // Per symbol self and inclusive samples, most self time first
+    std::vector<ProfileLine> flat_profile(const SymbolMap& symbols) const {
+        std::map<std::string, ProfileLine> lines;
+        for (const auto& s : stacks) {
+            std::vector<std::string> names = stack_names(s.first, symbols);
+            for (size_t i = 0; i < names.size(); i++) {
+                if (std::find(names.begin(), names.begin() + i, names[i]) == names.begin() + i) {
+                    ProfileLine& line = lines[names[i]];
+                    line.name = names[i];
+                    line.total += s.second;
+                }
+            }
+            lines[names.back()].self += s.second;
+        }
+
+        std::vector<ProfileLine> out;
+        for (const auto& l : lines) out.push_back(l.second);
+        std::sort(out.begin(), out.end(), [](const ProfileLine& a, const ProfileLine& b) {
+            return a.self != b.self ? a.self > b.self : a.total > b.total;
+        });
+        return out;
+    }
+
+    bool write_flat(const std::string& filename, const SymbolMap& symbols) const {
+        std::ofstream out(filename);
+        if (!out.is_open()) return false;
+        out << "# samples: " << samples << std::endl;
+        out << "#   self   self%    total  total%  symbol" << std::endl;
+        char buf[64];
+        for (const ProfileLine& l : flat_profile(symbols)) {
+            std::snprintf(buf, sizeof(buf), "%8llu %6.2f%% %8llu %6.2f%%  ", (unsigned long long)l.self,
+                          percent(l.self), (unsigned long long)l.total, percent(l.total));
+            out << buf << l.name << std::endl;
+        }
+        return true;
+    }
+
+    // One "root;caller;leaf count" line per distinct stack (flamegraph.pl, speedscope, inferno)
+    bool write_collapsed(const std::string& filename, const SymbolMap& symbols) const {
+        std::map<std::string, uint64_t> lines;
+        for (const auto& s : stacks) {
+            std::vector<std::string> names = stack_names(s.first, symbols);
+            std::string line;
+            for (const std::string& n : names) {
+                line += (line.empty() ? "" : ";") + n;
+            }
+            lines[line] += s.second;
+        }
+
+        std::ofstream out(filename);
+        if (!out.is_open()) return false;
+        for (const auto& l : lines) {
+            out << l.first << " " << l.second << std::endl;
+        }
+        return true;
+    }
+
+    double percent(uint64_t n) const { return samples ? 100.0 * n / samples : 0.0; }
+
+private:
+    struct Frame {
+        uint32_t call_site;
+        uint32_t entry;
+    };
+
+    uint64_t period;
+    bool jitter;
+    std::mt19937 rng;
+    uint64_t next_sample;
+
+    uint32_t current;
+    uint32_t call_site;
+    bool call_pending;
+    bool return_pending;
+    std::vector<Frame> frames;
+
+    uint64_t samples;
+    // Key: outermost call site, callee entries, sampled instruction
+    std::map<std::vector<uint32_t>, uint64_t> stacks;
+
+    uint64_t next_interval() {
+        return jitter ? period / 2 + rng() % period : period;
+    }
+
+    void take_sample() {
+        std::vector<uint32_t> key;
+        key.reserve(frames.size() + 2);
+        if (!frames.empty()) key.push_back(frames[0].call_site);
+        for (const Frame& f : frames) key.push_back(f.entry);
+        key.push_back(current);
+        stacks[key]++;
+        samples++;
+    }
+
+    // Symbol names root first, without repeating a function for its own entry or leaf
+    static std::vector<std::string> stack_names(const std::vector<uint32_t>& key, const SymbolMap& symbols) {
+        std::vector<std::string> names;
+        for (uint32_t addr : key) {
+            std::string n = symbols.name(addr);
+            if (names.empty() || names.back() != n) names.push_back(n);
+        }
+        return names;
+    }
+};
+
+#endif // FX68K_PROFILER_H
@@ -0,0 +1,203 @@
+// MC6840 programmable timer stand-in for the E bus (ebus.h)
+//
+// Three 16 bit timers clocked by E (CRx bit 1 set), timer 3 optionally through the /8 prescaler.
+// Continuous and single shot modes, interrupt flags and the status register behave like the
+// data sheet. External clocks, gate inputs, dual 8 bit mode and the comparison modes are not
+// modelled: a timer in one of those configurations does not count.
+//
+// Registers (RS2-RS0)    write                           read
+//   0                    CR1 (CR2 bit 0 set) or CR3      -
+//   1                    CR2                             status
+//   2, 4, 6              MSB buffer                      timer 1/2/3 counter MSB
+//   3, 5, 7              timer 1/2/3 latch (MSB + LSB)   LSB buffer
+#ifndef FX68K_PTM6840_H
+#define FX68K_PTM6840_H
+
+#include "ebus.h"
+
+class Ptm6840 : public EBusDevice {
+public:
+    static const uint8_t CR_PRESET = 0x01;          // CR1: hold all timers at their latches
+    static const uint8_t CR_SELECT_CR1 = 0x01;      // CR2: register 0 writes CR1
+    static const uint8_t CR_PRESCALE = 0x01;        // CR3: timer 3 counts every 8th E
+    static const uint8_t CR_INTERNAL_CLOCK = 0x02;
+    static const uint8_t CR_DUAL_8BIT = 0x04;
+    static const uint8_t CR_COMPARE = 0x08;         // Frequency/pulse width comparison modes
+    static const uint8_t CR_NO_INIT_ON_LATCH = 0x10;
+    static const uint8_t CR_SINGLE_SHOT = 0x20;
+    static const uint8_t CR_IRQ_ENABLE = 0x40;
+
+    Ptm6840() : msb_buffer(0), lsb_buffer(0), status_read(0), now(0) {
+        for (Timer& t : timers) t = Timer();
+        timers[0].ctrl = CR_PRESET;
+    }
+
+    uint8_t read(unsigned reg, uint64_t e) override {
+        sync(e);
+        if (reg == 1) {
+            status_read = flags();
+            return status();
+        }
+        if (reg >= 2) {
+            unsigned n = (reg - 2) >> 1;
+            if (reg & 1) return lsb_buffer;
+            uint16_t value = counter(n);
+            lsb_buffer = value & 0xFF;
+            // Status read followed by a counter read clears that timer's flag
+            if (status_read & (1 << n)) {
+                timers[n].flag = false;
+                status_read &= ~(1 << n);
+            }
+            return value >> 8;
+        }
+        return 0;
+    }
+
+    void write(unsigned reg, uint8_t data, uint64_t e) override {
+        sync(e);
+        if (reg == 0) {
+            if (timers[1].ctrl & CR_SELECT_CR1) {
+                bool was_preset = preset();
+                set_ctrl(0, data);
+                // Entering preset loads the latches, leaving it starts every timer from them
+                if (was_preset != preset()) {
+                    for (unsigned n = 0; n < 3; n++) initialize(n);
+                }
+            } else {
+                set_ctrl(2, data);
+            }
+        } else if (reg == 1) {
+            set_ctrl(1, data);
+        } else if (reg & 1) {
+            unsigned n = (reg - 2) >> 1;
+            timers[n].latch = (uint16_t(msb_buffer) << 8) | data;
+            if (!(timers[n].ctrl & CR_NO_INIT_ON_LATCH)) initialize(n);
+        } else {
+            msb_buffer = data;
+        }
+    }
+
+    uint64_t next_event() const override {
+        uint64_t next = NEVER;
+        for (unsigned n = 0; n < 3; n++) {
+            const Timer& t = timers[n];
+            if (counting(n) && (t.ctrl & CR_IRQ_ENABLE) && !t.flag && !(t.timeouts && (t.ctrl & CR_SINGLE_SHOT))) {
+                next = std::min(next, next_timeout(n));
+            }
+        }
+        return next;
+    }
+
+    void event(uint64_t e) override { sync(e); }
+
+    bool irq() const override { return status() & 0x80; }
+
+    void state(StateBuffer& s) override {
+        s.io(timers);
+        s.io(msb_buffer);
+        s.io(lsb_buffer);
+        s.io(status_read);
+        s.io(now);
+    }
+
+private:
+    struct Timer {
+        uint8_t ctrl;
+        uint16_t latch;
+        uint16_t start;             // Counter value at base
+        uint64_t base;              // E period the counter was last (re)loaded
+        uint64_t timeouts;          // Since base, already reflected in flag
+        bool flag;
+    };
+
+    Timer timers[3];
+    uint8_t msb_buffer, lsb_buffer;
+    uint8_t status_read;
+    uint64_t now;
+
+    bool preset() const { return timers[0].ctrl & CR_PRESET; }
+
+    bool counting(unsigned n) const {
+        uint8_t c = timers[n].ctrl;
+        return !preset() && (c & CR_INTERNAL_CLOCK) && !(c & CR_DUAL_8BIT) && !(c & CR_COMPARE);
+    }
+
+    unsigned prescale(unsigned n) const {
+        return (n == 2 && (timers[2].ctrl & CR_PRESCALE)) ? 8 : 1;
+    }
+
+    uint8_t flags() const {
+        return (timers[0].flag ? 1 : 0) | (timers[1].flag ? 2 : 0) | (timers[2].flag ? 4 : 0);
+    }
+
+    uint8_t status() const {
+        uint8_t enabled = 0;
+        for (unsigned n = 0; n < 3; n++) {
+            if (timers[n].ctrl & CR_IRQ_ENABLE) enabled |= 1 << n;
+        }
+        uint8_t f = flags();
+        return f | ((f & enabled) ? 0x80 : 0);
+    }
+
+    // Timer clocks since base
+    uint64_t clocks(unsigned n) const {
+        return (now - timers[n].base) / prescale(n);
+    }
+
+    // Counts start..0, then reloads the latch on the next clock: that clock is the timeout
+    uint64_t timeouts_at(unsigned n, uint64_t k) const {
+        const Timer& t = timers[n];
+        if (k <= t.start) return 0;
+        return 1 + (k - t.start - 1) / (uint64_t(t.latch) + 1);
+    }
+
+    uint16_t counter(unsigned n) const {
+        const Timer& t = timers[n];
+        if (!counting(n)) return t.start;
+        uint64_t k = clocks(n);
+        if (k <= t.start) return uint16_t(t.start - k);
+        return uint16_t(t.latch - (k - t.start - 1) % (uint64_t(t.latch) + 1));
+    }
+
+    uint64_t next_timeout(unsigned n) const {
+        const Timer& t = timers[n];
+        uint64_t k = clocks(n);
+        uint64_t period = uint64_t(t.latch) + 1;
+        uint64_t first = uint64_t(t.start) + 1;
+        uint64_t at = (k < first) ? first : first + ((k - first) / period + 1) * period;
+        return t.base + at * prescale(n);
+    }
+
+    // Counter loaded from the latch: latch write, start or end of preset
+    void initialize(unsigned n) {
+        Timer& t = timers[n];
+        t.start = t.latch;
+        t.base = now;
+        t.timeouts = 0;
+        t.flag = false;
+    }
+
+    // Control writes restart the clock count from the current value
+    void set_ctrl(unsigned n, uint8_t data) {
+        Timer& t = timers[n];
+        t.start = counter(n);
+        t.base = now;
+        t.timeouts = 0;
+        t.ctrl = data;
+    }
+
+    void sync(uint64_t e) {
+        now = e;
+        for (unsigned n = 0; n < 3; n++) {
+            Timer& t = timers[n];
+            if (!counting(n)) continue;
+            uint64_t total = timeouts_at(n, clocks(n));
+            if (total > t.timeouts) {
+                if (!(t.ctrl & CR_SINGLE_SHOT) || t.timeouts == 0) t.flag = true;
+                t.timeouts = total;
+            }
+        }
+    }
+};
+
+#endif // FX68K_PTM6840_H
@@ -0,0 +1,82 @@
+// Stimulus replay for fx68k
+//
+// Feeds a recorded stimulus stream (see stimulus.h) straight into a fresh Vfx68k.
+// With --verify the output pins are checked against the signatures in the stream and the
+// exit status is non zero on divergence, which makes it usable as a "git bisect run" script.
+#include "Vfx68k.h"
+#include "verilated.h"
+#include "stimulus.h"
+#include <iostream>
+#include <string>
+#include <chrono>
+
+int main(int argc, char** argv) {
+    Verilated::commandArgs(argc, argv);
+
+    std::string stream;
+    bool verify = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--verify") {
+            verify = true;
+        } else if (arg == "--help" || arg == "-h") {
+            std::cout << "Usage: " << argv[0] << " [--verify] STREAM" << std::endl;
+            return 0;
+        } else if (arg[0] != '+' && arg[0] != '-') {
+            stream = arg;
+        }
+    }
+
+    if (stream.empty()) {
+        std::cerr << "Error: No stimulus stream given" << std::endl;
+        return 2;
+    }
+
+    StimulusPlayer player;
+    std::string error;
+    if (!player.open(stream, error)) {
+        std::cerr << "Error: " << error << std::endl;
+        return 2;
+    }
+
+    std::cout << "Fx68k Stimulus Replay" << std::endl;
+    std::cout << "=====================" << std::endl;
+    std::cout << "Stream: " << stream << std::endl;
+    std::cout << "Verify outputs: " << (verify ? "Yes" : "No") << std::endl;
+    if (verify && !player.interval()) {
+        std::cout << "Warning: stream has no output signatures, nothing to verify" << std::endl;
+    }
+
+    VerilatedContext context;
+    context.commandArgs(argc, argv);    // +microrom=/+nanorom=
+    Vfx68k* cpu = new Vfx68k(&context);
+    cpu->clk = 0;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    ReplayResult result = player.run(cpu, verify);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
+
+    cpu->final();
+    delete cpu;
+
+    double seconds = duration.count() / 1e6;
+    std::cout << "\n=== Replay Summary ===" << std::endl;
+    std::cout << "Clock edges: " << result.edges << " (" << result.edges / 2 << " CPU cycles)" << std::endl;
+    std::cout << "Time: " << seconds << " s" << std::endl;
+    if (seconds > 0) {
+        std::cout << "Speed: " << (result.edges / 2) / seconds / 1e6 << " MHz" << std::endl;
+    }
+    if (verify) {
+        std::cout << "Signatures checked: " << result.signatures_checked << std::endl;
+        if (result.ok) {
+            std::cout << "Outputs match the recording" << std::endl;
+        } else {
+            std::cout << "Outputs diverge in the interval ending at edge " << result.first_mismatch
+                      << " (CPU cycle " << result.first_mismatch / 2 << ")" << std::endl;
+        }
+    }
+
+    return result.ok ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+// Content addressed cache of test case results
+//
+// A case's key hashes everything its result depends on: the RTL sources (rtl/*.sv), the
+// microrom/nanorom images the model loads, the testbench binary itself and the case inputs
+// (vector, program image, seed). A hit hands back the stored result without simulating, so a
+// commit that only touches docs or scripts re-runs nothing, while any change to the RTL, the
+// ROMs or the harness misses everywhere.
+//
+// Results live in <dir>/<suite>.results, one "key seconds result" line per case, appended when
+// the run ends. FX68K_CACHE_DIR selects the directory (default .fx68k_cache) and FX68K_RTL_DIR
+// the RTL sources (default ../../rtl, as seen from sim/verilator). Results are single lines.
+#ifndef FX68K_RESULT_CACHE_H
+#define FX68K_RESULT_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <vector>
+
+// 128 bit FNV-1a, wide enough that a key collision is not a practical concern
+class Hash128 {
+public:
+    Hash128() : h((unsigned __int128)0x6C62272E07BB0142ull << 64 | 0x62B821756295C58Dull) {}
+
+    void update(const void* data, size_t size) {
+        const unsigned __int128 prime = (unsigned __int128)1 << 88 | 0x13B;
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            h = (h ^ p[i]) * prime;
+        }
+    }
+
+    void update(const std::string& s) {
+        update(s.data(), s.size());
+        update("", 1);                          // Keeps "ab"+"c" apart from "a"+"bc"
+    }
+
+    // Contents of a file, or a marker if it cannot be read
+    void update_file(const std::string& path) {
+        update(path);
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            update("<missing>");
+            return;
+        }
+        std::vector<char> buf(1 << 16);
+        while (file.read(buf.data(), buf.size()) || file.gcount() > 0) {
+            update(buf.data(), size_t(file.gcount()));
+        }
+    }
+
+    std::string hex() const {
+        char buf[33];
+        std::snprintf(buf, sizeof(buf), "%016llx%016llx", (unsigned long long)(h >> 64),
+                      (unsigned long long)(uint64_t)h);
+        return buf;
+    }
+
+private:
+    unsigned __int128 h;
+};
+
+class ResultCache {
+public:
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        double seconds_saved;               // Simulation time the hits took when they were stored
+        double seconds_run;                 // Simulation time of the misses
+    };
+
+    Stats stats;
+
+    // force: never hit, simulate everything and refresh the stored results
+    explicit ResultCache(const std::string& suite, bool force = false)
+        : stats(), suite(suite), force(force) {}
+
+    // Hashes the environment and loads the stored results. argv for the ROM plusargs.
+    bool open(int argc, char** argv, std::string& error) {
+        const char* dir_env = std::getenv("FX68K_CACHE_DIR");
+        dir = dir_env ? dir_env : ".fx68k_cache";
+        const char* rtl_env = std::getenv("FX68K_RTL_DIR");
+        std::string rtl = rtl_env ? rtl_env : "../../rtl";
+
+        Hash128 env;
+        env.update(suite);
+        std::vector<std::string> sources;
+        if (DIR* d = opendir(rtl.c_str())) {
+            while (dirent* e = readdir(d)) {
+                std::string name = e->d_name;
+                if (name.size() > 3 && name.compare(name.size() - 3, 3, ".sv") == 0) sources.push_back(name);
+            }
+            closedir(d);
+        }
+        if (sources.empty()) {
+            error = "No RTL sources in " + rtl + " (set FX68K_RTL_DIR)";
+            return false;
+        }
+        std::sort(sources.begin(), sources.end());
+        for (const std::string& name : sources) {
+            env.update_file(rtl + "/" + name);
+        }
+
+        // The ROM files the model reads, as the RTL picks them
+        env.update_file(plusarg(argc, argv, "+microrom=", "microrom.mem"));
+        env.update_file(plusarg(argc, argv, "+nanorom=", "nanorom.mem"));
+        std::string image = plusarg(argc, argv, "+romimage=", "");
+        if (!image.empty()) env.update_file(image);
+
+        env.update_file("/proc/self/exe");
+        environment = env.hex();
+
+        mkdir(dir.c_str(), 0777);
+        path = dir + "/" + suite + ".results";
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t a = line.find(' ');
+            size_t b = (a == std::string::npos) ? a : line.find(' ', a + 1);
+            if (b == std::string::npos) continue;
+            Entry& entry = entries[line.substr(0, a)];
+            entry.seconds = std::atof(line.substr(a + 1, b - a - 1).c_str());
+            entry.result = line.substr(b + 1);
+        }
+        return true;
+    }
+
+    // Key of one case. inputs: everything about the case not already in the binary.
+    std::string key(const std::string& inputs) const {
+        Hash128 h;
+        h.update(environment);
+        h.update(inputs);
+        return h.hex();
+    }
+
+    // Thread safe
+    bool lookup(const std::string& k, std::string& result) {
+        auto it = force ? entries.end() : entries.find(k);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (it == entries.end()) {
+            stats.misses++;
+            return false;
+        }
+        stats.hits++;
+        stats.seconds_saved += it->second.seconds;
+        result = it->second.result;
+        return true;
+    }
+
+    // Thread safe. seconds: simulation time of the case.
+    void store(const std::string& k, const std::string& result, double seconds) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(k + " " + std::to_string(seconds) + " " + result);
+        stats.seconds_run += seconds;
+    }
+
+    // Appends the results stored in this run
+    bool flush(std::string& error) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.empty()) return true;
+        std::ofstream out(path, std::ios::app);
+        for (const std::string& line : pending) {
+            out << line << '\n';
+        }
+        out.close();
+        if (!out) {
+            error = "Could not write " + path;
+            return false;
+        }
+        pending.clear();
+        return true;
+    }
+
+    void print_summary() const {
+        std::cout << "\n=== Result Cache Summary ===" << std::endl;
+        std::cout << "Cache: " << path << (force ? " (--force)" : "") << std::endl;
+        std::cout << "Environment: " << environment << std::endl;
+        std::cout << "Hits: " << stats.hits << ", misses: " << stats.misses << std::endl;
+        std::printf("Simulation time avoided: %.2f s, simulated: %.2f s\n", stats.seconds_saved, stats.seconds_run);
+    }
+
+private:
+    struct Entry {
+        double seconds;
+        std::string result;
+    };
+
+    std::string suite;
+    bool force;
+    std::string dir;
+    std::string path;
+    std::string environment;
+    std::unordered_map<std::string, Entry> entries;     // Read only once open() returns
+    std::vector<std::string> pending;
+    std::mutex mutex;
+
+    static std::string plusarg(int argc, char** argv, const char* prefix, const char* fallback) {
+        size_t n = std::strlen(prefix);
+        for (int i = 1; i < argc; i++) {
+            if (std::strncmp(argv[i], prefix, n) == 0) return argv[i] + n;
+        }
+        return fallback;
+    }
+};
+
+#endif // FX68K_RESULT_CACHE_H
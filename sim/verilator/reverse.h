@@ -0,0 +1,530 @@
+// Reverse execution of a harness: go back to any earlier clock edge of the run
+//
+// ReverseExecution keeps a history of the run it drives, from start() to the latest edge:
+//
+//   - snapshots every interval cycles, in memory: the Verilated model (VerilatedSerialize into
+//     a buffer, so the model must be built with --savable like for checkpoint.h) and the
+//     harness state (Fx68kHarness::state());
+//   - the undo log of guest memory (FlatMemory::undo_log): the old word of every write;
+//   - the inputs from outside the harness: IPL0n-2n, HALTn, BRn and BGACKn when they change,
+//     words written into memory by the host between two edges, bus errors from bus_faults
+//     and the replies of iack_responder.
+//
+// Going back to an edge undoes memory down to the nearest snapshot before it, restores the
+// model and harness from the snapshot and replays the recorded inputs up to the edge. Bus
+// cycles, the E bus and its devices follow from that state, so the replay is exact. The
+// recorded inputs after the new position stay: stepping forward replays them until the latest
+// edge is reached again, and from there the run is live. Writing guest memory from the host
+// while replaying drops them, the run then goes live from there; discard_future() does the
+// same on request.
+//
+// Once the history takes more than budget bytes, the oldest snapshot is dropped with the log
+// before the next one, so at least the last interval stays reachable.
+//
+// Drive the harness through tick()/step_cycle() here after start(). Observers are detached
+// while seeking and reverse_continue() scans. Set insn_observer, bus_faults and iack_responder
+// before start(): they are called through this class, live only. Changing the core behind its
+// back (ArchState setters) needs external_change(), hw.reset() a new start().
+#ifndef FX68K_REVERSE_H
+#define FX68K_REVERSE_H
+
+#include "fx68k_harness.h"
+#include "state_buffer.h"
+#ifdef FX68K_SAVABLE
+#include "verilated_save.h"
+#endif
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#ifdef FX68K_SAVABLE
+// VerilatedSerialize/VerilatedDeserialize on a byte vector instead of a file
+class MemorySave : public VerilatedSerialize {
+public:
+    explicit MemorySave(std::vector<uint8_t>& out) : out(out) {
+        out.clear();
+        m_isOpen = true;
+        header();
+    }
+    ~MemorySave() override { close(); }
+
+    void close() override {
+        if (!isOpen()) return;
+        trailer();
+        flush();
+        m_isOpen = false;
+    }
+
+    void flush() override {
+        out.insert(out.end(), m_bufp, m_cp);
+        m_cp = m_bufp;
+    }
+
+private:
+    std::vector<uint8_t>& out;
+};
+
+class MemoryRestore : public VerilatedDeserialize {
+public:
+    explicit MemoryRestore(const std::vector<uint8_t>& in) : in(in), pos(0) {
+        m_isOpen = true;
+        header();
+    }
+    ~MemoryRestore() override { close(); }
+
+    void close() override {
+        if (!isOpen()) return;
+        trailer();
+        m_isOpen = false;
+    }
+
+private:
+    const std::vector<uint8_t>& in;
+    size_t pos;
+
+    void fill() override {
+        size_t left = m_endp - m_cp;
+        std::memmove(m_bufp, m_cp, left);
+        m_cp = m_bufp;
+        m_endp = m_bufp + left;
+        size_t n = std::min(bufferSize() - left, in.size() - pos);
+        std::memcpy(m_endp, in.data() + pos, n);
+        m_endp += n;
+        pos += n;
+    }
+};
+#endif
+
+class ReverseExecution : public InstructionObserver, public BusFaultSource, public IackResponder {
+public:
+    static const uint64_t DEFAULT_BUDGET = 256ull << 20;      // Bytes
+    static const uint64_t DEFAULT_INTERVAL = 100000;           // Cycles between snapshots
+
+    struct Stats {
+        uint64_t snapshots;             // Taken, including dropped ones
+        uint64_t dropped;               // To stay within the budget
+        uint64_t restores;
+        uint64_t replayed_ticks;        // While seeking and scanning
+    };
+
+    Stats stats;
+    uint64_t last_boundary;             // Position right after the last IRD load, ~0 if none
+    uint32_t boundary_addr;             // Opcode address of that instruction
+
+    ReverseExecution(Fx68kHarness& hw, uint64_t budget = DEFAULT_BUDGET, uint64_t interval_cycles = DEFAULT_INTERVAL)
+        : stats(), last_boundary(~0ull), boundary_addr(0), hw(hw), budget(budget),
+          interval(std::max<uint64_t>(interval_cycles, 1) * 2), active(false), seeking(false), now(0), recorded_end(0),
+          undo_base(0), input_base(0), input_cursor(0), answer_base(0), answer_cursor(0), undo_mark(0),
+          last_pins(0), ahead(0), user_insn(nullptr), user_faults(nullptr), user_iack(nullptr) {}
+
+    ~ReverseExecution() { stop(); }
+
+    // History starts at the current state of the harness, position 0
+    bool start(std::string& error) {
+#ifndef FX68K_SAVABLE
+        error = "Model built without --savable, see build_main";
+        return false;
+#else
+        stop();
+        snapshots.clear();
+        undo.clear();
+        inputs.clear();
+        answers.clear();
+        now = recorded_end = 0;
+        undo_base = input_base = input_cursor = answer_base = answer_cursor = undo_mark = 0;
+        last_boundary = ~0ull;
+        user_insn = hw.insn_observer;
+        user_faults = hw.bus_faults;
+        user_iack = hw.iack_responder;
+        hw.insn_observer = this;
+        hw.bus_faults = this;
+        hw.iack_responder = this;
+        hw.mem.undo_log = &undo;
+        last_pins = pins();
+        active = true;
+        take_snapshot(false);
+        (void)error;
+        return true;
+#endif
+    }
+
+    // Hands the harness back as it is now
+    void stop() {
+        if (!active) return;
+        hw.insn_observer = user_insn;
+        hw.bus_faults = user_faults;
+        hw.iack_responder = user_iack;
+        hw.mem.undo_log = nullptr;
+        active = false;
+    }
+
+    // Clock edges since start(), and the range that can be reached
+    uint64_t position() const { return now; }
+    uint64_t earliest() const { return snapshots.empty() ? 0 : snapshots.front().tick; }
+    uint64_t latest() const { return recorded_end; }
+    bool replaying() const { return now < recorded_end; }
+
+    // One master clock edge forward, replayed or live
+    void tick() {
+        if (!active) {
+            hw.tick();
+            return;
+        }
+        if (undo_total() != undo_mark) host_writes();
+        if (now >= snapshots.back().tick + interval) take_snapshot(false);
+        if (replaying()) {
+            while (input_cursor < input_end() && input(input_cursor).tick == now) apply(input(input_cursor++));
+            undo_mark = undo_total();
+        } else {
+            uint8_t p = pins();
+            if (p != last_pins) {
+                record(Input{ now, 0, p, INPUT_PINS });
+                last_pins = p;
+            }
+        }
+        hw.tick();
+        now++;
+        undo_mark = undo_total();
+        if (now > recorded_end) {
+            recorded_end = now;
+            input_cursor = input_end();
+            answer_cursor = answer_end();
+        } else if (now == recorded_end) {
+            last_pins = pins();
+        }
+        while (ahead < snapshots.size() && snapshots[ahead].tick <= now) {
+            // Replayed up to a state that was changed by hand when it was live
+            if (snapshots[ahead].tick == now && snapshots[ahead].barrier) load(snapshots[ahead]);
+            ahead++;
+        }
+    }
+
+    void step_cycle() {
+        tick();
+        tick();
+    }
+
+    // As Fx68kHarness::run_until()
+    template <class Done>
+    bool run_until(Done done, uint64_t max_cycles) {
+        uint64_t limit = hw.cycles() + max_cycles;
+        while (!done()) {
+            if (hw.cycles() >= limit) return false;
+            step_cycle();
+        }
+        return true;
+    }
+
+    // To any position from earliest() to latest()
+    bool seek(uint64_t target, std::string& error) {
+        if (target < earliest() || target > recorded_end) {
+            error = "position " + std::to_string(target) + " is outside the history ("
+                    + std::to_string(earliest()) + "-" + std::to_string(recorded_end) + ")";
+            return false;
+        }
+        if (target < now) restore(nearest(target));
+        replay_to(target);
+        return true;
+    }
+
+    // Back to the start of the previous instruction. False, at earliest(), if there is none.
+    bool reverse_step(std::string& error) {
+        return reverse_continue([](uint32_t) { return true; }, error);
+    }
+
+    // Back to the latest instruction start before the current position for which
+    // stop(opcode address) is true. False, at earliest(), if there is none.
+    template <class Stop>
+    bool reverse_continue(Stop stop, std::string& error) {
+        if (!active) {
+            error = "no history, call start() first";
+            return false;
+        }
+        if (now == earliest()) return false;
+        uint64_t limit = now - 1;
+        for (size_t k = nearest(limit); ; k--) {
+            // Instruction starts in (snapshot k, limit]
+            uint64_t found = ~0ull;
+            restore(k);
+            replay_to(limit, [&]() {
+                if (last_boundary == now && stop(boundary_addr)) found = now;
+            });
+            if (found != ~0ull) {
+                restore(k);
+                replay_to(found);
+                return true;
+            }
+            if (k == 0) break;
+            limit = snapshots[k].tick;
+        }
+        restore(0);
+        return false;
+    }
+
+    // Drops the recorded inputs after the current position, the run is live from here
+    void discard_future() {
+        if (!replaying()) return;
+        inputs.resize(input_cursor - input_base);
+        answers.resize(answer_cursor - answer_base);
+        while (snapshots.back().tick > now) snapshots.pop_back();
+        ahead = snapshots.size();
+        recorded_end = now;
+        last_pins = pins();
+    }
+
+    // After changing the core by other means than memory and pins: replays from before keep it
+    void external_change() {
+        discard_future();
+        if (snapshots.back().tick == now) snapshots.pop_back();
+        take_snapshot(true);
+    }
+
+    // History size, kept within the budget
+    uint64_t bytes() const {
+        uint64_t n = undo.size() * sizeof(FlatMemory::UndoEntry) + inputs.size() * sizeof(Input)
+                     + answers.size() * sizeof(Answer);
+        for (const Snapshot& s : snapshots) n += s.model.size() + s.harness.size() + sizeof(Snapshot);
+        return n;
+    }
+
+    size_t snapshot_count() const { return snapshots.size(); }
+
+    void instruction(uint32_t addr, uint16_t opcode, uint64_t cycle) override {
+        // Called inside hw.tick(), before now counts the edge
+        last_boundary = now + 1;
+        boundary_addr = addr;
+        if (user_insn && !seeking) user_insn->instruction(addr, opcode, cycle);
+    }
+
+    bool bus_error(const BusCycle& cycle) override {
+        if (replaying()) {
+            if (answer_cursor < answer_end() && answer(answer_cursor).tick == now && !answer(answer_cursor).iack) {
+                answer_cursor++;
+                return true;
+            }
+            return false;
+        }
+        if (!user_faults || !user_faults->bus_error(cycle)) return false;
+        answers.push_back(Answer{ now, false, 0, 0 });
+        return true;
+    }
+
+    IackReply acknowledge(int level, uint8_t& vector) override {
+        if (replaying()) {
+            if (answer_cursor < answer_end() && answer(answer_cursor).tick == now && answer(answer_cursor).iack) {
+                const Answer& a = answer(answer_cursor++);
+                vector = a.vector;
+                return IackReply(a.reply);
+            }
+            return IackReply::AUTOVECTOR;
+        }
+        IackReply reply = user_iack ? user_iack->acknowledge(level, vector) : IackReply::AUTOVECTOR;
+        answers.push_back(Answer{ now, true, uint8_t(reply), vector });
+        return reply;
+    }
+
+private:
+    enum InputKind : uint8_t { INPUT_PINS, INPUT_WRITE };
+
+    struct Input {
+        uint64_t tick;                  // Applied before this edge
+        uint32_t index;                 // Word, for INPUT_WRITE
+        uint16_t value;                 // Pins or the word written
+        InputKind kind;
+    };
+
+    struct Answer {
+        uint64_t tick;
+        bool iack;                      // Else a bus error
+        uint8_t reply;                  // IackReply
+        uint8_t vector;
+    };
+
+    struct Snapshot {
+        uint64_t tick;
+        bool barrier;                   // Taken by external_change()
+        std::vector<uint8_t> model;
+        std::vector<uint8_t> harness;
+        uint64_t undo_pos, input_pos, answer_pos;
+        uint64_t last_boundary;
+        uint32_t boundary_addr;
+    };
+
+    Fx68kHarness& hw;
+    uint64_t budget;
+    uint64_t interval;                  // Clock edges
+    bool active;
+    bool seeking;                       // In replay_to()
+    uint64_t now;
+    uint64_t recorded_end;
+
+    // Positions in the logs are absolute, *_base counts what was dropped from the front
+    std::deque<Snapshot> snapshots;
+    std::deque<FlatMemory::UndoEntry> undo;
+    uint64_t undo_base;
+    std::deque<Input> inputs;
+    uint64_t input_base, input_cursor;
+    std::deque<Answer> answers;
+    uint64_t answer_base, answer_cursor;
+    uint64_t undo_mark;                 // undo_total() after the last edge
+    uint8_t last_pins;
+    size_t ahead;                       // First snapshot after the current position
+
+    InstructionObserver* user_insn;
+    BusFaultSource* user_faults;
+    IackResponder* user_iack;
+
+    uint64_t undo_total() const { return undo_base + undo.size(); }
+    uint64_t input_end() const { return input_base + inputs.size(); }
+    uint64_t answer_end() const { return answer_base + answers.size(); }
+    const Input& input(uint64_t n) const { return inputs[n - input_base]; }
+    const Answer& answer(uint64_t n) const { return answers[n - answer_base]; }
+
+    uint8_t pins() const {
+        const Vfx68k* cpu = hw.cpu;
+        return cpu->IPL0n | (cpu->IPL1n << 1) | (cpu->IPL2n << 2) | (cpu->HALTn << 3) | (cpu->BRn << 4)
+             | (cpu->BGACKn << 5);
+    }
+
+    void apply(const Input& in) {
+        if (in.kind == INPUT_WRITE) {
+            hw.mem.write_word(in.index << 1, in.value);
+            return;
+        }
+        Vfx68k* cpu = hw.cpu;
+        cpu->IPL0n = in.value & 1;
+        cpu->IPL1n = (in.value >> 1) & 1;
+        cpu->IPL2n = (in.value >> 2) & 1;
+        cpu->HALTn = (in.value >> 3) & 1;
+        cpu->BRn = (in.value >> 4) & 1;
+        cpu->BGACKn = (in.value >> 5) & 1;
+    }
+
+    // Inputs are recorded at the live end of the history only
+    void record(const Input& in) {
+        inputs.push_back(in);
+        input_cursor = input_end();
+    }
+
+    // Words the host wrote since the last edge, found in the undo log
+    void host_writes() {
+        discard_future();
+        for (uint64_t n = undo_mark; n < undo_total(); n++) {
+            uint32_t index = undo[n - undo_base].index;
+            record(Input{ now, index, hw.mem.read_word(index << 1), INPUT_WRITE });
+        }
+        undo_mark = undo_total();
+    }
+
+    void take_snapshot(bool barrier) {
+#ifdef FX68K_SAVABLE
+        Snapshot s;
+        s.tick = now;
+        s.barrier = barrier;
+        {
+            MemorySave os(s.model);
+            os << *hw.cpu;
+        }
+        StateBuffer state;
+        hw.state(state);
+        s.harness.swap(state.bytes);
+        s.undo_pos = undo_total();
+        s.input_pos = input_cursor;
+        s.answer_pos = answer_cursor;
+        s.last_boundary = last_boundary;
+        s.boundary_addr = boundary_addr;
+        snapshots.push_back(std::move(s));
+        ahead = snapshots.size();
+        stats.snapshots++;
+        while (snapshots.size() > 1 && bytes() > budget) drop_oldest();
+#else
+        (void)barrier;
+#endif
+    }
+
+    void drop_oldest() {
+        snapshots.pop_front();
+        const Snapshot& s = snapshots.front();
+        undo.erase(undo.begin(), undo.begin() + (s.undo_pos - undo_base));
+        undo_base = s.undo_pos;
+        inputs.erase(inputs.begin(), inputs.begin() + (s.input_pos - input_base));
+        input_base = s.input_pos;
+        answers.erase(answers.begin(), answers.begin() + (s.answer_pos - answer_base));
+        answer_base = s.answer_pos;
+        ahead = snapshots.size();
+        stats.dropped++;
+    }
+
+    // Latest snapshot at or before target
+    size_t nearest(uint64_t target) const {
+        size_t k = snapshots.size() - 1;
+        while (k > 0 && snapshots[k].tick > target) k--;
+        return k;
+    }
+
+    // Model and harness state of a snapshot, memory stays
+    void load(const Snapshot& s) {
+#ifdef FX68K_SAVABLE
+        {
+            MemoryRestore is(s.model);
+            is >> *hw.cpu;
+        }
+        StateBuffer state(s.harness);
+        hw.state(state);
+#else
+        (void)s;
+#endif
+    }
+
+    void restore(size_t k) {
+        const Snapshot& s = snapshots[k];
+        while (undo_total() > s.undo_pos) {
+            hw.mem.undo(undo.back());
+            undo.pop_back();
+        }
+        load(s);
+        now = s.tick;
+        undo_mark = undo_total();
+        input_cursor = s.input_pos;
+        answer_cursor = s.answer_pos;
+        last_boundary = s.last_boundary;
+        boundary_addr = s.boundary_addr;
+        ahead = k + 1;
+        stats.restores++;
+    }
+
+    void replay_to(uint64_t target) {
+        replay_to(target, []() {});
+    }
+
+    // Forward with the observers detached, each() after every edge
+    template <class Each>
+    void replay_to(uint64_t target, Each each) {
+        BusObserver* observer = hw.observer;
+        StimulusRecorder* recorder = hw.recorder;
+        MicroTrace* microtrace = hw.microtrace;
+        ToggleActivity* toggles = hw.toggles;
+        HostChannel* host = hw.host;
+        hw.observer = nullptr;
+        hw.recorder = nullptr;
+        hw.microtrace = nullptr;
+        hw.toggles = nullptr;
+        hw.host = nullptr;
+        seeking = true;
+        stats.replayed_ticks += target - now;
+        while (now < target) {
+            tick();
+            each();
+        }
+        seeking = false;
+        hw.observer = observer;
+        hw.recorder = recorder;
+        hw.microtrace = microtrace;
+        hw.toggles = toggles;
+        hw.host = host;
+    }
+};
+
+#endif // FX68K_REVERSE_H
@@ -0,0 +1,155 @@
+// fx68k microrom/nanorom images for the Verilated model
+//
+// The RTL reads microrom.mem/nanorom.mem with $readmemb at startup (paths selectable with
+// +microrom=/+nanorom=). This class is the faster alternative: the ROMs are parsed once per
+// process from the pre-parsed binary written by scripts/rom_pack.py and copied straight into
+// each model instance. The model is told to skip $readmemb with +fx68k_rom_preload.
+//
+// Binary layout (little endian): "FX68ROM1" u32 micro_depth, u32 nano_depth,
+// micro_depth x u32 microword, nano_depth x 3 x u32 nanoword (bits 0-31, 32-63, 64-67).
+#ifndef FX68K_ROM_IMAGE_H
+#define FX68K_ROM_IMAGE_H
+
+#include "Vfx68k.h"
+#include "Vfx68k___024root.h"
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+static const char ROM_IMAGE_MAGIC[8] = { 'F', 'X', '6', '8', 'R', 'O', 'M', '1' };
+
+class RomImage {
+public:
+    static const uint32_t MICRO_DEPTH = 1024;
+    static const uint32_t NANO_DEPTH = 336;
+
+    std::vector<uint32_t> micro;                // One microword per entry
+    std::vector<uint32_t> nano;                 // Three words per nanoword, low word first
+
+    RomImage() : micro(MICRO_DEPTH, 0), nano(NANO_DEPTH * 3, 0) {}
+
+    bool load_binary(const std::string& filename, std::string& error) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            error = "could not open ROM image " + filename;
+            return false;
+        }
+
+        char magic[8];
+        uint32_t depth[2];
+        file.read(magic, sizeof(magic));
+        file.read(reinterpret_cast<char*>(depth), sizeof(depth));
+        if (!file || std::memcmp(magic, ROM_IMAGE_MAGIC, sizeof(magic)) != 0) {
+            error = filename + " is not an fx68k ROM image";
+            return false;
+        }
+        if (depth[0] != MICRO_DEPTH || depth[1] != NANO_DEPTH) {
+            error = filename + " has unexpected ROM depths";
+            return false;
+        }
+
+        file.read(reinterpret_cast<char*>(micro.data()), micro.size() * 4);
+        file.read(reinterpret_cast<char*>(nano.data()), nano.size() * 4);
+        if (!file) {
+            error = filename + " is truncated";
+            return false;
+        }
+        return true;
+    }
+
+    // The $readmemb text images themselves, parsed as scripts/rom_pack.py does
+    bool load_text(const std::string& micro_file, const std::string& nano_file, std::string& error) {
+        return read_mem(micro_file, MICRO_DEPTH, MICRO_WIDTH, micro, error) &&
+               read_mem(nano_file, NANO_DEPTH, NANO_WIDTH, nano, error);
+    }
+
+    // Images are immutable once loaded, so one copy serves every model in the process
+    static std::shared_ptr<const RomImage> shared(const std::string& filename, std::string& error) {
+        return cached(filename, [&](RomImage& image) { return image.load_binary(filename, error); });
+    }
+
+    static std::shared_ptr<const RomImage> shared_text(const std::string& micro_file, const std::string& nano_file,
+                                                       std::string& error) {
+        return cached(micro_file + "\n" + nano_file,
+                      [&](RomImage& image) { return image.load_text(micro_file, nano_file, error); });
+    }
+
+    // Copy into a model. Call after the first eval(), once the initial blocks have run.
+    void install(Vfx68k* cpu) const {
+        Vfx68k___024root* r = cpu->rootp;
+        for (uint32_t i = 0; i < MICRO_DEPTH; i++) {
+            r->fx68k__DOT__uRom__DOT__uRam[i] = micro[i];
+        }
+        for (uint32_t i = 0; i < NANO_DEPTH; i++) {
+            for (int w = 0; w < 3; w++) {
+                r->fx68k__DOT__nanoRom__DOT__nRam[i][w] = nano[i * 3 + w];
+            }
+        }
+    }
+
+private:
+    static const int MICRO_WIDTH = 17;
+    static const int NANO_WIDTH = 68;
+
+    // One binary number of width digits per line, "//" comments, zero filled to depth.
+    // Entries wider than 32 bits take several words, low word first.
+    static bool read_mem(const std::string& filename, uint32_t depth, int width, std::vector<uint32_t>& out,
+                         std::string& error) {
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            error = "could not open ROM file " + filename;
+            return false;
+        }
+
+        const int stride = (width + 31) / 32;
+        std::fill(out.begin(), out.end(), 0);
+        std::string line;
+        uint32_t entry = 0;
+        for (int number = 1; std::getline(file, line); number++) {
+            line = line.substr(0, line.find("//"));
+            size_t first = line.find_first_not_of(" \t\r");
+            if (first == std::string::npos) continue;
+            line = line.substr(first, line.find_last_not_of(" \t\r") + 1 - first);
+            if (int(line.size()) != width || line.find_first_not_of("01") != std::string::npos) {
+                error = filename + ":" + std::to_string(number) + ": expected " + std::to_string(width) + " binary digits";
+                return false;
+            }
+            if (entry == depth) {
+                error = filename + ": more than " + std::to_string(depth) + " words";
+                return false;
+            }
+            for (int bit = 0; bit < width; bit++) {
+                if (line[width - 1 - bit] == '1') out[entry * stride + bit / 32] |= 1u << (bit % 32);
+            }
+            entry++;
+        }
+        return true;
+    }
+
+    template <class Load>
+    static std::shared_ptr<const RomImage> cached(const std::string& key, Load load) {
+        static std::mutex lock;
+        static std::map<std::string, std::shared_ptr<const RomImage>> cache;
+
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = cache.find(key);
+        if (it != cache.end()) {
+            return it->second;
+        }
+
+        std::shared_ptr<RomImage> image(new RomImage);
+        if (!load(*image)) {
+            return nullptr;
+        }
+        cache[key] = image;
+        return image;
+    }
+};
+
+#endif // FX68K_ROM_IMAGE_H
@@ -0,0 +1,115 @@
+// Multi-suite test runner for fx68k
+//
+// The suite testbenches (tb_fx68k.cpp, test_memory.cpp, test_instructions.cpp,
+// test_interrupt.cpp, test_timing.cpp) linked against one Verilated model, selected at run time
+// by name or glob (suite.h):
+//
+//     fx68k_test_runner --suite main,timing --suite 'inter*' --jobs 8 [suite options]
+//
+// Options the runner does not take itself go to every selected suite, each of which ignores
+// what it doesn't use (--jobs, --seed, --compare ...). Suites run one after another so each has
+// all --jobs workers to itself, and they share the process: the ROMs are parsed once and
+// installed into every harness model from that copy (Fx68kHarness::share_roms) instead of
+// each model running $readmemb.
+#include "fx68k_harness.h"
+#include "suite.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void print_help(const char* prog) {
+    std::cout << "Usage: " << prog << " [options] [suite options]" << std::endl;
+    std::cout << "  --suite NAMES     Comma separated suite names or globs, repeatable (default: all)" << std::endl;
+    std::cout << "  --jobs N          Worker threads for every suite (default: all cores)" << std::endl;
+    std::cout << "  --list            List the suites and exit" << std::endl;
+    std::cout << "Suite options, e.g. --seed or --compare, are passed to every selected suite." << std::endl;
+}
+
+static void list_suites() {
+    for (const Suite& s : SuiteRegistry::all()) {
+        std::printf("  %-14s %s\n", s.name, s.description);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> patterns;
+    std::vector<std::string> forwarded;
+    unsigned jobs = std::thread::hardware_concurrency();
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--suite" && i + 1 < argc) {
+            std::string list = argv[++i];
+            for (size_t start = 0; start <= list.size();) {
+                size_t comma = list.find(',', start);
+                if (comma == std::string::npos) comma = list.size();
+                if (comma > start) patterns.push_back(list.substr(start, comma - start));
+                start = comma + 1;
+            }
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            jobs = std::stoul(argv[++i]);
+        } else if (arg == "--list") {
+            list_suites();
+            return 0;
+        } else if (arg == "--help" || arg == "-h") {
+            print_help(argv[0]);
+            std::cout << "Suites:" << std::endl;
+            list_suites();
+            return 0;
+        } else {
+            forwarded.push_back(arg);
+        }
+    }
+    if (jobs == 0) jobs = 1;
+    if (patterns.empty()) patterns.push_back("*");
+
+    std::vector<Suite> selected;
+    for (const std::string& p : patterns) {
+        if (!SuiteRegistry::select(p, selected)) {
+            std::cerr << "Error: no suite matches " << p << " (--list shows them)" << std::endl;
+            return 2;
+        }
+    }
+
+    Fx68kHarness::share_roms(true);
+
+    std::cout << "Fx68k Test Runner" << std::endl;
+    std::cout << "=================" << std::endl;
+    std::cout << "Suites:";
+    for (const Suite& s : selected) std::cout << " " << s.name;
+    std::cout << ", workers: " << jobs << std::endl;
+
+    struct Outcome {
+        const char* name;
+        int status;
+        double seconds;
+    };
+    std::vector<Outcome> outcomes;
+    const std::string jobs_arg = std::to_string(jobs);
+    for (const Suite& s : selected) {
+        std::cout << "\n--- " << s.name << " ---" << std::endl;
+
+        // Each suite parses its own argv, named after it for its usage line
+        std::string prog = std::string(argv[0]) + " " + s.name;
+        std::vector<char*> args = { &prog[0], const_cast<char*>("--jobs"), const_cast<char*>(jobs_arg.c_str()) };
+        for (std::string& f : forwarded) args.push_back(&f[0]);
+        args.push_back(nullptr);
+
+        auto start_time = std::chrono::steady_clock::now();
+        int status = s.entry(int(args.size()) - 1, args.data());
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+        outcomes.push_back(Outcome{ s.name, status, elapsed.count() });
+    }
+
+    int failed = 0;
+    std::cout << "\n=== Test Runner Summary ===" << std::endl;
+    for (const Outcome& o : outcomes) {
+        std::printf("  %-14s %s  %.2f s\n", o.name, o.status ? "FAIL" : "PASS", o.seconds);
+        if (o.status) failed++;
+    }
+    std::cout << "Passed: " << (outcomes.size() - failed) << ", failed: " << failed << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,146 @@
+// Guest to host calls for the fx68k harness: exit status, console output, benchmark markers
+//
+// The guest writes 32 bit registers in a reserved block, the top page of the address space by
+// default, so they are reachable as (xxx).W:
+//   +$00  EXIT   Status. The guest is finished; exited() turns true.
+//   +$04  PUTC   Low byte goes to the console, and to stdout while echo is set.
+//   +$08  MARK   Non zero starts the benchmark region, zero ends it.
+//   +$0C  CALL   Call number 0-2 runs EXIT/PUTC/MARK with ARG as the value.
+//   +$10  ARG
+// A register acts on the write of its last byte, so MOVE.L to +0, MOVE.W to +2 and MOVE.B to
+// +3 all work. The writes also land in memory. install_trap() puts a TRAP #n handler in the
+// block that passes D0 (call number) and D1 (value) through CALL/ARG, for guests that would
+// rather not know the address.
+//
+// A test then runs until the guest says it is done:
+//     hw.run_until([&] { return semihost.exited(); }, MAX_CYCLES);
+#ifndef FX68K_SEMIHOST_H
+#define FX68K_SEMIHOST_H
+
+#include "fx68k_harness.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+class Semihost : public HostChannel {
+public:
+    static const uint32_t DEFAULT_BASE = 0x00FFF000;
+    static const uint32_t EXIT = 0x00, PUTC = 0x04, MARK = 0x08, CALL = 0x0C, ARG = 0x10;
+    static const uint32_t REGS_SIZE = 0x14;
+    static const uint32_t TRAP_HANDLER = 0x100;         // Offset of install_trap()'s handler
+
+    struct Stats {
+        uint64_t regions;               // Completed benchmark regions
+        uint64_t region_cycles;
+        double region_seconds;          // Host time spent simulating them
+    };
+
+    bool echo;                          // Console output to stdout as well
+    uint32_t status;
+    uint64_t exit_cycle;
+    std::string console;
+    Stats stats;
+
+    explicit Semihost(uint32_t base = DEFAULT_BASE) : HostChannel(base & ~3u, REGS_SIZE), echo(true) {
+        reset();
+    }
+
+    // Before every run of the guest
+    void reset() {
+        done = false;
+        status = 0;
+        exit_cycle = 0;
+        console.clear();
+        stats = Stats();
+        in_region = false;
+        region_start = 0;
+        for (uint32_t& h : high) h = 0;
+        arg = 0;
+    }
+
+    bool exited() const { return done; }
+
+    // TRAP #trap calls the host: D0 call number, D1 value, everything else preserved
+    void install_trap(FlatMemory& mem, unsigned trap) const {
+        uint32_t handler = base + TRAP_HANDLER;
+        mem.write_long((32 + (trap & 15)) * 4, handler);
+        mem.load(handler, {
+            0x23C1, uint16_t((base + ARG) >> 16), uint16_t(base + ARG),     // MOVE.L D1,ARG.L
+            0x23C0, uint16_t((base + CALL) >> 16), uint16_t(base + CALL),   // MOVE.L D0,CALL.L
+            0x4E73,                                                         // RTE
+        });
+    }
+
+    void host_write(const BusCycle& cycle) override {
+        uint32_t offset = cycle.addr - base;
+        unsigned reg = offset >> 2;
+        if (!(offset & 2)) {
+            high[reg] = cycle.data;
+            return;
+        }
+        if (!cycle.lower) return;
+        uint32_t value = (high[reg] << 16) | (cycle.upper ? (cycle.data & 0xFF00) : 0) | (cycle.data & 0xFF);
+        high[reg] = 0;
+        if (offset - 2 == ARG) {
+            arg = value;
+        } else if (offset - 2 == CALL) {
+            if (value <= 2) call(value * 4, arg, cycle.end_cycle);
+        } else {
+            call(offset - 2, value, cycle.end_cycle);
+        }
+    }
+
+    void print_summary() const {
+        std::cout << "\n=== Semihost Summary ===" << std::endl;
+        if (done) {
+            std::cout << "Guest exit status: " << status << " (cycle " << exit_cycle << ")" << std::endl;
+        } else {
+            std::cout << "Guest did not exit" << std::endl;
+        }
+        std::cout << "Console: " << console.size() << " bytes" << std::endl;
+        if (stats.regions) {
+            std::printf("Benchmark regions: %llu, %llu cycles, %.3f s, %.2f MHz\n", (unsigned long long)stats.regions,
+                        (unsigned long long)stats.region_cycles, stats.region_seconds,
+                        stats.region_seconds > 0 ? stats.region_cycles / stats.region_seconds / 1e6 : 0.0);
+        }
+    }
+
+private:
+    bool done;
+    bool in_region;
+    uint64_t region_start;
+    std::chrono::high_resolution_clock::time_point region_time;
+    uint32_t high[REGS_SIZE / 4];       // Upper word of each register, written first
+    uint32_t arg;
+
+    void call(uint32_t reg, uint32_t value, uint64_t cycle) {
+        if (reg == EXIT) {
+            done = true;
+            status = value;
+            exit_cycle = cycle;
+        } else if (reg == PUTC) {
+            char c = char(value & 0xFF);
+            console += c;
+            if (echo) {
+                std::cout.put(c);
+                if (c == '\n') std::cout.flush();
+            }
+        } else if (reg == MARK) {
+            auto now = std::chrono::high_resolution_clock::now();
+            if (value && !in_region) {
+                in_region = true;
+                region_start = cycle;
+                region_time = now;
+            } else if (!value && in_region) {
+                in_region = false;
+                stats.regions++;
+                stats.region_cycles += cycle - region_start;
+                stats.region_seconds += std::chrono::duration<double>(now - region_time).count();
+            }
+        }
+    }
+};
+
+#endif // FX68K_SEMIHOST_H
@@ -0,0 +1,58 @@
+// Plain state serialization for checkpoints (checkpoint.h)
+//
+// A class lists its fields once, in a state() function that both saves and restores:
+//
+//     void state(StateBuffer& s) { s.io(counter); s.io(flags); }
+//
+// Only trivially copyable fields go through io(). Pointers are saved as indexes by their
+// owner. The format is the host's memory layout, so a checkpoint is only read back by the
+// same build on the same host.
+#ifndef FX68K_STATE_BUFFER_H
+#define FX68K_STATE_BUFFER_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class StateBuffer {
+public:
+    std::vector<uint8_t> bytes;
+
+    // Saving
+    StateBuffer() : loading(false), pos(0), overrun(false) {}
+
+    // Restoring from bytes
+    explicit StateBuffer(std::vector<uint8_t> data)
+        : bytes(std::move(data)), loading(true), pos(0), overrun(false) {}
+
+    bool restoring() const { return loading; }
+
+    // Restored exactly what was saved
+    bool ok() const { return !overrun && (!loading || pos == bytes.size()); }
+
+    template <class T>
+    void io(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "StateBuffer::io takes plain fields");
+        if (loading) {
+            if (pos + sizeof(T) > bytes.size()) {
+                overrun = true;
+                return;
+            }
+            std::memcpy(&value, &bytes[pos], sizeof(T));
+            pos += sizeof(T);
+        } else {
+            size_t n = bytes.size();
+            bytes.resize(n + sizeof(T));
+            std::memcpy(&bytes[n], &value, sizeof(T));
+        }
+    }
+
+private:
+    bool loading;
+    size_t pos;
+    bool overrun;
+};
+
+#endif // FX68K_STATE_BUFFER_H
@@ -0,0 +1,348 @@
+// Cycle exact stimulus recording and replay for fx68k
+//
+// The recorder logs every input pin the harness drives, once per master clock edge, as a
+// change-only run length stream. The player feeds that stream straight back into Vfx68k:
+// no memory model, no scheduler, just pins and eval().
+//
+// Stream layout (little endian):
+//   header:  "FX68STIM" u32 version, u32 start_phase, u32 signature_interval
+//   records: varint hold, u8 tag, [u16 pins] [u16 iEdb] [u32 signature]
+// "hold" is the number of clock edges since the previous record. A record applies from that
+// edge on. Signature records carry a hash of the output pins over the last interval, so a
+// replay against a different RTL revision reports the first interval where the core diverges.
+#ifndef FX68K_STIMULUS_H
+#define FX68K_STIMULUS_H
+
+#include "Vfx68k.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+static const char STIMULUS_MAGIC[8] = { 'F', 'X', '6', '8', 'S', 'T', 'I', 'M' };
+static const uint32_t STIMULUS_VERSION = 1;
+
+static const uint8_t STIM_TAG_PINS = 0x01;
+static const uint8_t STIM_TAG_EDB = 0x02;
+static const uint8_t STIM_TAG_SIGNATURE = 0x04;
+static const uint8_t STIM_TAG_END = 0x80;
+
+// Control inputs packed into one word
+enum StimulusPin {
+    PIN_DTACKn = 0,
+    PIN_VPAn,
+    PIN_BERRn,
+    PIN_IPL0n,
+    PIN_IPL1n,
+    PIN_IPL2n,
+    PIN_BRn,
+    PIN_BGACKn,
+    PIN_HALTn,
+    PIN_extReset,
+    PIN_pwrUp
+};
+
+inline uint16_t pack_input_pins(const Vfx68k& cpu) {
+    return (cpu.DTACKn << PIN_DTACKn) | (cpu.VPAn << PIN_VPAn) | (cpu.BERRn << PIN_BERRn)
+         | (cpu.IPL0n << PIN_IPL0n) | (cpu.IPL1n << PIN_IPL1n) | (cpu.IPL2n << PIN_IPL2n)
+         | (cpu.BRn << PIN_BRn) | (cpu.BGACKn << PIN_BGACKn) | (cpu.HALTn << PIN_HALTn)
+         | (cpu.extReset << PIN_extReset) | (cpu.pwrUp << PIN_pwrUp);
+}
+
+inline void unpack_input_pins(Vfx68k& cpu, uint16_t pins) {
+    cpu.DTACKn = (pins >> PIN_DTACKn) & 1;
+    cpu.VPAn = (pins >> PIN_VPAn) & 1;
+    cpu.BERRn = (pins >> PIN_BERRn) & 1;
+    cpu.IPL0n = (pins >> PIN_IPL0n) & 1;
+    cpu.IPL1n = (pins >> PIN_IPL1n) & 1;
+    cpu.IPL2n = (pins >> PIN_IPL2n) & 1;
+    cpu.BRn = (pins >> PIN_BRn) & 1;
+    cpu.BGACKn = (pins >> PIN_BGACKn) & 1;
+    cpu.HALTn = (pins >> PIN_HALTn) & 1;
+    cpu.extReset = (pins >> PIN_extReset) & 1;
+    cpu.pwrUp = (pins >> PIN_pwrUp) & 1;
+}
+
+// FNV-1a fold of the output pins after a clock edge
+inline uint32_t fold_output_pins(uint32_t hash, const Vfx68k& cpu) {
+    uint32_t ctrl = cpu.ASn | (cpu.UDSn << 1) | (cpu.LDSn << 2) | (cpu.eRWn << 3)
+                  | (cpu.FC0 << 4) | (cpu.FC1 << 5) | (cpu.FC2 << 6) | (cpu.E << 7)
+                  | (cpu.VMAn << 8) | (cpu.BGn << 9) | (cpu.oRESETn << 10) | (cpu.oHALTEDn << 11);
+    uint32_t words[3] = { ctrl, uint32_t(cpu.eab), uint32_t(cpu.eRWn ? 0 : cpu.oEdb) };
+    for (uint32_t w : words) {
+        hash = (hash ^ w) * 16777619u;
+    }
+    return hash;
+}
+
+static const uint32_t SIGNATURE_SEED = 2166136261u;
+
+class StimulusRecorder {
+private:
+    FILE* file;
+    std::vector<uint8_t> buffer;
+    uint32_t signature_interval;
+    uint64_t now;                   // Clock edges recorded so far
+    uint64_t last_record;
+    uint16_t last_pins;
+    uint16_t last_edb;
+    uint32_t signature;
+    bool started;
+
+    void put8(uint8_t v) {
+        buffer.push_back(v);
+    }
+
+    void put16(uint16_t v) {
+        put8(v & 0xFF);
+        put8(v >> 8);
+    }
+
+    void put32(uint32_t v) {
+        put16(v & 0xFFFF);
+        put16(v >> 16);
+    }
+
+    void put_varint(uint64_t v) {
+        while (v >= 0x80) {
+            put8(uint8_t(v) | 0x80);
+            v >>= 7;
+        }
+        put8(uint8_t(v));
+    }
+
+    void begin_record(uint8_t tag) {
+        put_varint(now - last_record);
+        put8(tag);
+        last_record = now;
+    }
+
+    void flush() {
+        if (!buffer.empty()) {
+            std::fwrite(buffer.data(), 1, buffer.size(), file);
+            buffer.clear();
+        }
+    }
+
+public:
+    StimulusRecorder() : file(nullptr), signature_interval(0), now(0), last_record(0),
+                         last_pins(0), last_edb(0), signature(SIGNATURE_SEED), started(false) {}
+
+    ~StimulusRecorder() {
+        close();
+    }
+
+    bool open(const std::string& filename, uint32_t interval = 4096) {
+        file = std::fopen(filename.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        signature_interval = interval;
+        buffer.reserve(1 << 16);
+        return true;
+    }
+
+    bool is_open() const { return file != nullptr; }
+
+    uint64_t edges() const { return now; }
+
+    // Before the rising clock edge, once the harness has driven all inputs
+    void sample(const Vfx68k& cpu) {
+        uint16_t pins = pack_input_pins(cpu);
+        uint16_t edb = cpu.iEdb;
+
+        if (!started) {
+            std::fwrite(STIMULUS_MAGIC, 1, sizeof(STIMULUS_MAGIC), file);
+            uint32_t header[3] = { STIMULUS_VERSION, uint32_t(cpu.enPhi1 ? 0 : 1), signature_interval };
+            for (uint32_t h : header) put32(h);
+            begin_record(STIM_TAG_PINS | STIM_TAG_EDB);
+            put16(pins);
+            put16(edb);
+            started = true;
+        } else if (pins != last_pins || edb != last_edb) {
+            uint8_t tag = (pins != last_pins ? STIM_TAG_PINS : 0) | (edb != last_edb ? STIM_TAG_EDB : 0);
+            begin_record(tag);
+            if (tag & STIM_TAG_PINS) put16(pins);
+            if (tag & STIM_TAG_EDB) put16(edb);
+        }
+        last_pins = pins;
+        last_edb = edb;
+    }
+
+    // After the clock edge has been evaluated
+    void outputs(const Vfx68k& cpu) {
+        now++;
+        if (signature_interval) {
+            signature = fold_output_pins(signature, cpu);
+            if (now % signature_interval == 0) {
+                begin_record(STIM_TAG_SIGNATURE);
+                put32(signature);
+                signature = SIGNATURE_SEED;
+            }
+        }
+        if (buffer.size() >= (1 << 16)) {
+            flush();
+        }
+    }
+
+    void close() {
+        if (!file) {
+            return;
+        }
+        if (started) {
+            begin_record(STIM_TAG_END);
+        }
+        flush();
+        std::fclose(file);
+        file = nullptr;
+    }
+};
+
+struct ReplayResult {
+    bool ok;
+    uint64_t edges;
+    uint64_t signatures_checked;
+    uint64_t first_mismatch;        // Edge at the end of the first diverging interval, 0 if none
+    std::string error;
+};
+
+class StimulusPlayer {
+private:
+    std::vector<uint8_t> data;
+    size_t pos;
+    uint32_t start_phase;
+    uint32_t signature_interval;
+
+    uint8_t get8() {
+        return pos < data.size() ? data[pos++] : STIM_TAG_END;
+    }
+
+    uint16_t get16() {
+        uint16_t lo = get8();
+        return lo | (uint16_t(get8()) << 8);
+    }
+
+    uint32_t get32() {
+        uint32_t lo = get16();
+        return lo | (uint32_t(get16()) << 16);
+    }
+
+    uint64_t get_varint() {
+        uint64_t v = 0;
+        int shift = 0;
+        uint8_t b;
+        do {
+            b = get8();
+            v |= uint64_t(b & 0x7F) << shift;
+            shift += 7;
+        } while ((b & 0x80) && shift < 64);
+        return v;
+    }
+
+public:
+    StimulusPlayer() : pos(0), start_phase(0), signature_interval(0) {}
+
+    bool open(const std::string& filename, std::string& error) {
+        FILE* file = std::fopen(filename.c_str(), "rb");
+        if (!file) {
+            error = "could not open " + filename;
+            return false;
+        }
+        std::fseek(file, 0, SEEK_END);
+        long size = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+        data.resize(size > 0 ? size : 0);
+        size_t got = std::fread(data.data(), 1, data.size(), file);
+        std::fclose(file);
+
+        if (got != data.size() || data.size() < sizeof(STIMULUS_MAGIC) + 12
+            || std::memcmp(data.data(), STIMULUS_MAGIC, sizeof(STIMULUS_MAGIC)) != 0) {
+            error = filename + " is not a stimulus stream";
+            return false;
+        }
+        pos = sizeof(STIMULUS_MAGIC);
+        uint32_t version = get32();
+        if (version != STIMULUS_VERSION) {
+            error = "unsupported stimulus version " + std::to_string(version);
+            return false;
+        }
+        start_phase = get32();
+        signature_interval = get32();
+        return true;
+    }
+
+    uint32_t interval() const { return signature_interval; }
+
+    // Input pin words with the clock edge each applies from, without running a model. For
+    // tools that rebuild the stimulus at a higher level (minimize.cpp).
+    std::vector<std::pair<uint64_t, uint16_t>> pin_changes() {
+        std::vector<std::pair<uint64_t, uint16_t>> changes;
+        size_t start = pos;
+        uint64_t now = 0;
+        for (;;) {
+            now += get_varint();
+            uint8_t tag = get8();
+            if (tag & STIM_TAG_END) break;
+            if (tag & STIM_TAG_PINS) changes.push_back(std::make_pair(now, get16()));
+            if (tag & STIM_TAG_EDB) get16();
+            if (tag & STIM_TAG_SIGNATURE) get32();
+        }
+        pos = start;
+        return changes;
+    }
+
+    // Replays the whole stream. With verify set, output signatures are recomputed and compared.
+    ReplayResult run(Vfx68k* cpu, bool verify) {
+        ReplayResult result = ReplayResult();
+        result.ok = true;
+
+        int phase = start_phase;
+        uint64_t now = 0;
+        uint32_t signature = SIGNATURE_SEED;
+        bool fold = verify && signature_interval;
+
+        for (;;) {
+            uint64_t hold = get_varint();
+            uint8_t tag = get8();
+
+            for (uint64_t until = now + hold; now < until; now++) {
+                cpu->enPhi1 = (phase == 0);
+                cpu->enPhi2 = (phase == 1);
+                cpu->clk = 1;
+                cpu->eval();
+                if (fold) signature = fold_output_pins(signature, *cpu);
+                cpu->clk = 0;
+                cpu->eval();
+                phase ^= 1;
+            }
+
+            if (tag & STIM_TAG_END) {
+                break;
+            }
+            if (tag & STIM_TAG_PINS) {
+                unpack_input_pins(*cpu, get16());
+            }
+            if (tag & STIM_TAG_EDB) {
+                cpu->iEdb = get16();
+            }
+            if (tag & STIM_TAG_SIGNATURE) {
+                uint32_t expected = get32();
+                if (fold) {
+                    result.signatures_checked++;
+                    if (expected != signature && result.ok) {
+                        result.ok = false;
+                        result.first_mismatch = now;
+                    }
+                    signature = SIGNATURE_SEED;
+                }
+            }
+        }
+
+        result.edges = now;
+        return result;
+    }
+};
+
+#endif // FX68K_STIMULUS_H
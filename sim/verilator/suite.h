@@ -0,0 +1,66 @@
+// Test suite registry for the multi-suite runner
+//
+// A suite testbench ends with FX68K_SUITE(name, description, entry), entry being its
+// int(int argc, char** argv) main. Built on its own that defines main(). Built with
+// -DFX68K_SUITE_RUNNER into fx68k_test_runner (runner.cpp) it registers the entry instead, so
+// the suites share one link of the model and one process.
+#ifndef FX68K_SUITE_H
+#define FX68K_SUITE_H
+
+#include <algorithm>
+#include <cstring>
+#include <fnmatch.h>
+#include <string>
+#include <vector>
+
+struct Suite {
+    const char* name;
+    const char* description;
+    int (*entry)(int argc, char** argv);
+};
+
+class SuiteRegistry {
+public:
+    struct Add {
+        explicit Add(const Suite& suite) { suites().push_back(suite); }
+    };
+
+    // By name, registration order depends on the link
+    static std::vector<Suite> all() {
+        std::vector<Suite> sorted = suites();
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const Suite& a, const Suite& b) { return std::strcmp(a.name, b.name) < 0; });
+        return sorted;
+    }
+
+    // Suites matching a name or glob, appended to selected unless already there.
+    // False if nothing matches.
+    static bool select(const std::string& pattern, std::vector<Suite>& selected) {
+        bool found = false;
+        for (const Suite& s : all()) {
+            if (fnmatch(pattern.c_str(), s.name, 0) != 0) continue;
+            found = true;
+            auto same = [&](const Suite& t) { return t.entry == s.entry; };
+            if (std::find_if(selected.begin(), selected.end(), same) == selected.end()) {
+                selected.push_back(s);
+            }
+        }
+        return found;
+    }
+
+private:
+    static std::vector<Suite>& suites() {
+        static std::vector<Suite> registered;
+        return registered;
+    }
+};
+
+#ifdef FX68K_SUITE_RUNNER
+#define FX68K_SUITE(name, description, entry) \
+    static SuiteRegistry::Add entry##_registration(Suite{ name, description, entry });
+#else
+#define FX68K_SUITE(name, description, entry) \
+    int main(int argc, char** argv) { return entry(argc, argv); }
+#endif
+
+#endif // FX68K_SUITE_H
@@ -0,0 +1,267 @@
+// Live telemetry for long fx68k runs
+//
+// A process run with +telemetry publishes a shared memory segment /dev/shm/fx68k.<pid> that
+// fx68k_top reads while the simulation runs. Off by default: a publishing harness also counts
+// instructions, which costs a check on every clock edge. Each harness instance owns one slot and
+// refreshes it with relaxed atomic stores every TELEMETRY_TICKS clock edges; nothing in the
+// segment is ever locked. A slot is freed when its harness goes away, its counts folded into
+// the process totals, and reused by the next harness. The current test name is the only multi
+// word field and is guarded by a sequence counter, so readers retry instead of blocking the writer.
+//
+// Layout changes bump TELEMETRY_VERSION; fx68k_top skips segments it does not understand.
+#ifndef FX68K_TELEMETRY_H
+#define FX68K_TELEMETRY_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static const uint32_t TELEMETRY_MAGIC = 0x46583654;     // "FX6T"
+static const uint32_t TELEMETRY_VERSION = 2;
+static const uint32_t TELEMETRY_SLOTS = 64;
+static const uint64_t TELEMETRY_TICKS = 1 << 16;       // Clock edges between slot updates
+static const char TELEMETRY_PREFIX[] = "fx68k.";
+
+// TelemetrySlot::in_use
+static const uint32_t TELEMETRY_SLOT_FREE = 0;
+static const uint32_t TELEMETRY_SLOT_LIVE = 1;
+static const uint32_t TELEMETRY_SLOT_CLAIMING = 2;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "telemetry needs lock free 64 bit atomics");
+
+struct TelemetrySlot {
+    std::atomic<uint32_t> in_use;
+    std::atomic<uint32_t> reserved;
+    std::atomic<uint64_t> cycles;                   // Since the harness was created, across resets
+    std::atomic<uint64_t> instructions;
+    std::atomic<uint64_t> cycles_per_second;        // Over the last update interval
+    std::atomic<uint64_t> bus_reads;
+    std::atomic<uint64_t> bus_writes;
+    std::atomic<uint64_t> bus_iack;
+    std::atomic<uint64_t> last_vector;              // 0xFFFFFFFF until the first vector fetch
+    std::atomic<uint64_t> updated_ns;               // steady_clock time of the last update
+};
+
+struct TelemetryBlock {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t pid;
+    uint32_t slot_count;
+    char program[64];
+    std::atomic<uint64_t> start_ns;
+    std::atomic<uint32_t> slots_claimed;           // Highest slot index ever claimed, plus one
+    std::atomic<uint32_t> test_id;
+    std::atomic<uint32_t> test_seq;                 // Odd while test_name is being written
+    char test_name[60];
+    std::atomic<uint64_t> retired_cycles;           // Of the slots freed so far
+    std::atomic<uint64_t> retired_instructions;
+    std::atomic<uint64_t> retired_reads;
+    std::atomic<uint64_t> retired_writes;
+    std::atomic<uint64_t> retired_iack;
+    TelemetrySlot slots[TELEMETRY_SLOTS];
+};
+
+inline uint64_t telemetry_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Reads the test name written under test_seq. False if the writer kept it busy.
+inline bool telemetry_read_test(const TelemetryBlock* block, uint32_t& id, std::string& name) {
+    for (int attempt = 0; attempt < 16; attempt++) {
+        uint32_t seq = block->test_seq.load(std::memory_order_acquire);
+        if (seq & 1) continue;
+        char buf[sizeof(block->test_name)];
+        std::memcpy(buf, block->test_name, sizeof(buf));
+        id = block->test_id.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (block->test_seq.load(std::memory_order_relaxed) == seq) {
+            name.assign(buf, strnlen(buf, sizeof(buf)));
+            return true;
+        }
+    }
+    return false;
+}
+
+// The segment of this process, created on first use and removed at exit
+class Telemetry {
+public:
+    static Telemetry& process() {
+        static Telemetry instance;
+        return instance;
+    }
+
+    bool active() const { return block != nullptr; }
+
+    // The first free slot, nullptr while all TELEMETRY_SLOTS are live. The first claim creates
+    // the segment.
+    TelemetrySlot* claim_slot() {
+        if (!open()) return nullptr;
+        for (uint32_t index = 0; index < TELEMETRY_SLOTS; index++) {
+            TelemetrySlot* slot = &block->slots[index];
+            uint32_t state = TELEMETRY_SLOT_FREE;
+            if (!slot->in_use.compare_exchange_strong(state, TELEMETRY_SLOT_CLAIMING, std::memory_order_acquire)) {
+                continue;
+            }
+            slot->last_vector.store(0xFFFFFFFF, std::memory_order_relaxed);
+            slot->updated_ns.store(telemetry_now_ns(), std::memory_order_relaxed);
+            uint32_t claimed = block->slots_claimed.load(std::memory_order_relaxed);
+            while (claimed <= index
+                   && !block->slots_claimed.compare_exchange_weak(claimed, index + 1, std::memory_order_relaxed)) {
+            }
+            slot->in_use.store(TELEMETRY_SLOT_LIVE, std::memory_order_release);
+            return slot;
+        }
+        return nullptr;
+    }
+
+    // Moves the counts of a slot whose harness is done into the process totals and frees it
+    void release_slot(TelemetrySlot* slot) {
+        std::atomic<uint64_t>* counts[][2] = {
+            { &slot->cycles, &block->retired_cycles },
+            { &slot->instructions, &block->retired_instructions },
+            { &slot->bus_reads, &block->retired_reads },
+            { &slot->bus_writes, &block->retired_writes },
+            { &slot->bus_iack, &block->retired_iack },
+        };
+        for (auto& c : counts) {
+            c[1]->fetch_add(c[0]->exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        slot->cycles_per_second.store(0, std::memory_order_relaxed);
+        slot->in_use.store(TELEMETRY_SLOT_FREE, std::memory_order_release);
+    }
+
+    // Single writer at a time; readers never wait on this. Kept for the segment until it exists.
+    void set_test(uint32_t id, const std::string& name) {
+        std::lock_guard<std::mutex> guard(writer);
+        test_id = id;
+        test_name = name;
+        if (block) write_test();
+    }
+
+private:
+    TelemetryBlock* block;
+    std::string shm_name;
+    std::mutex writer;
+    bool opened;
+    uint32_t test_id;
+    std::string test_name;
+
+    Telemetry() : block(nullptr), opened(false), test_id(0) {}
+
+    ~Telemetry() {
+        if (block) {
+            munmap(block, sizeof(TelemetryBlock));
+            shm_unlink(shm_name.c_str());
+        }
+    }
+
+    // Under writer
+    void write_test() {
+        const std::string& name = test_name;
+        uint32_t id = test_id;
+        uint32_t seq = block->test_seq.load(std::memory_order_relaxed);
+        block->test_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memset(block->test_name, 0, sizeof(block->test_name));
+        std::memcpy(block->test_name, name.data(), std::min(name.size(), sizeof(block->test_name) - 1));
+        block->test_id.store(id, std::memory_order_relaxed);
+        block->test_seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // Creates the segment once; false if that failed
+    bool open() {
+        std::lock_guard<std::mutex> guard(writer);
+        if (opened) return block != nullptr;
+        opened = true;
+        shm_name = "/" + std::string(TELEMETRY_PREFIX) + std::to_string(getpid());
+        int fd = shm_open(shm_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        if (ftruncate(fd, sizeof(TelemetryBlock)) == 0) {
+            void* p = mmap(nullptr, sizeof(TelemetryBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) {
+                block = static_cast<TelemetryBlock*>(p);
+            }
+        }
+        close(fd);
+        if (!block) {
+            shm_unlink(shm_name.c_str());
+            return false;
+        }
+
+        // Fresh pages are zero, so only the identification needs writing. Magic goes last.
+        block->version = TELEMETRY_VERSION;
+        block->pid = uint32_t(getpid());
+        block->slot_count = TELEMETRY_SLOTS;
+        read_program_name(block->program, sizeof(block->program));
+        block->start_ns.store(telemetry_now_ns(), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        block->magic = TELEMETRY_MAGIC;
+        if (!test_name.empty()) write_test();
+        return true;
+    }
+
+    static void read_program_name(char* out, size_t size) {
+        FILE* f = std::fopen("/proc/self/comm", "r");
+        if (f) {
+            if (std::fgets(out, int(size), f)) {
+                out[std::strcspn(out, "\n")] = 0;
+            }
+            std::fclose(f);
+        }
+    }
+};
+
+// Hot loop side of one slot. update() only stores; rates come from the previous update.
+class TelemetryPublisher {
+public:
+    TelemetryPublisher() : slot(nullptr), last_ns(0), last_cycles(0) {}
+
+    void attach(TelemetrySlot* s) {
+        slot = s;
+        last_ns = telemetry_now_ns();
+    }
+
+    void detach() {
+        if (slot) Telemetry::process().release_slot(slot);
+        slot = nullptr;
+    }
+
+    bool attached() const { return slot != nullptr; }
+
+    void update(uint64_t cycles, uint64_t instructions, uint64_t reads, uint64_t writes, uint64_t iack,
+                uint64_t last_vector) {
+        uint64_t now = telemetry_now_ns();
+        if (now > last_ns) {
+            slot->cycles_per_second.store((cycles - last_cycles) * 1000000000ull / (now - last_ns),
+                                          std::memory_order_relaxed);
+        }
+        last_ns = now;
+        last_cycles = cycles;
+
+        slot->cycles.store(cycles, std::memory_order_relaxed);
+        slot->instructions.store(instructions, std::memory_order_relaxed);
+        slot->bus_reads.store(reads, std::memory_order_relaxed);
+        slot->bus_writes.store(writes, std::memory_order_relaxed);
+        slot->bus_iack.store(iack, std::memory_order_relaxed);
+        slot->last_vector.store(last_vector, std::memory_order_relaxed);
+        slot->updated_ns.store(now, std::memory_order_relaxed);
+    }
+
+private:
+    TelemetrySlot* slot;
+    uint64_t last_ns;
+    uint64_t last_cycles;
+};
+
+#endif // FX68K_TELEMETRY_H
@@ -0,0 +1,177 @@
+// E bus (6800 peripheral) testbench for fx68k
+//
+// Built with USE_E_CLKEN (make build_ebus), so the harness clocks the E bus from E_PosClkEn and
+// E_NegClkEn. A guest program reads a byte 64 times from fast memory, then 64 times from a 6840
+// register, and the two loops are compared to give the cost of an E bus access. It then starts
+// timer 1 of the 6840 with interrupts enabled and counts autovectored interrupts, whose spacing
+// must match the programmed period.
+#include "fx68k_harness.h"
+#include "ptm6840.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+static const uint32_t INITIAL_SSP = 0x00010000;
+static const uint32_t PROGRAM_START = 0x00001000;
+static const uint32_t HANDLER_ADDR = 0x00000800;
+static const uint32_t TRAP_ADDR = 0x00000900;
+static const uint32_t RAM_DATA = 0x00002000;
+static const uint32_t MARK_BASE = 0x00003000;          // Loop boundaries, written by the guest
+static const uint32_t IRQ_COUNT = 0x00003010;
+static const uint32_t PTM_BASE = 0x00FF8000;           // Registers on odd addresses, (xxx).W reachable
+static const int PTM_IPL = 6;
+
+static const int LOOP_READS = 64;
+static const int TIMER_LATCH = 99;                     // Timeout every 100 E periods
+static const int E_CYCLES = 10;                        // CPU clocks per E period
+static const int INTERRUPTS = 20;
+static const uint64_t TIMEOUT_CYCLES = 200000;
+
+static const std::vector<uint16_t> PROGRAM = {
+    0x46FC, 0x2700,             // MOVE #$2700,SR
+    0x41F8, 0x2000,             // LEA RAM_DATA.W,A0
+    0x323C, LOOP_READS - 1,     // MOVE.W #63,D1
+    0x11C0, 0x3000,             // MOVE.B D0,MARK+0.W
+    0x1010,                     // MOVE.B (A0),D0
+    0x51C9, 0xFFFC,             // DBRA D1,*-2
+    0x11C0, 0x3002,             // MOVE.B D0,MARK+2.W
+    0x41F8, 0x8001,             // LEA PTM register 0.W,A0
+    0x323C, LOOP_READS - 1,     // MOVE.W #63,D1
+    0x11C0, 0x3004,             // MOVE.B D0,MARK+4.W
+    0x1010,                     // MOVE.B (A0),D0
+    0x51C9, 0xFFFC,             // DBRA D1,*-2
+    0x11C0, 0x3006,             // MOVE.B D0,MARK+6.W
+    0x11FC, 0x0001, 0x8003,     // MOVE.B #$01,CR2          register 0 is CR1
+    0x11FC, 0x0000, 0x8005,     // MOVE.B #$00,MSB buffer
+    0x11FC, TIMER_LATCH, 0x8007,// MOVE.B #99,timer 1 latch
+    0x11FC, 0x0042, 0x8001,     // MOVE.B #$42,CR1          E clock, IRQ enabled, out of preset
+    0x46FC, 0x2000,             // MOVE #$2000,SR
+    0x60FE,                     // BRA *
+};
+
+static const std::vector<uint16_t> HANDLER = {
+    0x1038, 0x8003,             // MOVE.B status,D0
+    0x1038, 0x8005,             // MOVE.B timer 1 MSB,D0    clears the flag
+    0x5278, 0x3010,             // ADDQ.W #1,IRQ_COUNT.W
+    0x4E73,                     // RTE
+};
+
+struct AccessStats {
+    uint64_t count, total, min, max;
+
+    AccessStats() : count(0), total(0), min(~0ull), max(0) {}
+
+    void add(uint64_t cycles) {
+        count++;
+        total += cycles;
+        min = std::min(min, cycles);
+        max = std::max(max, cycles);
+    }
+
+    void print(const char* name) const {
+        if (!count) {
+            std::printf("  %-12s no accesses\n", name);
+            return;
+        }
+        std::printf("  %-12s %6llu accesses, cycles min %llu avg %.2f max %llu\n", name,
+                    (unsigned long long)count, (unsigned long long)min, double(total) / count,
+                    (unsigned long long)max);
+    }
+};
+
+class EBusWatch : public BusObserver {
+public:
+    uint64_t marks[4];
+    AccessStats ram_reads, ebus_reads, ebus_writes;
+    std::vector<uint64_t> iack_cycles;
+
+    EBusWatch() : marks() {}
+
+    void bus_cycle(const BusCycle& cycle) override {
+        uint64_t cycles = cycle.end_cycle - cycle.start_cycle;
+        if (cycle.iack) {
+            iack_cycles.push_back(cycle.start_cycle);
+        } else if (cycle.vpa) {
+            (cycle.write ? ebus_writes : ebus_reads).add(cycles);
+        } else if (cycle.write && cycle.addr >= MARK_BASE && cycle.addr < MARK_BASE + 8) {
+            marks[(cycle.addr - MARK_BASE) >> 1] = cycle.start_cycle;
+        } else if (!cycle.write && cycle.addr == RAM_DATA) {
+            ram_reads.add(cycles);
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    Verilated::commandArgs(argc, argv);
+    Fx68kHarness::command_args(argc, argv);
+
+    std::cout << "Fx68k E Bus Test" << std::endl;
+    std::cout << "================" << std::endl;
+#ifdef FX68K_USE_E_CLKEN
+    std::cout << "E edges: E_PosClkEn/E_NegClkEn (USE_E_CLKEN)" << std::endl;
+#else
+    std::cout << "E edges: E output" << std::endl;
+#endif
+    Telemetry::process().set_test(0, "ebus");
+
+    Fx68kHarness hw;
+    EBus ebus;
+    Ptm6840 ptm;
+    EBusWatch watch;
+    ebus.map(&ptm, PTM_BASE, 8, PTM_IPL);
+    hw.ebus = &ebus;
+    hw.observer = &watch;
+
+    hw.mem.write_long(0, INITIAL_SSP);
+    hw.mem.write_long(4, PROGRAM_START);
+    for (uint32_t vec = 2; vec < 256; vec++) {
+        hw.mem.write_long(vec * 4, TRAP_ADDR);
+    }
+    hw.mem.write_long((24 + PTM_IPL) * 4, HANDLER_ADDR);
+    hw.mem.write_word(TRAP_ADDR, 0x60FE);                  // BRA *
+    hw.mem.load(PROGRAM_START, PROGRAM);
+    hw.mem.load(HANDLER_ADDR, HANDLER);
+
+    hw.reset();
+    hw.run_until([&] { return hw.halted() || hw.mem.read_word(IRQ_COUNT) >= INTERRUPTS; }, TIMEOUT_CYCLES);
+
+    bool ok = true;
+    std::cout << "\n=== E Bus Summary ===" << std::endl;
+    std::cout << "Cycles: " << hw.cycles() << ", E periods: " << ebus.periods() << std::endl;
+    watch.ram_reads.print("Fast reads");
+    watch.ebus_reads.print("E bus reads");
+    watch.ebus_writes.print("E bus writes");
+
+    if (watch.marks[1] && watch.marks[3]) {
+        uint64_t ram_loop = watch.marks[1] - watch.marks[0];
+        uint64_t e_loop = watch.marks[3] - watch.marks[2];
+        std::printf("  MOVE.B (A0),D0 loop: fast %.2f, E bus %.2f cycles per iteration, +%.2f per E access\n",
+                    double(ram_loop) / LOOP_READS, double(e_loop) / LOOP_READS,
+                    (double(e_loop) - double(ram_loop)) / LOOP_READS);
+        ok &= e_loop > ram_loop;
+    } else {
+        std::cout << "  FAIL: access loops did not complete" << std::endl;
+        ok = false;
+    }
+
+    unsigned count = hw.mem.read_word(IRQ_COUNT);
+    std::cout << "Timer interrupts: " << count << " (vector " << (hw.last_vector < 256 ? int(hw.last_vector) : -1)
+              << ")" << std::endl;
+    if (watch.iack_cycles.size() > 1) {
+        AccessStats spacing;
+        for (size_t i = 1; i < watch.iack_cycles.size(); i++) {
+            spacing.add(watch.iack_cycles[i] - watch.iack_cycles[i - 1]);
+        }
+        uint64_t expected = uint64_t(TIMER_LATCH + 1) * E_CYCLES;
+        std::printf("  Acknowledge spacing: min %llu avg %.2f max %llu cycles (period %llu)\n",
+                    (unsigned long long)spacing.min, double(spacing.total) / spacing.count,
+                    (unsigned long long)spacing.max, (unsigned long long)expected);
+        double avg = double(spacing.total) / spacing.count;
+        ok &= avg > expected * 0.99 && avg < expected * 1.01;
+    }
+    ok &= count >= unsigned(INTERRUPTS) && hw.last_vector == unsigned(24 + PTM_IPL);
+
+    std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok ? 0 : 1;
+}
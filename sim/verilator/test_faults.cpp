@@ -0,0 +1,438 @@
+// Bus fault injection campaign for fx68k
+//
+// A user mode guest loop reads, writes and pushes data while BusFaultInjector answers one bus
+// cycle with BERRn, chosen per case by address, function code, direction, cycle window, nth
+// match or probability. Each case is derived from its seed alone, so any failure is rerun with
+// --case N. The campaign also runs the three address error forms (odd word read, odd word
+// write, jump to an odd address) and double faults: a second BERR on the exception stack
+// writes of the first, which must halt the core (oHALTEDn).
+//
+// For every bus and address error the supervisor writes the core makes are recorded and must
+// form exactly one group 0 frame below the initial SSP, whose fields are checked against the
+// faulted cycle: access address, R/W, I/N, FC, the instruction register and the SR. The
+// handler must then run in supervisor mode with SSP on the frame, read from the register file
+// (arch_state.h).
+//
+// Case results are cached by content (result_cache.h), keyed on the case and its seed.
+#include "fx68k_harness.h"
+#include "fault_injector.h"
+#include "arch_state.h"
+#include "result_cache.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint32_t INITIAL_SSP = 0x00010000;
+static const uint32_t INITIAL_USP = 0x00008000;
+static const uint32_t PROGRAM_START = 0x00001000;
+static const uint32_t LOOP_ADDR = 0x00001010;
+static const uint32_t DATA_ADDR = 0x00002000;
+static const uint32_t BUS_ERROR_HANDLER = 0x00000800;
+static const uint32_t ADDRESS_ERROR_HANDLER = 0x00000880;
+static const uint32_t OTHER_HANDLER = 0x00000900;
+static const uint32_t ODD_ADDR = DATA_ADDR + 1;
+
+static const uint64_t TRIGGER_CYCLES = 20000;       // For the fault to fire
+static const uint64_t HANDLER_CYCLES = 2000;        // From the fault to the handler or halt
+
+static const std::vector<uint16_t> PROGRAM = {
+    0x207C, INITIAL_USP >> 16, INITIAL_USP & 0xFFFF,    // MOVEA.L #INITIAL_USP,A0
+    0x4E60,                     // MOVE A0,USP
+    0x41F8, DATA_ADDR,          // LEA DATA.W,A0
+    0x46FC, 0x0000,             // MOVE #$0000,SR       user mode
+    0x3010,                     // loop: MOVE.W (A0),D0
+    0x2228, 0x0004,             // MOVE.L 4(A0),D1
+    0x1140, 0x0008,             // MOVE.B D0,8(A0)
+    0x2141, 0x000C,             // MOVE.L D1,12(A0)
+    0xD081,                     // ADD.L D1,D0
+    0x3F00,                     // MOVE.W D0,-(A7)
+    0x301F,                     // MOVE.W (A7)+,D0
+    0x60EA,                     // BRA loop
+};
+static const uint32_t PROGRAM_END = PROGRAM_START + 0x26;
+
+// Address error forms, placed at LOOP_ADDR
+struct AddressErrorForm {
+    const char* name;
+    uint16_t opcode;
+    unsigned fc;
+    bool read;
+};
+
+static const AddressErrorForm ADDRESS_FORMS[] = {
+    { "odd word read", 0x3038, 1, true },       // MOVE.W ODD.W,D0
+    { "odd word write", 0x31C0, 1, false },     // MOVE.W D0,ODD.W
+    { "odd jump", 0x4EF8, 2, true },            // JMP ODD.W
+};
+
+enum FaultKind { BUS_ERROR, ADDRESS_ERROR, DOUBLE_FAULT };
+static const char* KIND_NAMES[] = { "bus error", "address error", "double fault" };
+
+struct FaultCase {
+    FaultKind kind;
+    uint32_t seed;
+    FaultRule rule;                 // Bus error, and the first fault of a double fault
+    int form;                       // Address error
+};
+
+// Case n of a campaign. The first cases are the address error forms, then bus errors and
+// double faults in a fixed ratio, their rules drawn from the seed.
+static FaultCase make_case(uint32_t base_seed, unsigned n) {
+    const unsigned forms = sizeof(ADDRESS_FORMS) / sizeof(ADDRESS_FORMS[0]);
+    FaultCase c;
+    c.seed = base_seed + n;
+    c.form = 0;
+    if (n < forms) {
+        c.kind = ADDRESS_ERROR;
+        c.form = int(n);
+        return c;
+    }
+    std::mt19937 rng(c.seed);
+    c.kind = (n % 4 == 3) ? DOUBLE_FAULT : BUS_ERROR;
+
+    FaultRule& r = c.rule;
+    switch (rng() % 4) {
+    case 0: r.fc_mask = 1 << 1; r.access = 1; break;        // User data reads
+    case 1: r.fc_mask = 1 << 1; r.access = 2; break;        // User data writes
+    case 2: r.fc_mask = 1 << 2; r.access = 1; break;        // User program fetches
+    default: r.fc_mask = (1 << 1) | (1 << 2); break;        // Anything in user mode
+    }
+    switch (rng() % 3) {
+    case 0: r.nth = 1 + rng() % 40; break;
+    case 1: r.cycle_lo = 50 + rng() % 1000; break;
+    default: r.probability = 0.02 + (rng() % 19) * 0.01; break;
+    }
+    if (rng() % 2) {
+        r.addr_lo = DATA_ADDR;      // Data area only; fetches never match
+        r.addr_hi = DATA_ADDR + 0x0F;
+    }
+    return c;
+}
+
+struct CaseResult {
+    bool triggered;
+    bool passed;
+    std::string detail;
+};
+
+class FaultRunner : public BusFaultSource, public BusObserver {
+public:
+    bool verbose;
+
+    FaultRunner() : verbose(false), faulted(false), fault_ird(0), handler(0), first_fault() {
+        hw.bus_faults = this;
+        hw.observer = this;
+
+        hw.mem.write_long(0, INITIAL_SSP);
+        hw.mem.write_long(4, PROGRAM_START);
+        for (uint32_t vec = 2; vec < 256; vec++) {
+            hw.mem.write_long(vec * 4, OTHER_HANDLER);
+        }
+        hw.mem.write_long(2 * 4, BUS_ERROR_HANDLER);
+        hw.mem.write_long(3 * 4, ADDRESS_ERROR_HANDLER);
+        for (uint32_t h : { BUS_ERROR_HANDLER, ADDRESS_ERROR_HANDLER, OTHER_HANDLER }) {
+            hw.mem.write_word(h, 0x60FE);                  // BRA *
+        }
+        hw.mem.load(PROGRAM_START, PROGRAM);
+        hw.mem.commit_baseline();
+    }
+
+    CaseResult run(const FaultCase& c) {
+        CaseResult result = CaseResult();
+        hw.mem.restore_baseline();
+        injector = BusFaultInjector(c.seed);
+        if (c.kind == ADDRESS_ERROR) {
+            hw.mem.write_word(LOOP_ADDR, ADDRESS_FORMS[c.form].opcode);
+            hw.mem.write_word(LOOP_ADDR + 2, ODD_ADDR);
+        } else {
+            injector.add(c.rule);
+        }
+        if (c.kind == DOUBLE_FAULT) {
+            FaultRule stack;
+            stack.fc_mask = 1 << 5;                         // The exception frame writes
+            stack.access = 2;
+            injector.add(stack);
+        }
+        faulted = (c.kind == ADDRESS_ERROR);
+        handler = 0;
+        frame_writes.clear();
+        hw.reset();
+
+        uint64_t deadline = TRIGGER_CYCLES;
+        while (hw.cycles() < deadline && !handler && !hw.halted()) {
+            if (faulted && deadline == TRIGGER_CYCLES) deadline = hw.cycles() + HANDLER_CYCLES;
+            hw.step_cycle();
+        }
+        result.triggered = faulted;
+        if (!faulted) {
+            result.passed = true;
+            result.detail = "rule never fired";
+            return result;
+        }
+
+        std::string error;
+        if (c.kind == DOUBLE_FAULT) {
+            if (!hw.halted()) error = handler ? "handler ran instead of halting" : "no halt";
+            else if (injector.injected.size() != 2) error = "second fault not injected";
+        } else {
+            error = check_frame(c);
+        }
+        result.passed = error.empty();
+        result.detail = error;
+        return result;
+    }
+
+    bool bus_error(const BusCycle& cycle) override {
+        bool fault = injector.bus_error(cycle);
+        if (fault && !faulted) {
+            faulted = true;
+            first_fault = cycle;
+            fault_ird = hw.ird();
+        }
+        return fault;
+    }
+
+    void bus_cycle(const BusCycle& cycle) override {
+        if (!faulted || handler) return;
+        if (cycle.write && cycle.fc == 5) {
+            frame_writes.push_back(cycle.addr);
+        } else if (!cycle.write && cycle.fc == 6 && cycle.addr >= BUS_ERROR_HANDLER && cycle.addr <= OTHER_HANDLER) {
+            handler = cycle.addr;
+        }
+    }
+
+private:
+    Fx68kHarness hw;
+    BusFaultInjector injector;
+    bool faulted;
+    uint16_t fault_ird;
+    uint32_t handler;
+    BusCycle first_fault;
+    std::vector<uint32_t> frame_writes;     // Supervisor data write addresses, in bus order
+
+    std::string check_frame(const FaultCase& c) {
+        uint32_t expected_handler = (c.kind == ADDRESS_ERROR) ? ADDRESS_ERROR_HANDLER : BUS_ERROR_HANDLER;
+        if (handler != expected_handler) {
+            return handler ? "wrong handler " + hex(handler) : "handler not reached";
+        }
+
+        // Exactly the 7 frame words, each written once, below the initial SSP
+        uint32_t sp = INITIAL_SSP - Group0Frame::SIZE;
+        std::vector<uint32_t> written = frame_writes;
+        std::sort(written.begin(), written.end());
+        bool one_frame = written.size() == Group0Frame::SIZE / 2;
+        for (size_t i = 0; one_frame && i < written.size(); i++) {
+            one_frame = written[i] == sp + 2 * i;
+        }
+        if (!one_frame) {
+            return std::to_string(frame_writes.size()) + " supervisor writes, not one group 0 frame";
+        }
+        Group0Frame f = Group0Frame::read(hw.mem, sp);
+        if (verbose) std::cout << "  Frame: " << f.describe() << std::endl;
+
+        uint32_t addr;
+        unsigned fc;
+        bool read;
+        uint16_t ir;
+        if (c.kind == ADDRESS_ERROR) {
+            const AddressErrorForm& form = ADDRESS_FORMS[c.form];
+            addr = ODD_ADDR;
+            fc = form.fc;
+            read = form.read;
+            ir = form.opcode;
+        } else {
+            addr = first_fault.addr;
+            fc = first_fault.fc;
+            read = !first_fault.write;
+            ir = fault_ird;
+        }
+
+        std::string error;
+        bool addr_ok = (c.kind == ADDRESS_ERROR) ? f.access_addr == addr : (f.access_addr & ~1u) == addr;
+        if (!addr_ok) error += " address " + hex(f.access_addr) + " expected " + hex(addr);
+        if (f.fc() != fc) error += " FC " + std::to_string(f.fc()) + " expected " + std::to_string(fc);
+        if (f.read_access() != read) error += read ? " R/W shows write" : " R/W shows read";
+        if (f.not_instruction()) error += " I/N set";
+        if (f.ir != ir) error += " IR " + hex(f.ir) + " expected " + hex(ir);
+        if (f.sr & 0x2700) error += " SR " + hex(f.sr) + " not user mode, mask 0";
+        if ((f.pc & 1) || f.pc < PROGRAM_START || f.pc > PROGRAM_END + 10) error += " PC " + hex(f.pc) + " outside program";
+
+        // The handler runs in supervisor mode on the frame just pushed
+        ArchState arch(hw.cpu);
+        if (arch.ssp() != sp) error += " SSP " + hex(arch.ssp()) + " expected " + hex(sp);
+        if (!arch.supervisor() || (arch.sr() & 0x8000)) error += " handler SR " + hex(arch.sr());
+        return error.empty() ? error : f.describe() + ":" + error;
+    }
+
+    static std::string hex(uint32_t v) {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "$%X", v);
+        return buf;
+    }
+};
+
+static std::string describe_case(const FaultCase& c) {
+    std::string s = std::string(KIND_NAMES[c.kind]) + " seed " + std::to_string(c.seed);
+    if (c.kind == ADDRESS_ERROR) return s + " (" + ADDRESS_FORMS[c.form].name + ")";
+    return s + " [" + c.rule.describe() + "]";
+}
+
+// Cache form of a result, and back
+static std::string encode_result(const CaseResult& r) {
+    return std::string(r.triggered ? "1" : "0") + (r.passed ? "1" : "0") + " " + r.detail;
+}
+
+static bool decode_result(const std::string& s, CaseResult& r) {
+    if (s.size() < 3 || s[2] != ' ') return false;
+    r.triggered = s[0] == '1';
+    r.passed = s[1] == '1';
+    r.detail = s.substr(3);
+    return true;
+}
+
+static void print_help(const char* prog) {
+    std::cout << "Usage: " << prog << " [options]" << std::endl;
+    std::cout << "  --cases N     Campaign size (default 2000)" << std::endl;
+    std::cout << "  --seed N      Base seed, case n uses seed+n (default 1)" << std::endl;
+    std::cout << "  --jobs N      Worker threads (default: all cores)" << std::endl;
+    std::cout << "  --case N      Run only case N, printing its frame" << std::endl;
+    std::cout << "  --rule SPEC   Run one bus error with a rule of your own:" << std::endl;
+    std::cout << "                addr=LO-HI,fc=1|2,rw=r|w,cycle=LO-HI,nth=N,p=P,max=N (hex addresses)" << std::endl;
+    std::cout << "  --force       Simulate every case, refreshing the result cache" << std::endl;
+    std::cout << "  --no-cache    Neither read nor write the result cache" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    Verilated::commandArgs(argc, argv);
+    Fx68kHarness::command_args(argc, argv);
+
+    unsigned cases = 2000;
+    uint32_t seed = 1;
+    unsigned jobs = std::thread::hardware_concurrency();
+    int single = -1;
+    std::string rule_spec;
+    bool force = false;
+    bool use_cache = true;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--cases" && i + 1 < argc) {
+            cases = std::stoul(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoul(argv[++i]);
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            jobs = std::stoul(argv[++i]);
+        } else if (arg == "--case" && i + 1 < argc) {
+            single = std::stoi(argv[++i]);
+        } else if (arg == "--rule" && i + 1 < argc) {
+            rule_spec = argv[++i];
+        } else if (arg == "--force") {
+            force = true;
+        } else if (arg == "--no-cache") {
+            use_cache = false;
+        } else if (arg == "--help" || arg == "-h") {
+            print_help(argv[0]);
+            return 0;
+        }
+    }
+    if (jobs == 0) jobs = 1;
+
+    std::cout << "Fx68k Bus Fault Injection" << std::endl;
+    std::cout << "=========================" << std::endl;
+
+    std::vector<FaultCase> campaign;
+    if (!rule_spec.empty()) {
+        FaultCase c = FaultCase();
+        c.kind = BUS_ERROR;
+        c.seed = seed;
+        std::string error;
+        if (!FaultRule::parse(rule_spec, c.rule, error)) {
+            std::cerr << "Error: --rule: " << error << std::endl;
+            return 2;
+        }
+        campaign.push_back(c);
+    } else if (single >= 0) {
+        campaign.push_back(make_case(seed, unsigned(single)));
+    } else {
+        for (unsigned n = 0; n < cases; n++) campaign.push_back(make_case(seed, n));
+    }
+    bool verbose = campaign.size() == 1;
+    // A single case is run to look at its frame
+    if (verbose) use_cache = false;
+    ResultCache cache("faults", force);
+    std::string cache_error;
+    if (use_cache && !cache.open(argc, argv, cache_error)) {
+        std::cerr << "Warning: result cache disabled: " << cache_error << std::endl;
+        use_cache = false;
+    }
+    jobs = std::min<unsigned>(jobs, campaign.size());
+    std::cout << "Cases: " << campaign.size() << ", workers: " << jobs << ", seed: " << seed << std::endl;
+    Telemetry::process().set_test(seed, "bus fault campaign");
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    std::vector<CaseResult> results(campaign.size());
+    std::vector<std::thread> workers;
+    for (unsigned j = 0; j < jobs; j++) {
+        workers.emplace_back([&, j]() {
+            FaultRunner runner;
+            runner.verbose = verbose;
+            for (size_t n = j; n < campaign.size(); n += jobs) {
+                std::string key, cached;
+                if (use_cache) {
+                    key = cache.key(describe_case(campaign[n]));
+                    if (cache.lookup(key, cached) && decode_result(cached, results[n])) continue;
+                }
+                auto case_start = std::chrono::steady_clock::now();
+                results[n] = runner.run(campaign[n]);
+                if (use_cache) {
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - case_start;
+                    cache.store(key, encode_result(results[n]), elapsed.count());
+                }
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+
+    unsigned passed[3] = {}, failed[3] = {}, untriggered = 0;
+    for (size_t n = 0; n < campaign.size(); n++) {
+        const FaultCase& c = campaign[n];
+        const CaseResult& r = results[n];
+        if (!r.triggered) {
+            untriggered++;
+        } else if (r.passed) {
+            passed[c.kind]++;
+        } else {
+            failed[c.kind]++;
+            std::cout << "  FAIL case " << (single >= 0 ? single : int(n)) << ": " << describe_case(c) << std::endl;
+            std::cout << "       " << r.detail << std::endl;
+        }
+        if (verbose) {
+            std::cout << "  " << describe_case(c) << ": "
+                      << (!r.triggered ? "not triggered" : r.passed ? "PASS" : "FAIL") << std::endl;
+        }
+    }
+
+    std::cout << "\n=== Fault Injection Summary ===" << std::endl;
+    std::cout << "Ran " << campaign.size() << " cases in " << duration.count() << " ms" << std::endl;
+    unsigned failures = 0;
+    for (int k = 0; k < 3; k++) {
+        std::printf("  %-14s passed %6u  failed %6u\n", KIND_NAMES[k], passed[k], failed[k]);
+        failures += failed[k];
+    }
+    std::cout << "Rules that never fired: " << untriggered << std::endl;
+    if (use_cache) {
+        if (!cache.flush(cache_error)) std::cerr << "Warning: " << cache_error << std::endl;
+        cache.print_summary();
+    }
+    return failures ? 1 : 0;
+}
@@ -1,6 +1,9 @@
+#include "suite.h"
 #include <iostream>
 
-int main(int argc, char** argv) {
+static int instruction_suite(int argc, char** argv) {
     std::cout << "Instruction tests not implemented yet." << std::endl;
     return 0;
 }
+
+FX68K_SUITE("instructions", "Instruction execution tests", instruction_suite)
@@ -1,6 +1,551 @@
+// Interrupt latency testbench for fx68k
+//
+// The guest loops over a mix of long instructions (DIVS, MOVEM.L of 15 registers, MULU) with
+// every interrupt level unmasked. The testbench raises a random IPL level at a random cycle
+// offset through IPL0n-2n, and the interrupt is autovectored through VPAn. For each request it
+// measures the clocks from the IPL change to the start of the acknowledge cycle (FC=7) and to
+// the first fetch of the handler, and reports the distribution per level and per instruction
+// that was executing when the request arrived.
+//
+// IPL is released at the end of the acknowledge cycle, as a device would on being acknowledged.
+//
+// --stress CYCLES runs an interrupt storm instead: IPL changes to a random level every few
+// clocks, level 7 is held until acknowledged so each NMI edge must be taken, and acknowledges
+// are answered at random with VPAn, a vector number or BERRn (spurious). Handlers raise the mask
+// to 7 and lower it below their own level before RTE, so interrupts nest. Invariants are checked
+// while it runs: the guest main loop verifies SR, A7 and a register after every interrupt it
+// sees, handlers verify the mask they were entered with, and every level 7 edge must be
+// acknowledged within NMI_TIMEOUT clocks. At the end the handler entries the guest counted must
+// match the acknowledges the bus saw, level by level.
+#include "fx68k_harness.h"
+#include "suite.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
-int main(int argc, char** argv) {
-    std::cout << "Interrupt tests not implemented yet." << std::endl;
-    return 0;
-}
\ No newline at end of file
+static const uint32_t INITIAL_SSP = 0x00010000;
+static const uint32_t PROGRAM_START = 0x00001000;
+static const uint32_t HANDLER_ADDR = 0x00000800;
+static const uint32_t TRAP_ADDR = 0x00000900;
+
+// Quiet time between a handler and the next request, plus a random part longer than one pass
+// of the loop so requests land anywhere in it
+static const uint64_t MIN_GAP = 200;
+static const uint64_t GAP_SPAN = 1024;
+static const uint64_t TIMEOUT_CYCLES = 2000;
+
+static const std::vector<uint16_t> PROGRAM = {
+    0x46FC, 0x2000,             // MOVE #$2000,SR               all levels enabled
+    0x203C, 0x0012, 0x3456,     // loop: MOVE.L #$123456,D0
+    0x81FC, 0x0007,             // DIVS #7,D0
+    0x48E7, 0xFFFE,             // MOVEM.L D0-D7/A0-A6,-(A7)
+    0x4CDF, 0x7FFF,             // MOVEM.L (A7)+,D0-D7/A0-A6
+    0x323C, 0xFFFF,             // MOVE.W #$FFFF,D1
+    0xC2FC, 0xFFFF,             // MULU #$FFFF,D1
+    0x4E71,                     // NOP
+    0x60E2,                     // BRA loop
+};
+
+static const std::vector<uint16_t> HANDLER = {
+    0x4E73,                     // RTE
+};
+
+static const char* instruction_class(uint16_t opcode) {
+    if ((opcode & 0xF1C0) == 0x81C0) return "DIVS";
+    if ((opcode & 0xF1C0) == 0xC0C0) return "MULU";
+    if ((opcode & 0xFB80) == 0x4880) return "MOVEM";
+    if ((opcode & 0xF000) == 0x2000 || (opcode & 0xF000) == 0x3000) return "MOVE";
+    if (opcode == 0x4E71) return "NOP";
+    if ((opcode & 0xFF00) == 0x6000) return "BRA";
+    if (opcode == 0x4E73) return "RTE";
+    return "other";
+}
+
+struct LatencySample {
+    int level;
+    const char* interrupted;    // Instruction executing when IPL changed
+    uint32_t to_iack;
+    uint32_t to_fetch;
+};
+
+// Tracks the instruction in execution and the acknowledge / handler fetch of the pending request
+class LatencyProbe : public BusObserver, public InstructionObserver {
+public:
+    Fx68kHarness& hw;
+    uint16_t executing;
+    uint64_t iack_cycle;
+    uint64_t fetch_cycle;
+    int iack_level;
+    bool bad_vector;
+
+    explicit LatencyProbe(Fx68kHarness& h) : hw(h), executing(0) { arm(); }
+
+    void arm() {
+        iack_cycle = fetch_cycle = 0;
+        iack_level = 0;
+        bad_vector = false;
+    }
+
+    void instruction(uint32_t addr, uint16_t opcode, uint64_t cycle) override {
+        (void)addr;
+        (void)cycle;
+        executing = opcode;
+    }
+
+    void bus_cycle(const BusCycle& cycle) override {
+        if (cycle.iack) {
+            iack_cycle = cycle.start_cycle;
+            iack_level = (cycle.addr >> 1) & 7;
+            hw.set_ipl(0);
+        } else if (iack_cycle && !fetch_cycle && !cycle.write && cycle.fc == 5 && cycle.addr < 0x400) {
+            bad_vector |= (cycle.addr >> 2) != uint32_t(24 + iack_level);
+        } else if (iack_cycle && !fetch_cycle && !cycle.write && (cycle.fc & 3) == 2) {
+            fetch_cycle = cycle.start_cycle;
+            bad_vector |= cycle.addr != HANDLER_ADDR;
+        }
+    }
+};
+
+class LatencyRun {
+public:
+    std::vector<LatencySample> samples;
+    int failures;
+
+    LatencyRun() : failures(0), probe(hw) {
+        hw.observer = &probe;
+        hw.insn_observer = &probe;
+
+        hw.mem.write_long(0, INITIAL_SSP);
+        hw.mem.write_long(4, PROGRAM_START);
+        for (uint32_t vec = 2; vec < 256; vec++) {
+            hw.mem.write_long(vec * 4, TRAP_ADDR);
+        }
+        for (int level = 1; level <= 7; level++) {
+            hw.mem.write_long((24 + level) * 4, HANDLER_ADDR);
+        }
+        hw.mem.write_word(TRAP_ADDR, 0x60FE);              // BRA *
+        hw.mem.load(PROGRAM_START, PROGRAM);
+        hw.mem.load(HANDLER_ADDR, HANDLER);
+    }
+
+    void run(int requests, uint32_t seed) {
+        std::mt19937 rng(seed);
+        hw.reset();
+
+        for (int i = 0; i < requests && !hw.halted(); i++) {
+            uint64_t gap = MIN_GAP + rng() % GAP_SPAN;
+            for (uint64_t c = 0; c < gap; c++) {
+                hw.step_cycle();
+            }
+
+            int level = 1 + rng() % 7;
+            probe.arm();
+            const char* interrupted = instruction_class(probe.executing);
+            uint64_t asserted = hw.cycles();
+            hw.set_ipl(level);
+            while (!probe.fetch_cycle && hw.cycles() - asserted < TIMEOUT_CYCLES && !hw.halted()) {
+                hw.step_cycle();
+            }
+
+            if (!probe.fetch_cycle || probe.iack_level != level || probe.bad_vector) {
+                failures++;
+                std::printf("  FAIL: level %d request at cycle %llu: %s\n", level, (unsigned long long)asserted,
+                            !probe.fetch_cycle ? "no handler fetch" : "wrong level or vector");
+                hw.set_ipl(0);
+                continue;
+            }
+            samples.push_back(LatencySample{ level, interrupted, uint32_t(probe.iack_cycle - asserted),
+                                             uint32_t(probe.fetch_cycle - asserted) });
+        }
+    }
+
+private:
+    Fx68kHarness hw;
+    LatencyProbe probe;
+};
+
+struct Distribution {
+    std::vector<uint32_t> values;
+
+    void sort() { std::sort(values.begin(), values.end()); }
+
+    // Nearest rank on sorted values
+    uint32_t percentile(int p) const {
+        return values[(values.size() - 1) * p / 100];
+    }
+
+    std::string summary() const {
+        if (values.empty()) return "no samples";
+        char buf[96];
+        std::snprintf(buf, sizeof(buf), "%4u %5u %5u %5u", values.front(), percentile(50), percentile(99),
+                      values.back());
+        return buf;
+    }
+};
+
+// Interrupt storm
+static const uint32_t STRESS_HEARTBEAT = 0x00003000;    // Main loop passes
+static const uint32_t STRESS_FAIL = 0x00003004;         // Guest failure code, see STRESS_FAILURES
+static const uint32_t STRESS_COUNTS = 0x00003010;       // Handler entries, long per level 1-7
+static const uint32_t STRESS_SPURIOUS = 0x00003030;
+static const uint32_t STRESS_HANDLERS = 0x00000800;     // 0x40 per level, spurious handler first
+static const uint32_t STRESS_TRAP = 0x00000A00;         // Other exceptions, past the level 7 handler
+static const int STRESS_VECTOR_BASE = 64;               // Vectored acknowledges use 64 + level
+static const uint64_t MIN_DWELL = 4;                    // Clocks between IPL changes, at least
+static const uint64_t NMI_TIMEOUT = 1000;
+static const uint64_t DRAIN_CYCLES = 20000;
+
+static const char* STRESS_FAILURES[] = {
+    "", "SR not restored", "stack not balanced", "register corrupted", "wrong mask in handler",
+    "unexpected exception",
+};
+
+static std::vector<uint16_t> stress_main() {
+    return {
+        0x46FC, 0x2000,             // MOVE #$2000,SR
+        0x7E55,                     // MOVEQ #$55,D7
+        0x44FC, 0x0015,             // loop: MOVE #$15,CCR
+        0x40C0,                     // MOVE SR,D0
+        0x0C40, 0x2015,             // CMPI.W #$2015,D0
+        0x6616,                     // BNE fail_sr
+        0xBFFC, INITIAL_SSP >> 16, INITIAL_SSP & 0xFFFF,   // CMPA.L #INITIAL_SSP,A7
+        0x6616,                     // BNE fail_stack
+        0x0C87, 0x0000, 0x0055,     // CMPI.L #$55,D7
+        0x6616,                     // BNE fail_regs
+        0x52B8, STRESS_HEARTBEAT,   // ADDQ.L #1,HEARTBEAT.W
+        0x60DE,                     // BRA loop
+        0x31FC, 0x0001, STRESS_FAIL,    // fail_sr: MOVE.W #1,FAIL.W
+        0x60FE,                         // BRA *
+        0x31FC, 0x0002, STRESS_FAIL,    // fail_stack
+        0x60FE,
+        0x31FC, 0x0003, STRESS_FAIL,    // fail_regs
+        0x60FE,
+    };
+}
+
+static std::vector<uint16_t> stress_handler(int level) {
+    return {
+        0x48E7, 0xC080,                                 // MOVEM.L D0-D1/A0,-(A7)
+        0x40C0,                                         // MOVE SR,D0
+        0x0240, 0x0700,                                 // ANDI.W #$0700,D0
+        0x0C40, uint16_t(level << 8),                   // CMPI.W #level<<8,D0
+        0x6612,                                         // BNE fail
+        0x46FC, 0x2700,                                 // MOVE #$2700,SR
+        0x52B8, uint16_t(STRESS_COUNTS + level * 4),    // ADDQ.L #1,count.W
+        0x46FC, uint16_t(0x2000 | (level - 1) << 8),    // MOVE #$2n00,SR     level - 1, same level nests
+        0x4CDF, 0x0103,                                 // MOVEM.L (A7)+,D0-D1/A0
+        0x4E73,                                         // RTE
+        0x31FC, 0x0004, STRESS_FAIL,                    // fail: MOVE.W #4,FAIL.W
+        0x60FE,                                         // BRA *
+    };
+}
+
+class StressRun : public BusObserver, public IackResponder {
+public:
+    uint64_t acks[8][3];            // Level, IackReply
+    uint64_t guest_counts[8];
+    uint64_t guest_spurious;
+    uint64_t nmi_edges;
+    uint64_t changes;
+    uint64_t max_nmi_latency;
+    uint64_t heartbeat;
+    uint64_t cycles;
+    std::string failure;
+
+    StressRun() : acks(), guest_counts(), guest_spurious(0), nmi_edges(0), changes(0), max_nmi_latency(0),
+                  heartbeat(0), cycles(0), requested(0), nmi_since(0), next_change(0) {
+        hw.observer = this;
+        hw.iack_responder = this;
+
+        hw.mem.write_long(0, INITIAL_SSP);
+        hw.mem.write_long(4, PROGRAM_START);
+        for (uint32_t vec = 2; vec < 256; vec++) {
+            hw.mem.write_long(vec * 4, STRESS_TRAP);
+        }
+        hw.mem.write_long(24 * 4, STRESS_HANDLERS);
+        for (int level = 1; level <= 7; level++) {
+            uint32_t handler = STRESS_HANDLERS + level * 0x40;
+            hw.mem.write_long((24 + level) * 4, handler);
+            hw.mem.write_long((STRESS_VECTOR_BASE + level) * 4, handler);
+            hw.mem.load(handler, stress_handler(level));
+        }
+        hw.mem.load(STRESS_HANDLERS, { 0x52B8, STRESS_SPURIOUS, 0x4E73 });    // ADDQ.L #1,SPURIOUS.W; RTE
+        hw.mem.load(STRESS_TRAP, { 0x31FC, 0x0005, STRESS_FAIL, 0x60FE });
+        hw.mem.load(PROGRAM_START, stress_main());
+    }
+
+    IackReply acknowledge(int level, uint8_t& vector) override {
+        unsigned r = rng() % 10;
+        IackReply reply = r < 5 ? IackReply::AUTOVECTOR : (r < 9 ? IackReply::VECTOR : IackReply::SPURIOUS);
+        vector = uint8_t(STRESS_VECTOR_BASE + level);
+        acks[level][int(reply)]++;
+        return reply;
+    }
+
+    void bus_cycle(const BusCycle& cycle) override {
+        if (cycle.iack) {
+            int level = (cycle.addr >> 1) & 7;
+            if (level == 7) {
+                max_nmi_latency = std::max(max_nmi_latency, cycle.start_cycle - nmi_since);
+            }
+            // The acknowledged device lets go; give the core time to see IPL drop before the next edge
+            if (level == requested) {
+                requested = 0;
+                hw.set_ipl(0);
+                next_change = std::max(next_change, cycle.end_cycle + MIN_DWELL);
+            }
+        } else if (cycle.write && cycle.addr == STRESS_FAIL && failure.empty()) {
+            unsigned code = cycle.data;
+            failure = code < sizeof(STRESS_FAILURES) / sizeof(STRESS_FAILURES[0]) ? STRESS_FAILURES[code] : "guest";
+            failure += " (cycle " + std::to_string(cycle.start_cycle) + ")";
+        }
+    }
+
+    void run(uint64_t limit, uint32_t seed, unsigned rate) {
+        rng.seed(seed);
+        hw.reset();
+
+        while (hw.cycles() < limit && failure.empty()) {
+            if (hw.cycles() >= next_change) {
+                change_level();
+                next_change = hw.cycles() + MIN_DWELL + rng() % rate;
+            }
+            if (requested == 7 && hw.cycles() - nmi_since > NMI_TIMEOUT) {
+                failure = "level 7 edge not acknowledged (cycle " + std::to_string(nmi_since) + ")";
+            }
+            if (hw.halted()) {
+                failure = "CPU halted";
+            }
+            hw.step_cycle();
+        }
+
+        // Let every handler return, then the counts on both sides must agree
+        hw.set_ipl(0);
+        requested = 0;
+        uint32_t before = hw.mem.read_long(STRESS_HEARTBEAT);
+        for (uint64_t c = 0; c < DRAIN_CYCLES && failure.empty(); c++) {
+            hw.step_cycle();
+        }
+        cycles = hw.cycles();
+        heartbeat = hw.mem.read_long(STRESS_HEARTBEAT);
+        guest_spurious = hw.mem.read_long(STRESS_SPURIOUS);
+        for (int level = 1; level <= 7; level++) {
+            guest_counts[level] = hw.mem.read_long(STRESS_COUNTS + level * 4);
+        }
+        if (!failure.empty()) return;
+
+        uint64_t spurious = 0;
+        for (int level = 1; level <= 7; level++) {
+            spurious += acks[level][int(IackReply::SPURIOUS)];
+            uint64_t handled = acks[level][int(IackReply::AUTOVECTOR)] + acks[level][int(IackReply::VECTOR)];
+            if (guest_counts[level] != handled) {
+                failure = "level " + std::to_string(level) + ": " + std::to_string(handled) + " acknowledged, "
+                        + std::to_string(guest_counts[level]) + " handled";
+            }
+        }
+        uint64_t nmi_acks = acks[7][0] + acks[7][1] + acks[7][2];
+        if (failure.empty() && guest_spurious != spurious) {
+            failure = std::to_string(spurious) + " spurious acknowledges, " + std::to_string(guest_spurious) + " handled";
+        } else if (failure.empty() && nmi_acks != nmi_edges) {
+            failure = std::to_string(nmi_edges) + " level 7 edges, " + std::to_string(nmi_acks) + " acknowledged";
+        } else if (failure.empty() && hw.mem.read_long(STRESS_HEARTBEAT) == before) {
+            failure = "main loop did not resume";
+        }
+    }
+
+private:
+    Fx68kHarness hw;
+    std::mt19937 rng;
+    int requested;
+    uint64_t nmi_since;
+    uint64_t next_change;
+
+    // Level 7 stays until acknowledged, everything else may be replaced before it is taken
+    void change_level() {
+        if (requested == 7) return;
+        int level = rng() % 8;
+        if (level == requested) return;
+        requested = level;
+        hw.set_ipl(level);
+        changes++;
+        if (level == 7) {
+            nmi_edges++;
+            nmi_since = hw.cycles();
+        }
+    }
+};
+
+static int run_stress(uint64_t cycles, unsigned jobs, uint32_t seed, unsigned rate) {
+    std::cout << "Fx68k Interrupt Stress Test" << std::endl;
+    std::cout << "===========================" << std::endl;
+    std::cout << "Cycles per instance: " << cycles << ", instances: " << jobs << ", seed: " << seed
+              << ", IPL change every " << MIN_DWELL << "-" << MIN_DWELL + rate - 1 << " cycles" << std::endl;
+    Telemetry::process().set_test(seed, "interrupt stress");
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    std::vector<StressRun> runs(jobs);
+    std::vector<std::thread> workers;
+    for (unsigned j = 0; j < jobs; j++) {
+        workers.emplace_back([&, j]() { runs[j].run(cycles, seed + j, rate); });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count() / 1000.0;
+
+    uint64_t acks[8][3] = {}, total_cycles = 0, edges = 0, changes = 0, max_nmi = 0, heartbeat = 0;
+    int failures = 0;
+    for (unsigned j = 0; j < jobs; j++) {
+        const StressRun& r = runs[j];
+        for (int level = 1; level <= 7; level++) {
+            for (int k = 0; k < 3; k++) acks[level][k] += r.acks[level][k];
+        }
+        total_cycles += r.cycles;
+        edges += r.nmi_edges;
+        changes += r.changes;
+        max_nmi = std::max(max_nmi, r.max_nmi_latency);
+        heartbeat += r.heartbeat;
+        if (!r.failure.empty()) {
+            failures++;
+            std::cout << "  FAIL instance " << j << " (seed " << seed + j << "): " << r.failure << std::endl;
+        }
+    }
+
+    std::cout << "\n=== Interrupt Stress Summary ===" << std::endl;
+    std::printf("Cycles: %llu in %.1f s (%.2f MHz aggregate)\n", (unsigned long long)total_cycles, seconds,
+                seconds > 0 ? total_cycles / seconds / 1e6 : 0.0);
+    std::printf("IPL changes: %llu, level 7 edges: %llu, longest NMI to IACK: %llu cycles\n",
+                (unsigned long long)changes, (unsigned long long)edges, (unsigned long long)max_nmi);
+    std::cout << "Acknowledges       autovector     vectored     spurious" << std::endl;
+    for (int level = 1; level <= 7; level++) {
+        std::printf("  Level %d     %12llu %12llu %12llu\n", level, (unsigned long long)acks[level][0],
+                    (unsigned long long)acks[level][1], (unsigned long long)acks[level][2]);
+    }
+    std::cout << "Main loop passes: " << heartbeat << std::endl;
+    std::cout << "Failed instances: " << failures << std::endl;
+    return failures ? 1 : 0;
+}
+
+static void print_help(const char* prog) {
+    std::cout << "Usage: " << prog << " [options]" << std::endl;
+    std::cout << "  --requests N      Interrupt requests in total (default 7000)" << std::endl;
+    std::cout << "  --jobs N          Worker threads, each its own model (default: all cores)" << std::endl;
+    std::cout << "  --seed N          Base seed for levels and offsets (default 1)" << std::endl;
+    std::cout << "  --histogram FILE  Write the full distributions as CSV" << std::endl;
+    std::cout << "  --stress CYCLES   Interrupt storm instead, CYCLES per instance (--jobs instances)" << std::endl;
+    std::cout << "  --rate N          Storm: random part of the IPL change interval (default 64)" << std::endl;
+}
+
+static int interrupt_suite(int argc, char** argv) {
+    Verilated::commandArgs(argc, argv);
+    Fx68kHarness::command_args(argc, argv);
+
+    int requests = 7000;
+    unsigned jobs = std::thread::hardware_concurrency();
+    uint32_t seed = 1;
+    std::string histogram;
+    uint64_t stress = 0;
+    unsigned rate = 64;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--requests" && i + 1 < argc) {
+            requests = std::stoi(argv[++i]);
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            jobs = std::stoul(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoul(argv[++i]);
+        } else if (arg == "--histogram" && i + 1 < argc) {
+            histogram = argv[++i];
+        } else if (arg == "--stress" && i + 1 < argc) {
+            stress = std::stoull(argv[++i]);
+        } else if (arg == "--rate" && i + 1 < argc) {
+            rate = std::max(1ul, std::stoul(argv[++i]));
+        } else if (arg == "--help" || arg == "-h") {
+            print_help(argv[0]);
+            return 0;
+        }
+    }
+    if (jobs == 0) jobs = 1;
+    if (stress) {
+        return run_stress(stress, jobs, seed, rate);
+    }
+    if (jobs > unsigned(requests)) jobs = std::max(1, requests);
+
+    std::cout << "Fx68k Interrupt Latency Test" << std::endl;
+    std::cout << "============================" << std::endl;
+    std::cout << "Requests: " << requests << ", workers: " << jobs << ", seed: " << seed << std::endl;
+    Telemetry::process().set_test(seed, "interrupt latency");
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    std::vector<LatencyRun> runs(jobs);
+    std::vector<std::thread> workers;
+    for (unsigned j = 0; j < jobs; j++) {
+        workers.emplace_back([&, j]() {
+            int share = requests / int(jobs) + (int(j) < requests % int(jobs) ? 1 : 0);
+            runs[j].run(share, seed + j);
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+
+    Distribution iack[8], fetch[8];
+    std::map<std::string, Distribution> by_instruction;
+    int failures = 0;
+    size_t measured = 0;
+    for (const LatencyRun& run : runs) {
+        failures += run.failures;
+        measured += run.samples.size();
+        for (const LatencySample& s : run.samples) {
+            iack[s.level].values.push_back(s.to_iack);
+            fetch[s.level].values.push_back(s.to_fetch);
+            by_instruction[s.interrupted].values.push_back(s.to_iack);
+        }
+    }
+
+    std::cout << "\n=== Interrupt Latency Summary ===" << std::endl;
+    std::cout << "Measured " << measured << " requests in " << duration.count() << " ms, failures: "
+              << failures << std::endl;
+    std::cout << "Cycles from IPL change     to IACK (min p50 p99 max)   to handler fetch" << std::endl;
+    for (int level = 1; level <= 7; level++) {
+        iack[level].sort();
+        fetch[level].sort();
+        std::printf("  Level %d  %6zu requests  %s      %s\n", level, iack[level].values.size(),
+                    iack[level].summary().c_str(), fetch[level].summary().c_str());
+    }
+    std::cout << "By instruction executing at the request, to IACK (min p50 p99 max)" << std::endl;
+    for (auto& i : by_instruction) {
+        i.second.sort();
+        std::printf("  %-6s %6zu requests  %s\n", i.first.c_str(), i.second.values.size(), i.second.summary().c_str());
+    }
+
+    if (!histogram.empty()) {
+        std::ofstream out(histogram);
+        out << "level,measure,cycles,count" << std::endl;
+        for (int level = 1; level <= 7; level++) {
+            for (int m = 0; m < 2; m++) {
+                std::map<uint32_t, uint64_t> counts;
+                for (uint32_t v : (m ? fetch : iack)[level].values) counts[v]++;
+                for (const auto& c : counts) {
+                    out << level << "," << (m ? "fetch" : "iack") << "," << c.first << "," << c.second << std::endl;
+                }
+            }
+        }
+        std::cout << "Histogram written to " << histogram << std::endl;
+    }
+
+    return failures ? 1 : 0;
+}
+
+FX68K_SUITE("interrupt", "Interrupt latency and interrupt storm", interrupt_suite)
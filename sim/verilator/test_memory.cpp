@@ -1,6 +1,9 @@
+#include "suite.h"
 #include <iostream>
 
-int main(int argc, char** argv) {
+static int memory_suite(int argc, char** argv) {
     std::cout << "Memory tests not implemented yet." << std::endl;
     return 0;
 }
+
+FX68K_SUITE("memory", "Memory access and bus cycle tests", memory_suite)
@@ -0,0 +1,218 @@
+// Shared bus multiprocessor test for fx68k
+//
+// Fx68kSystem (fx68k_system.h) runs N cores on one memory. Every core runs the same program:
+// it reads its index from the CPU ID register, then ITERATIONS times takes a TAS spinlock,
+// increments a shared counter with a plain read-modify-write, releases the lock and bumps a
+// private counter, and finally sets a done flag and stops. The shared counter only ends at
+// CPUs * ITERATIONS if TAS is atomic across the arbiter handovers and no core loses the bus
+// inside its critical section for good.
+//
+// --systems runs several independent systems, spread over --jobs worker threads.
+#include "fx68k_system.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint32_t INITIAL_SSP = 0x00010000;
+static const uint32_t PROGRAM_START = 0x00001000;
+static const uint32_t LOCK_ADDR = 0x00002000;
+static const uint32_t SHARED_ADDR = 0x00002004;
+static const uint32_t COUNT_ADDR = 0x00003000;     // Long per CPU
+static const uint32_t DONE_ADDR = 0x00003100;      // Word per CPU, 4 apart
+static const unsigned MAX_CPUS = 64;
+
+static const uint64_t CYCLES_PER_ITERATION = 200;  // Per CPU, generous for the timeout
+
+static std::vector<uint16_t> make_program(unsigned iterations) {
+    return {
+        0x3038, 0xFFFE,             // MOVE.W CPU_ID.W,D0
+        0xE548,                     // LSL.W #2,D0
+        0x41F8, COUNT_ADDR,         // LEA COUNT.W,A0
+        0xD0C0,                     // ADDA.W D0,A0
+        0x43F8, LOCK_ADDR,          // LEA LOCK.W,A1
+        0x45F8, SHARED_ADDR,        // LEA SHARED.W,A2
+        0x323C, uint16_t(iterations - 1),   // MOVE.W #ITERATIONS-1,D1
+        0x4AD1,                     // loop: TAS (A1)
+        0x6BFC,                     // BMI.S loop
+        0x2412,                     // MOVE.L (A2),D2
+        0x5282,                     // ADDQ.L #1,D2
+        0x2482,                     // MOVE.L D2,(A2)
+        0x4211,                     // CLR.B (A1)
+        0x5290,                     // ADDQ.L #1,(A0)
+        0x51C9, 0xFFF0,             // DBRA D1,loop
+        0x317C, 0x0001, DONE_ADDR - COUNT_ADDR,     // MOVE.W #1,DONE-COUNT(A0)
+        0x4E72, 0x2700,             // STOP #$2700
+    };
+}
+
+struct SystemResult {
+    bool passed;
+    std::string detail;
+    uint64_t cycles;
+    uint64_t contention_cycles;
+    uint64_t handovers;
+    std::vector<Fx68kSystem::CpuStats> stats;
+};
+
+class SystemRunner {
+public:
+    SystemRunner(unsigned cpus, unsigned iterations, unsigned quantum)
+        : sys(cpus, quantum), iterations(iterations) {
+        sys.mem.write_long(0, INITIAL_SSP);
+        sys.mem.write_long(4, PROGRAM_START);
+        sys.mem.load(PROGRAM_START, make_program(iterations));
+        sys.mem.commit_baseline();
+    }
+
+    SystemResult run() {
+        sys.mem.restore_baseline();
+        sys.reset();
+        unsigned cpus = unsigned(sys.cpus.size());
+        auto done = [&]() {
+            for (unsigned i = 0; i < cpus; i++) {
+                if (sys.mem.read_word(DONE_ADDR + i * 4) != 1) return false;
+            }
+            return true;
+        };
+        bool finished = sys.run_until(done, CYCLES_PER_ITERATION * iterations * cpus + 10000);
+
+        SystemResult r;
+        r.cycles = sys.cycles();
+        r.contention_cycles = sys.contention_cycles;
+        r.handovers = sys.handovers;
+        r.stats = sys.stats;
+        r.passed = false;
+        char buf[128];
+        if (!finished) {
+            unsigned stopped = 0;
+            for (unsigned i = 0; i < cpus; i++) stopped += sys.mem.read_word(DONE_ADDR + i * 4) == 1;
+            std::snprintf(buf, sizeof(buf), "timed out after %llu cycles, %u of %u CPUs done",
+                          (unsigned long long)r.cycles, stopped, cpus);
+            r.detail = buf;
+            return r;
+        }
+        for (unsigned i = 0; i < cpus; i++) {
+            uint32_t count = sys.mem.read_long(COUNT_ADDR + i * 4);
+            if (count != iterations) {
+                std::snprintf(buf, sizeof(buf), "CPU %u counted %u iterations, expected %u", i, count, iterations);
+                r.detail = buf;
+                return r;
+            }
+        }
+        uint32_t shared = sys.mem.read_long(SHARED_ADDR);
+        if (shared != iterations * cpus) {
+            std::snprintf(buf, sizeof(buf), "shared counter %u, expected %u", shared, iterations * cpus);
+            r.detail = buf;
+            return r;
+        }
+        r.passed = true;
+        return r;
+    }
+
+private:
+    Fx68kSystem sys;
+    unsigned iterations;
+};
+
+static void print_help(const char* prog) {
+    std::cout << "Usage: " << prog << " [options]" << std::endl;
+    std::cout << "  --cpus N        CPUs per system, up to " << MAX_CPUS << " (default 4)" << std::endl;
+    std::cout << "  --iterations N  Lock iterations per CPU (default 200)" << std::endl;
+    std::cout << "  --quantum N     Bus cycles before the master gives the bus up (default 8)" << std::endl;
+    std::cout << "  --systems N     Independent systems to run (default 1)" << std::endl;
+    std::cout << "  --jobs N        Worker threads (default: all cores)" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    Verilated::commandArgs(argc, argv);
+    Fx68kSystem::command_args(argc, argv);
+
+    unsigned cpus = 4;
+    unsigned iterations = 200;
+    unsigned quantum = 8;
+    unsigned systems = 1;
+    unsigned jobs = std::thread::hardware_concurrency();
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--cpus" && i + 1 < argc) {
+            cpus = std::stoul(argv[++i]);
+        } else if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::stoul(argv[++i]);
+        } else if (arg == "--quantum" && i + 1 < argc) {
+            quantum = std::stoul(argv[++i]);
+        } else if (arg == "--systems" && i + 1 < argc) {
+            systems = std::stoul(argv[++i]);
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            jobs = std::stoul(argv[++i]);
+        } else if (arg == "--help" || arg == "-h") {
+            print_help(argv[0]);
+            return 0;
+        }
+    }
+    if (cpus < 1 || cpus > MAX_CPUS || iterations < 1 || iterations > 0x10000 || systems < 1) {
+        std::cerr << "Error: need 1-" << MAX_CPUS << " CPUs, 1-65536 iterations and at least one system" << std::endl;
+        return 2;
+    }
+    if (jobs == 0) jobs = 1;
+    jobs = std::min(jobs, systems);
+
+    std::cout << "Fx68k Shared Bus System" << std::endl;
+    std::cout << "=======================" << std::endl;
+    std::cout << "Systems: " << systems << " x " << cpus << " CPUs, " << iterations << " iterations, quantum "
+              << quantum << ", workers: " << jobs << std::endl;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    std::vector<SystemResult> results(systems);
+    std::vector<std::thread> workers;
+    for (unsigned j = 0; j < jobs; j++) {
+        workers.emplace_back([&, j]() {
+            SystemRunner runner(cpus, iterations, quantum);
+            for (size_t n = j; n < systems; n += jobs) {
+                results[n] = runner.run();
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+
+    unsigned failures = 0;
+    uint64_t total_cycles = 0;
+    for (size_t n = 0; n < systems; n++) {
+        total_cycles += results[n].cycles;
+        if (!results[n].passed) {
+            failures++;
+            std::cout << "  FAIL system " << n << ": " << results[n].detail << std::endl;
+        }
+    }
+
+    // The systems are identical, so the first one stands for all
+    const SystemResult& r = results[0];
+    std::cout << "\n=== System Summary ===" << std::endl;
+    std::cout << "Ran " << systems << " systems in " << duration.count() << " ms" << std::endl;
+    std::printf("System 0: %llu cycles, %llu handovers, %llu cycles with a CPU waiting on a busy bus\n",
+                (unsigned long long)r.cycles, (unsigned long long)r.handovers,
+                (unsigned long long)r.contention_cycles);
+    std::printf("  %-4s %12s %8s %12s %8s %12s\n", "CPU", "bus cycles", "share", "stalled", "of run", "grants");
+    uint64_t bus_total = 0;
+    for (const auto& s : r.stats) bus_total += s.bus_cycles;
+    for (size_t i = 0; i < r.stats.size(); i++) {
+        const Fx68kSystem::CpuStats& s = r.stats[i];
+        std::printf("  %-4zu %12llu %7.1f%% %12llu %7.1f%% %12llu\n", i, (unsigned long long)s.bus_cycles,
+                    bus_total ? 100.0 * s.bus_cycles / bus_total : 0.0, (unsigned long long)s.stall_cycles,
+                    r.cycles ? 100.0 * s.stall_cycles / r.cycles : 0.0, (unsigned long long)s.grants);
+    }
+    if (duration.count() > 0) {
+        std::printf("Throughput: %.2f MHz of CPU cycles over all systems and CPUs\n",
+                    double(total_cycles) * cpus / duration.count() / 1000.0);
+    }
+    std::cout << "Passed: " << (systems - failures) << " of " << systems << std::endl;
+    return failures ? 1 : 0;
+}
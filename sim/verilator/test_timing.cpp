@@ -1,6 +1,468 @@
+// Opcode space timing sweep for fx68k
+//
+// Every opcode is executed once from the same machine state. The clocks between the IRD load
+// of the opcode and the next IRD load are its execution time, the same figure the published
+// 68000 tables give. Bus cycles started in that window are counted as reads/writes, so an
+// entry reads like the manuals: "8(2/0)".
+//
+// The result is a plain text table, one opcode per line, suitable for diffing between RTL
+// revisions (--compare) or against a transcription of the published tables.
+//
+// Opcode results are cached by content (result_cache.h): a rerun with unchanged RTL, ROMs and
+// binary reads them back instead of simulating.
+#include "fx68k_harness.h"
+#include "arch_state.h"
+#include "result_cache.h"
+#include "suite.h"
+#include "watchdog.h"
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <chrono>
 
-int main(int argc, char** argv) {
-    std::cout << "Timing tests not implemented yet." << std::endl;
-    return 0;
+// Machine setup shared by every opcode run
+static const uint32_t INITIAL_SSP = 0x00010000;
+static const uint32_t PROGRAM_START = 0x00001000;
+static const uint32_t HANDLER_ADDR = 0x00000800;
+static const uint32_t AREG_VALUE = 0x00003000;
+
+// Every extension word following the opcode. As a displacement, index word, absolute address,
+// immediate or MOVEM mask it stays even, non zero and clear of the vector table and program:
+// d16(An) = $6002, d8(An,D3.W) = $3004, (xxx).W = $3002, #imm divides safely, MOVEM moves 3 regs.
+static const uint16_t EXT_WORD = 0x3002;
+static const int EXT_WORDS = 8;
+
+static const int TIMEOUT_CYCLES = 4000;
+
+static const uint16_t NOP = 0x4E71;
+
+// Vectors that mean "not a valid opcode" for the table
+static const int VEC_ILLEGAL = 4;
+static const int VEC_LINE_A = 10;
+static const int VEC_LINE_F = 11;
+
+struct TimingEntry {
+    bool measured;
+    bool timeout;
+    int stuck;              // Watchdog::Verdict that ended a timeout early, RUNNING if none
+    int cycles;
+    int reads;
+    int writes;
+    int vector;             // First exception vector fetched, -1 if none
+};
+
+// Watches for exception vector fetches while the opcode under test runs: supervisor data
+// reads of a vector's high word. Program fetches from low memory (a return to address 0) are
+// not vector fetches.
+class VectorWatch : public BusObserver {
+public:
+    bool armed;
+    int vector;
+
+    VectorWatch() : armed(false), vector(-1) {}
+
+    void bus_cycle(const BusCycle& cycle) override {
+        if (armed && vector < 0 && !cycle.write && cycle.fc == 5 && cycle.addr < 0x400 && (cycle.addr & 3) == 0) {
+            vector = cycle.addr >> 2;
+        }
+    }
+};
+
+class TimingSweep {
+private:
+    Fx68kHarness hw;
+    VectorWatch watch;
+    Watchdog watchdog;
+    int prologue_instructions;
+    bool prologue_registers;
+
+    // Deterministic SR ahead of the opcode under test. The registers are written directly as
+    // the prologue starts (set_registers()), instead of by 15 more prologue instructions,
+    // unless the run is recorded: a stimulus replay starts from the reset state and only sees
+    // pins, so there the prologue sets them.
+    std::vector<uint16_t> build_prologue() {
+        std::vector<uint16_t> code;
+
+        code.push_back(0x46FC);                     // MOVE #$2700,SR
+        code.push_back(0x2700);
+        prologue_instructions = 1;
+        if (prologue_registers) {
+            for (int d = 0; d < 8; d++) {
+                code.push_back(0x7002 | (d << 9));  // MOVEQ #2,Dn
+            }
+            for (int a = 0; a < 7; a++) {
+                code.push_back(0x207C | (a << 9));  // MOVEA.L #AREG_VALUE,An
+                code.push_back(AREG_VALUE >> 16);
+                code.push_back(AREG_VALUE & 0xFFFF);
+            }
+            prologue_instructions += 8 + 7;
+        }
+        return code;
+    }
+
+    void set_registers() {
+        ArchState arch(hw.cpu);
+        for (int d = 0; d < 8; d++) {
+            arch.set_d(d, 2);
+        }
+        for (int a = 0; a < 7; a++) {
+            arch.set_a(a, AREG_VALUE);
+        }
+    }
+
+public:
+    uint32_t opcode_addr;
+
+    void record_to(StimulusRecorder* recorder) {
+        hw.recorder = recorder;
+    }
+
+    void microtrace_to(MicroTrace* trace) {
+        hw.microtrace = trace;
+    }
+
+    // recorded: the registers are set by prologue instructions, so a --record stream replays
+    explicit TimingSweep(bool recorded = false) : prologue_instructions(0), prologue_registers(recorded), opcode_addr(0) {
+        hw.observer = &watch;
+
+        hw.mem.write_long(0, INITIAL_SSP);
+        hw.mem.write_long(4, PROGRAM_START);
+        for (uint32_t vec = 2; vec < 256; vec++) {
+            hw.mem.write_long(vec * 4, HANDLER_ADDR);
+        }
+        for (uint32_t addr = HANDLER_ADDR; addr < PROGRAM_START; addr += 2) {
+            hw.mem.write_word(addr, NOP);
+        }
+        for (uint32_t addr = PROGRAM_START; addr < PROGRAM_START + 0x400; addr += 2) {
+            hw.mem.write_word(addr, NOP);
+        }
+
+        std::vector<uint16_t> prologue = build_prologue();
+        hw.mem.load(PROGRAM_START, prologue);
+        opcode_addr = PROGRAM_START + prologue.size() * 2;
+        for (int i = 1; i <= EXT_WORDS; i++) {
+            hw.mem.write_word(opcode_addr + i * 2, EXT_WORD);
+        }
+
+        hw.mem.commit_baseline();
+    }
+
+    TimingEntry measure(uint16_t opcode) {
+        TimingEntry entry = TimingEntry();
+        entry.vector = -1;
+
+        hw.mem.restore_baseline();
+        hw.mem.write_word(opcode_addr, opcode);
+        hw.reset();
+        watch.armed = false;
+        watch.vector = -1;
+        watchdog.reset(hw.cycles());
+
+        int loads = 0;
+        uint64_t start_cycle = 0;
+        BusCounters start_bus = BusCounters();
+        uint64_t limit = TIMEOUT_CYCLES * 2 + prologue_instructions * 64;
+
+        while (hw.ticks < limit) {
+            if (hw.ird_load_pending()) {
+                if (loads == 0 && !prologue_registers) {
+                    set_registers();
+                }
+                if (loads == prologue_instructions) {
+                    start_cycle = hw.cycles();
+                    start_bus = hw.bus;
+                    watch.armed = true;
+                } else if (loads == prologue_instructions + 1) {
+                    entry.measured = true;
+                    entry.cycles = int(hw.cycles() - start_cycle);
+                    entry.reads = int(hw.bus.reads - start_bus.reads);
+                    entry.writes = int(hw.bus.writes - start_bus.writes);
+                    entry.vector = watch.vector;
+                    return entry;
+                }
+                loads++;
+            }
+            hw.tick();
+            if (watchdog.sample(hw.cpu, hw.cycles())) break;
+        }
+
+        // STOP, double fault halt, or a broken core
+        entry.timeout = true;
+        entry.stuck = watchdog.verdict;
+        entry.vector = watch.vector;
+        return entry;
+    }
+};
+
+static bool is_invalid(const TimingEntry& e) {
+    return e.vector == VEC_ILLEGAL || e.vector == VEC_LINE_A || e.vector == VEC_LINE_F;
+}
+
+static std::string format_entry(uint16_t opcode, const TimingEntry& e) {
+    char buf[64];
+    if (e.timeout) {
+        std::snprintf(buf, sizeof(buf), "%04X timeout", opcode);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%04X %d(%d/%d)", opcode, e.cycles, e.reads, e.writes);
+    }
+    std::string line = buf;
+    if (e.vector >= 0) {
+        line += " vec=" + std::to_string(e.vector);
+    }
+    return line;
+}
+
+// Reference lines: "OPCODE CYCLES(READS/WRITES)" or "OPCODE timeout". Anything after is ignored,
+// so both generated tables and hand transcribed subsets of the published tables can be used.
+static bool load_reference(const std::string& filename, std::vector<std::string>& ref) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open reference table " << filename << std::endl;
+        return false;
+    }
+
+    ref.assign(0x10000, "");
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream in(line);
+        std::string op, timing;
+        if (!(in >> op >> timing)) continue;
+        ref[std::stoul(op, nullptr, 16) & 0xFFFF] = timing;
+    }
+    return true;
 }
+
+// Cache form of an entry, and back
+static std::string encode_entry(const TimingEntry& e) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%d %d %d %d %d %d %d", e.measured, e.timeout, e.stuck, e.cycles, e.reads, e.writes,
+                  e.vector);
+    return buf;
+}
+
+static bool decode_entry(const std::string& s, TimingEntry& e) {
+    int measured, timeout;
+    if (std::sscanf(s.c_str(), "%d %d %d %d %d %d %d", &measured, &timeout, &e.stuck, &e.cycles, &e.reads, &e.writes,
+                    &e.vector) != 7
+        || e.stuck < 0 || e.stuck >= Watchdog::VERDICTS) {
+        return false;
+    }
+    e.measured = measured;
+    e.timeout = timeout;
+    return true;
+}
+
+// Everything about an opcode run that the binary does not fix
+static std::string case_inputs(uint16_t opcode) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "opcode=%04X", opcode);
+    return buf;
+}
+
+static std::string timing_field(uint16_t opcode, const TimingEntry& e) {
+    std::istringstream in(format_entry(opcode, e));
+    std::string op, timing;
+    in >> op >> timing;
+    return timing;
+}
+
+static void print_help(const char* prog) {
+    std::cout << "Usage: " << prog << " [options]" << std::endl;
+    std::cout << "  --jobs N          Worker threads (default: all cores)" << std::endl;
+    std::cout << "  --range LO-HI     Opcode range in hex (default: 0000-FFFF)" << std::endl;
+    std::cout << "  --output FILE     Timing table file (default: fx68k_timing_table.txt)" << std::endl;
+    std::cout << "  --compare FILE    Compare against a reference table, fail on mismatch" << std::endl;
+    std::cout << "  --all             Also list illegal, line A and line F opcodes" << std::endl;
+    std::cout << "  --record FILE     Record the stimulus of a single opcode run (--range XXXX)" << std::endl;
+    std::cout << "  --microtrace FILE Micro-PC trace of a single opcode run (--range XXXX)" << std::endl;
+    std::cout << "  --force           Simulate every opcode, refreshing the result cache" << std::endl;
+    std::cout << "  --no-cache        Neither read nor write the result cache" << std::endl;
+}
+
+static int timing_suite(int argc, char** argv) {
+    Verilated::commandArgs(argc, argv);
+    Fx68kHarness::command_args(argc, argv);
+
+    unsigned jobs = std::thread::hardware_concurrency();
+    uint32_t first = 0x0000, last = 0xFFFF;
+    std::string output = "fx68k_timing_table.txt";
+    std::string compare;
+    std::string record;
+    std::string microtrace;
+    bool list_all = false;
+    bool force = false;
+    bool use_cache = true;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--jobs" && i + 1 < argc) {
+            jobs = std::stoul(argv[++i]);
+        } else if (arg == "--range" && i + 1 < argc) {
+            std::string range = argv[++i];
+            size_t dash = range.find('-');
+            first = std::stoul(range.substr(0, dash), nullptr, 16);
+            last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1), nullptr, 16);
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "--compare" && i + 1 < argc) {
+            compare = argv[++i];
+        } else if (arg == "--record" && i + 1 < argc) {
+            record = argv[++i];
+        } else if (arg == "--microtrace" && i + 1 < argc) {
+            microtrace = argv[++i];
+        } else if (arg == "--all") {
+            list_all = true;
+        } else if (arg == "--force") {
+            force = true;
+        } else if (arg == "--no-cache") {
+            use_cache = false;
+        } else if (arg == "--help" || arg == "-h") {
+            print_help(argv[0]);
+            return 0;
+        }
+    }
+    if (jobs == 0) jobs = 1;
+    if (last > 0xFFFF) last = 0xFFFF;
+    if ((!record.empty() || !microtrace.empty()) && first != last) {
+        std::cerr << "Error: --record and --microtrace need a single opcode (--range XXXX)" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Fx68k Timing Sweep" << std::endl;
+    std::cout << "==================" << std::endl;
+    std::cout << "Opcodes: " << std::hex << std::uppercase << first << "-" << last << std::dec
+              << ", workers: " << jobs << std::endl;
+
+    // Recording and tracing need the simulation itself
+    if (!record.empty() || !microtrace.empty()) use_cache = false;
+    ResultCache cache("timing", force);
+    std::string cache_error;
+    if (use_cache && !cache.open(argc, argv, cache_error)) {
+        std::cerr << "Warning: result cache disabled: " << cache_error << std::endl;
+        use_cache = false;
+    }
+
+    char sweep_name[32];
+    std::snprintf(sweep_name, sizeof(sweep_name), "timing sweep %04X-%04X", first, last);
+    Telemetry::process().set_test(first, sweep_name);
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    // Opcodes are dealt round robin so each worker sees the same instruction mix
+    std::vector<TimingEntry> table(0x10000);
+    std::atomic<uint32_t> done(0);
+    std::vector<std::thread> workers;
+    for (unsigned j = 0; j < jobs; j++) {
+        workers.emplace_back([&, j]() {
+            TimingSweep sweep(!record.empty() && j == 0);
+            StimulusRecorder recorder;
+            if (!record.empty() && j == 0 && recorder.open(record)) {
+                sweep.record_to(&recorder);
+            }
+            MicroTrace trace;
+            if (!microtrace.empty() && j == 0) {
+                sweep.microtrace_to(&trace);
+            }
+            for (uint32_t op = first + j; op <= last; op += jobs) {
+                std::string key, cached;
+                if (use_cache) {
+                    key = cache.key(case_inputs(op));
+                    if (cache.lookup(key, cached) && decode_entry(cached, table[op])) {
+                        done++;
+                        continue;
+                    }
+                }
+                auto op_start = std::chrono::steady_clock::now();
+                table[op] = sweep.measure(op);
+                if (use_cache) {
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - op_start;
+                    cache.store(key, encode_entry(table[op]), elapsed.count());
+                }
+                done++;
+            }
+            if (!microtrace.empty() && j == 0 && !trace.write(microtrace)) {
+                std::cerr << "Error: Could not write " << microtrace << std::endl;
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+
+    std::ofstream out(output);
+    out << "# fx68k measured timing table" << std::endl;
+    out << "# opcode cycles(reads/writes) [vec=N first exception vector fetched]" << std::endl;
+    out << "# setup: SR=$2700 Dn=2 An=$" << std::hex << AREG_VALUE << " extension words=$" << EXT_WORD
+        << std::dec << std::endl;
+
+    int listed = 0, invalid = 0, timeouts = 0;
+    int stuck[Watchdog::VERDICTS] = {};
+    for (uint32_t op = first; op <= last; op++) {
+        const TimingEntry& e = table[op];
+        if (is_invalid(e)) {
+            invalid++;
+            if (!list_all) continue;
+        }
+        if (e.timeout) {
+            timeouts++;
+            stuck[e.stuck]++;
+        }
+        out << format_entry(op, e) << std::endl;
+        listed++;
+    }
+    out.close();
+
+    std::cout << "Measured " << done.load() << " opcodes in " << duration.count() << " ms" << std::endl;
+    std::cout << "Valid: " << (done.load() - invalid) << ", invalid: " << invalid
+              << ", timeouts: " << timeouts << std::endl;
+    if (timeouts) {
+        std::cout << "Timeouts ended early:";
+        for (int v = Watchdog::HALTED; v < Watchdog::VERDICTS; v++) {
+            std::cout << " " << Watchdog::name(Watchdog::Verdict(v)) << " " << stuck[v];
+        }
+        std::cout << ", ran out: " << stuck[Watchdog::RUNNING] << std::endl;
+    }
+    std::cout << "Timing table written to " << output << " (" << listed << " entries)" << std::endl;
+    if (use_cache) {
+        if (!cache.flush(cache_error)) std::cerr << "Warning: " << cache_error << std::endl;
+        cache.print_summary();
+    }
+
+    if (compare.empty()) {
+        return 0;
+    }
+
+    std::vector<std::string> ref;
+    if (!load_reference(compare, ref)) {
+        return 1;
+    }
+
+    int checked = 0, mismatches = 0;
+    for (uint32_t op = first; op <= last; op++) {
+        if (ref[op].empty()) continue;
+        checked++;
+        std::string measured = timing_field(op, table[op]);
+        if (measured != ref[op]) {
+            mismatches++;
+            std::printf("  MISMATCH %04X: expected %s, measured %s\n", op, ref[op].c_str(), measured.c_str());
+        }
+    }
+
+    std::cout << "\n=== Timing Comparison Summary ===" << std::endl;
+    std::cout << "Reference: " << compare << std::endl;
+    std::cout << "Checked: " << checked << std::endl;
+    std::cout << "Mismatches: " << mismatches << std::endl;
+
+    return mismatches ? 1 : 0;
+}
+
+FX68K_SUITE("timing", "Opcode space timing sweep", timing_suite)
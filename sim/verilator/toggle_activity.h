@@ -0,0 +1,236 @@
+// Switching activity of fx68k signals, for power estimation without a gate level simulation
+//
+// ToggleActivity samples a fixed set of signals once per master clock edge: the nanocode and
+// microcode latches, the excUnit internal buses (Dbh/Dbl/Abh/Abl) and the external pins. Each
+// sample XORs a signal with its previous value and adds the toggled bits, 64 bits at a time,
+// into bit sliced counters: plane k holds bit k of every bit's count, so one add is a short
+// ripple of ANDs and XORs over the whole word. The planes are flushed into 64 bit totals every
+// 255 samples. The time each bit spends high is counted the same way, for SAIF T0/T1.
+//
+// write_csv() gives one row per bit with its toggle rate per sample; write_saif() a backward
+// SAIF file (nets under fx68k, the buses under fx68k/excUnit) in the master clock period given.
+#ifndef FX68K_TOGGLE_ACTIVITY_H
+#define FX68K_TOGGLE_ACTIVITY_H
+
+#include "Vfx68k.h"
+#include "Vfx68k___024root.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+class ToggleActivity {
+public:
+    static const int PLANES = 8;
+    static const uint32_t FLUSH_SAMPLES = (1u << PLANES) - 1;
+
+    explicit ToggleActivity(Vfx68k* cpu) : sampled(0), pending(0), primed(false) {
+        Vfx68k___024root* r = cpu->rootp;
+        add("nanoLatch", "", &r->fx68k__DOT__nanoLatch[0], sizeof(EData), 68);
+        add("microLatch", "", &r->fx68k__DOT__microLatch, sizeof(r->fx68k__DOT__microLatch), 17);
+        add("Dbh", "excUnit", &r->fx68k__DOT__excUnit__DOT__Dbh, 2, 16);
+        add("Dbl", "excUnit", &r->fx68k__DOT__excUnit__DOT__Dbl, 2, 16);
+        add("Abh", "excUnit", &r->fx68k__DOT__excUnit__DOT__Abh, 2, 16);
+        add("Abl", "excUnit", &r->fx68k__DOT__excUnit__DOT__Abl, 2, 16);
+        add("eab", "", &cpu->eab, sizeof(cpu->eab), 23, 1);
+        add("iEdb", "", &cpu->iEdb, 2, 16);
+        add("oEdb", "", &cpu->oEdb, 2, 16);
+        const struct { const char* name; CData* pin; } pins[] = {
+            { "ASn", &cpu->ASn }, { "UDSn", &cpu->UDSn }, { "LDSn", &cpu->LDSn }, { "eRWn", &cpu->eRWn },
+            { "FC0", &cpu->FC0 }, { "FC1", &cpu->FC1 }, { "FC2", &cpu->FC2 }, { "E", &cpu->E },
+            { "VMAn", &cpu->VMAn }, { "BGn", &cpu->BGn }, { "oRESETn", &cpu->oRESETn },
+            { "oHALTEDn", &cpu->oHALTEDn }, { "DTACKn", &cpu->DTACKn }, { "VPAn", &cpu->VPAn },
+            { "BERRn", &cpu->BERRn }, { "IPL0n", &cpu->IPL0n }, { "IPL1n", &cpu->IPL1n }, { "IPL2n", &cpu->IPL2n },
+        };
+        for (const auto& p : pins) {
+            add(p.name, "", p.pin, 1, 1);
+        }
+        lanes = LANES_PER_SIGNAL * signals.size();
+        prev.assign(lanes, 0);
+        toggle_planes.assign(lanes * PLANES, 0);
+        high_planes.assign(lanes * PLANES, 0);
+        toggles.assign(lanes * 64, 0);
+        high.assign(lanes * 64, 0);
+    }
+
+    // After the falling clock eval of a master clock edge. The first call only sets the reference.
+    void sample() {
+        uint64_t* p = prev.data();
+        uint64_t* tp = toggle_planes.data();
+        uint64_t* hp = high_planes.data();
+        for (const Signal& s : signals) {
+            uint64_t now[LANES_PER_SIGNAL];
+            read(s, now);
+            for (int l = 0; l < LANES_PER_SIGNAL; l++, p++, tp += PLANES, hp += PLANES) {
+                if (primed) {
+                    add_planes(tp, *p ^ now[l]);
+                    add_planes(hp, now[l]);
+                }
+                *p = now[l];
+            }
+        }
+        if (!primed) {
+            primed = true;
+            return;
+        }
+        sampled++;
+        if (++pending == FLUSH_SAMPLES) flush();
+    }
+
+    uint64_t samples() const { return sampled; }
+
+    // signal,bit,toggles,rate,high: rate is toggles per sample, high the fraction of samples at 1
+    bool write_csv(const std::string& path, std::string& error) {
+        flush();
+        FILE* out = std::fopen(path.c_str(), "w");
+        if (!out) {
+            error = "Could not write " + path;
+            return false;
+        }
+        std::fprintf(out, "signal,bit,toggles,rate,high\n");
+        double n = sampled ? double(sampled) : 1.0;
+        for (size_t i = 0; i < signals.size(); i++) {
+            const Signal& s = signals[i];
+            for (int b = 0; b < s.bits; b++) {
+                size_t k = i * LANES_PER_SIGNAL * 64 + b;
+                std::fprintf(out, "%s%s%s,%d,%llu,%.6f,%.6f\n", s.scope, *s.scope ? "." : "", s.name, b + s.lsb,
+                             (unsigned long long)toggles[k], toggles[k] / n, high[k] / n);
+            }
+        }
+        bool ok = std::fclose(out) == 0;
+        if (!ok) error = "Could not write " + path;
+        return ok;
+    }
+
+    // tick_ps: master clock period, 31250 for the 32 MHz clock of fx68kTop
+    bool write_saif(const std::string& path, uint64_t tick_ps, std::string& error) {
+        flush();
+        FILE* out = std::fopen(path.c_str(), "w");
+        if (!out) {
+            error = "Could not write " + path;
+            return false;
+        }
+        std::fprintf(out, "(SAIFILE\n(SAIFVERSION \"2.0\")\n(DIRECTION \"backward\")\n(DESIGN )\n");
+        std::fprintf(out, "(VENDOR \"fx68k\")\n(PROGRAM_NAME \"fx68k toggle activity\")\n(VERSION \"1.0\")\n");
+        std::fprintf(out, "(DIVIDER / )\n(TIMESCALE 1 ps)\n(DURATION %llu)\n",
+                      (unsigned long long)(sampled * tick_ps));
+        std::fprintf(out, "(INSTANCE fx68k\n");
+        write_saif_nets(out, "", tick_ps);
+        std::fprintf(out, "  (INSTANCE excUnit\n");
+        write_saif_nets(out, "excUnit", tick_ps);
+        std::fprintf(out, "  )\n)\n)\n");
+        bool ok = std::fclose(out) == 0;
+        if (!ok) error = "Could not write " + path;
+        return ok;
+    }
+
+    void print_summary() {
+        flush();
+        std::cout << "\n=== Toggle Activity Summary ===" << std::endl;
+        std::cout << "Samples: " << sampled << " master clock edges" << std::endl;
+        double n = sampled ? double(sampled) : 1.0;
+        for (size_t i = 0; i < signals.size(); i++) {
+            const Signal& s = signals[i];
+            if (s.bits == 1) continue;
+            uint64_t total = 0;
+            for (int b = 0; b < s.bits; b++) total += toggles[i * LANES_PER_SIGNAL * 64 + b];
+            std::printf("  %-12s %3d bits  %12llu toggles  %.4f per bit per sample\n", s.name, s.bits,
+                        (unsigned long long)total, total / n / s.bits);
+        }
+    }
+
+private:
+    static const int LANES_PER_SIGNAL = 2;      // Up to 128 bits
+
+    struct Signal {
+        const char* name;
+        const char* scope;
+        const void* data;
+        size_t unit;                    // Bytes per Verilator word: 1, 2, 4 or 8
+        int bits;
+        int lsb;                        // Index of the first bit, eab starts at A1
+    };
+
+    std::vector<Signal> signals;
+    size_t lanes;
+    std::vector<uint64_t> prev;
+    std::vector<uint64_t> toggle_planes, high_planes;
+    std::vector<uint64_t> toggles, high;        // 64 per lane
+    uint64_t sampled;
+    uint32_t pending;                           // Samples in the planes
+    bool primed;
+
+    void add(const char* name, const char* scope, const void* data, size_t unit, int bits, int lsb = 0) {
+        signals.push_back(Signal{ name, scope, data, unit, bits, lsb });
+    }
+
+    static void read(const Signal& s, uint64_t* lanes) {
+        lanes[0] = lanes[1] = 0;
+        if (s.unit == sizeof(EData) && s.bits > 32) {
+            // VlWide: 32 bit words, least significant first
+            const EData* w = static_cast<const EData*>(s.data);
+            for (int i = 0; i * 32 < s.bits; i++) {
+                lanes[i / 2] |= uint64_t(w[i]) << ((i & 1) * 32);
+            }
+        } else {
+            std::memcpy(&lanes[0], s.data, s.unit);
+        }
+        if (s.bits < 64) lanes[0] &= (1ull << s.bits) - 1;
+        if (s.bits > 64 && s.bits < 128) lanes[1] &= (1ull << (s.bits - 64)) - 1;
+    }
+
+    // Adds one to the count of every set bit of x: a ripple carry down the planes
+    static void add_planes(uint64_t* planes, uint64_t x) {
+        for (int k = 0; x && k < PLANES; k++) {
+            uint64_t carry = planes[k] & x;
+            planes[k] ^= x;
+            x = carry;
+        }
+    }
+
+    void flush() {
+        for (size_t l = 0; l < lanes; l++) {
+            flush_lane(&toggle_planes[l * PLANES], &toggles[l * 64]);
+            flush_lane(&high_planes[l * PLANES], &high[l * 64]);
+        }
+        pending = 0;
+    }
+
+    static void flush_lane(uint64_t* planes, uint64_t* totals) {
+        uint64_t any = 0;
+        for (int k = 0; k < PLANES; k++) any |= planes[k];
+        while (any) {
+            int b = __builtin_ctzll(any);
+            any &= any - 1;
+            uint64_t count = 0;
+            for (int k = 0; k < PLANES; k++) count |= ((planes[k] >> b) & 1) << k;
+            totals[b] += count;
+        }
+        std::memset(planes, 0, PLANES * sizeof(uint64_t));
+    }
+
+    void write_saif_nets(FILE* out, const char* scope, uint64_t tick_ps) {
+        std::fprintf(out, "  (NET\n");
+        for (size_t i = 0; i < signals.size(); i++) {
+            const Signal& s = signals[i];
+            if (std::strcmp(s.scope, scope) != 0) continue;
+            for (int b = 0; b < s.bits; b++) {
+                size_t k = i * LANES_PER_SIGNAL * 64 + b;
+                unsigned long long t1 = high[k] * tick_ps;
+                unsigned long long t0 = sampled * tick_ps - t1;
+                if (s.bits == 1) {
+                    std::fprintf(out, "    (%s", s.name);
+                } else {
+                    std::fprintf(out, "    (%s\\[%d\\]", s.name, b + s.lsb);
+                }
+                std::fprintf(out, " (T0 %llu) (T1 %llu) (TX 0) (TC %llu) (IG 0))\n", t0, t1,
+                             (unsigned long long)toggles[k]);
+            }
+        }
+        std::fprintf(out, "  )\n");
+    }
+};
+
+#endif // FX68K_TOGGLE_ACTIVITY_H
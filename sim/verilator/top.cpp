@@ -0,0 +1,174 @@
+// Live monitor for running fx68k simulations
+//
+// Lists every process run with +telemetry (telemetry.h) with its current test,
+// simulated cycles, speed and bus activity. A process whose counters have not moved for
+// a while is flagged as stalled. Plain C++, does not link the model.
+#include "telemetry.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+
+static const double STALL_SECONDS = 10.0;
+
+struct ProcessView {
+    uint32_t pid;
+    std::string program;
+    uint32_t test_id;
+    std::string test_name;
+    unsigned slots;
+    uint64_t cycles, instructions, cps, reads, writes, iack;
+    uint32_t last_vector;
+    double idle_seconds;
+};
+
+// Maps one segment read only, nullptr if it is not a telemetry block we understand
+static const TelemetryBlock* map_segment(const std::string& name) {
+    int fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    void* p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(TelemetryBlock)) {
+        p = mmap(nullptr, sizeof(TelemetryBlock), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) return nullptr;
+
+    const TelemetryBlock* block = static_cast<const TelemetryBlock*>(p);
+    if (block->magic != TELEMETRY_MAGIC || block->version != TELEMETRY_VERSION) {
+        munmap(p, sizeof(TelemetryBlock));
+        return nullptr;
+    }
+    return block;
+}
+
+static std::vector<std::string> list_segments() {
+    std::vector<std::string> names;
+    DIR* dir = opendir("/dev/shm");
+    if (!dir) return names;
+    while (struct dirent* e = readdir(dir)) {
+        std::string n = e->d_name;
+        if (n.compare(0, sizeof(TELEMETRY_PREFIX) - 1, TELEMETRY_PREFIX) == 0) {
+            names.push_back(n);
+        }
+    }
+    closedir(dir);
+    return names;
+}
+
+static ProcessView read_view(const TelemetryBlock* block, uint64_t now) {
+    ProcessView v = ProcessView();
+    v.pid = block->pid;
+    v.program.assign(block->program, strnlen(block->program, sizeof(block->program)));
+    telemetry_read_test(block, v.test_id, v.test_name);
+    v.last_vector = 0xFFFFFFFF;
+
+    uint64_t newest = block->start_ns.load(std::memory_order_relaxed);
+    v.cycles = block->retired_cycles.load(std::memory_order_relaxed);
+    v.instructions = block->retired_instructions.load(std::memory_order_relaxed);
+    v.reads = block->retired_reads.load(std::memory_order_relaxed);
+    v.writes = block->retired_writes.load(std::memory_order_relaxed);
+    v.iack = block->retired_iack.load(std::memory_order_relaxed);
+    uint32_t claimed = std::min(block->slots_claimed.load(std::memory_order_relaxed), TELEMETRY_SLOTS);
+    for (uint32_t i = 0; i < claimed; i++) {
+        const TelemetrySlot& s = block->slots[i];
+        v.cycles += s.cycles.load(std::memory_order_relaxed);
+        v.instructions += s.instructions.load(std::memory_order_relaxed);
+        v.reads += s.bus_reads.load(std::memory_order_relaxed);
+        v.writes += s.bus_writes.load(std::memory_order_relaxed);
+        v.iack += s.bus_iack.load(std::memory_order_relaxed);
+        if (s.in_use.load(std::memory_order_acquire) != TELEMETRY_SLOT_LIVE) continue;
+
+        v.slots++;
+        v.cps += s.cycles_per_second.load(std::memory_order_relaxed);
+        uint64_t updated = s.updated_ns.load(std::memory_order_relaxed);
+        if (updated >= newest) {
+            newest = updated;
+            v.last_vector = uint32_t(s.last_vector.load(std::memory_order_relaxed));
+        }
+    }
+    v.idle_seconds = now > newest ? (now - newest) / 1e9 : 0.0;
+    return v;
+}
+
+static void print_help(const char* prog) {
+    std::cout << "Usage: " << prog << " [--once] [--interval SECONDS] [--clean]" << std::endl;
+    std::cout << "  --once       Print one snapshot and exit" << std::endl;
+    std::cout << "  --interval   Refresh period (default 1)" << std::endl;
+    std::cout << "  --clean      Remove segments left behind by processes that no longer exist" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    bool once = false, clean = false;
+    double interval = 1.0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--once") {
+            once = true;
+        } else if (arg == "--interval" && i + 1 < argc) {
+            interval = std::atof(argv[++i]);
+        } else if (arg == "--clean") {
+            clean = true;
+        } else if (arg == "--help" || arg == "-h") {
+            print_help(argv[0]);
+            return 0;
+        }
+    }
+
+    std::map<uint32_t, uint64_t> previous_instructions;
+    for (;;) {
+        uint64_t now = telemetry_now_ns();
+        std::vector<ProcessView> views;
+        for (const std::string& name : list_segments()) {
+            const TelemetryBlock* block = map_segment(name);
+            if (!block) continue;
+            pid_t pid = pid_t(block->pid);
+            if (kill(pid, 0) != 0 && errno == ESRCH) {
+                munmap(const_cast<TelemetryBlock*>(block), sizeof(TelemetryBlock));
+                if (clean) shm_unlink(("/" + name).c_str());
+                continue;
+            }
+            views.push_back(read_view(block, now));
+            munmap(const_cast<TelemetryBlock*>(block), sizeof(TelemetryBlock));
+        }
+
+        if (!once) std::printf("\033[H\033[2J");
+        std::printf("%-7s %-18s %-24s %5s %14s %8s %8s %12s %12s %8s %4s %s\n", "PID", "PROGRAM", "TEST",
+                    "SIMS", "CYCLES", "MHZ", "MIPS", "READS", "WRITES", "IACK", "VEC", "STATE");
+        std::map<uint32_t, uint64_t> instructions;
+        for (const ProcessView& v : views) {
+            // First sight of a process: estimate from its lifetime instructions per cycle
+            double mips = v.cycles ? double(v.cps) * v.instructions / v.cycles / 1e6 : 0.0;
+            auto prev = previous_instructions.find(v.pid);
+            if (prev != previous_instructions.end() && interval > 0) {
+                mips = (v.instructions - prev->second) / interval / 1e6;
+            }
+            instructions[v.pid] = v.instructions;
+
+            std::string test = std::to_string(v.test_id) + (v.test_name.empty() ? "" : " " + v.test_name);
+            std::string vec = v.last_vector < 256 ? std::to_string(v.last_vector) : "-";
+            const char* state = !v.slots ? "idle" : (v.idle_seconds > STALL_SECONDS ? "STALLED" : "running");
+            std::printf("%-7u %-18.18s %-24.24s %5u %14llu %8.3f %8.3f %12llu %12llu %8llu %4s %s\n", v.pid,
+                        v.program.c_str(), test.c_str(), v.slots, (unsigned long long)v.cycles, v.cps / 1e6, mips,
+                        (unsigned long long)v.reads, (unsigned long long)v.writes, (unsigned long long)v.iack,
+                        vec.c_str(), state);
+        }
+        if (views.empty()) {
+            std::printf("No fx68k simulations running with +telemetry\n");
+        }
+        std::fflush(stdout);
+        previous_instructions = instructions;
+
+        if (once) break;
+        std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+    }
+    return 0;
+}
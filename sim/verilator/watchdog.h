@@ -0,0 +1,135 @@
+// Early exit for runs that can no longer make progress
+//
+// Watchdog is sampled once or more per 68000 clock and classifies a run as stuck when
+//   halted     oHALTEDn is low, after a double bus or address fault
+//   stopped    STOP is executing and IPL0n-2n request nothing above the SR interrupt mask
+//   self loop  program fetches have stayed within a few bytes with no write, acknowledge or
+//              E bus cycle, e.g. BRA * or a flag poll nothing can change
+//   bus idle   no bus cycle at all, whatever the core is doing
+// each for its limit in clocks. The first verdict sticks until reset(). A DBcc branching to
+// itself counts as progress. A STOP waiting for an interrupt a device raises later needs a
+// stop_cycles limit that covers the wait, or 0 to never flag it.
+//
+// Only pins and the public Ird/pswI signals are read, so it works with any bus model: the
+// harness (fx68k_harness.h) and the policy testbench (tb_fx68k.cpp) alike.
+#ifndef FX68K_WATCHDOG_H
+#define FX68K_WATCHDOG_H
+
+#include "Vfx68k.h"
+#include "Vfx68k___024root.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+class Watchdog {
+public:
+    enum Verdict { RUNNING, HALTED, STOPPED, SELF_LOOP, BUS_IDLE };
+    static const int VERDICTS = 5;
+
+    // In 68000 clocks, 0 disables the check
+    struct Limits {
+        uint64_t stop_cycles;
+        uint64_t loop_cycles;
+        uint32_t loop_span;                 // Bytes of program space a self loop may fetch from
+        uint64_t idle_cycles;               // Longer than any instruction or exception sequence
+
+        Limits() : stop_cycles(32), loop_cycles(2000), loop_span(8), idle_cycles(2000) {}
+    };
+
+    Limits limits;
+    Verdict verdict;
+    uint64_t verdict_cycle;
+    uint32_t loop_addr;                     // Lowest fetch address of a self loop
+
+    explicit Watchdog(const Limits& limits = Limits()) : limits(limits) { reset(); }
+
+    // Start watching from cycle, typically right after the CPU reset
+    void reset(uint64_t cycle = 0) {
+        verdict = RUNNING;
+        verdict_cycle = 0;
+        loop_addr = 0;
+        last_bus = cycle;
+        restart_loop(cycle);
+    }
+
+    // True once the run is stuck. cycle: 68000 clocks, must not go backwards.
+    bool sample(const Vfx68k* cpu, uint64_t cycle) {
+        if (verdict != RUNNING) return true;
+        if (!cpu->oHALTEDn) return trip(HALTED, cycle);
+
+        if (!cpu->ASn) {
+            last_bus = cycle;
+            unsigned fc = (cpu->FC2 << 2) | (cpu->FC1 << 1) | cpu->FC0;
+            if (!cpu->eRWn || fc == 7 || !cpu->VPAn) {
+                restart_loop(cycle);
+            } else if ((fc & 3) == 2) {
+                uint32_t addr = cpu->eab << 1;
+                if (addr < fetch_lo) fetch_lo = addr;
+                if (addr > fetch_hi) fetch_hi = addr;
+                if (fetch_hi - fetch_lo > limits.loop_span) {
+                    restart_loop(cycle);
+                    fetch_lo = fetch_hi = addr;
+                }
+            }
+        }
+
+        uint16_t ird = cpu->rootp->fx68k__DOT__Ird;
+        uint64_t idle = cycle - last_bus;
+        if (ird == STOP_OPCODE && limits.stop_cycles && idle >= limits.stop_cycles && !interrupt_pending(cpu)) {
+            return trip(STOPPED, cycle);
+        }
+        if (limits.idle_cycles && idle >= limits.idle_cycles) return trip(BUS_IDLE, cycle);
+
+        if ((ird & 0xF0F8) == 0x50C8) restart_loop(cycle);     // DBcc
+        if (limits.loop_cycles && fetch_lo <= fetch_hi && cycle - loop_start >= limits.loop_cycles) {
+            loop_addr = fetch_lo;
+            return trip(SELF_LOOP, cycle);
+        }
+        return false;
+    }
+
+    bool stuck() const { return verdict != RUNNING; }
+
+    static const char* name(Verdict v) {
+        static const char* names[VERDICTS] = { "running", "halted", "stopped", "self loop", "bus idle" };
+        return names[v];
+    }
+
+    std::string describe() const {
+        char buf[64];
+        if (verdict == SELF_LOOP) {
+            std::snprintf(buf, sizeof(buf), "self loop at %06X (cycle %llu)", loop_addr,
+                          (unsigned long long)verdict_cycle);
+        } else {
+            std::snprintf(buf, sizeof(buf), "%s (cycle %llu)", name(verdict), (unsigned long long)verdict_cycle);
+        }
+        return buf;
+    }
+
+private:
+    static const uint16_t STOP_OPCODE = 0x4E72;
+
+    uint64_t last_bus;
+    uint64_t loop_start;
+    uint32_t fetch_lo, fetch_hi;            // Program fetches since loop_start, lo > hi for none
+
+    void restart_loop(uint64_t cycle) {
+        loop_start = cycle;
+        fetch_lo = ~0u;
+        fetch_hi = 0;
+    }
+
+    bool trip(Verdict v, uint64_t cycle) {
+        verdict = v;
+        verdict_cycle = cycle;
+        return true;
+    }
+
+    // Level 7 is not maskable; STOP also ends on a level above the mask
+    static bool interrupt_pending(const Vfx68k* cpu) {
+        unsigned level = (!cpu->IPL2n << 2) | (!cpu->IPL1n << 1) | !cpu->IPL0n;
+        return level == 7 || level > cpu->rootp->fx68k__DOT__pswI;
+    }
+};
+
+#endif // FX68K_WATCHDOG_H